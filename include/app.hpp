@@ -2,9 +2,11 @@
 #define APP_H
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <glm/glm.hpp>
 #include <glprogram.hpp>
+#include <spectrogram.hpp>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -12,10 +14,15 @@
 
 #include <imgui.h>
 
+struct playlist;
+struct search_query;
+struct waveform;
+
 enum ePlaylistMode
 {
     Playlist,
     FindFile,
+    Search,
     Settings,
 };
 
@@ -54,8 +61,10 @@ public:
     T *GetWindowHandle() const;
 
     static void *_render;
-    static std::vector<std::filesystem::path> _playlist;
-    static int _current_playing_index;
+    static playlist *_playlist;
+    static uint32_t _current_playing_id;
+    static uint32_t _queuedId;
+    static int _failedOpens;
 
 protected:
     const std::vector<std::string> &_args;
@@ -76,7 +85,8 @@ protected:
 
     float headerOffset = 0;
     void PlayPlaylistItem(int index);
-    static void OnSongEnded(void *userdata);
+    void OnSongEnded(int reason);
+    void DecaySpectrum(float seconds);
 
     void RenderFrame();
 
@@ -85,19 +95,45 @@ private:
     std::string _currentPlaying;
     int _selected = 0;
     float progress = 0.0f;
+    int _indexCacheLimitMb = 64; // INDEX_CACHE_DEFAULT_LIMIT_KB
+    int _prerollSeconds = 5; // AUDIO_DEFAULT_PREROLL_MS
+    int _crossfadeSeconds = 0; // gapless
+    int _latencyMinMs = 100;  // AUDIO_DEFAULT_LATENCY_MIN_MS
+    int _latencyMaxMs = 1000; // AUDIO_DEFAULT_LATENCY_MAX_MS
+    int _fftSizeIndex = 3;    // SPECTRUM_DEFAULT_FFT_SIZE, 256 << 3
+    int _spectrumBands = 32;  // SPECTRUM_DEFAULT_BANDS
+    int _spectrumView = 0;    // bars, spectrogram, meters
+    Spectrogram _spectrogram;
+    int _normalization = 0;   // AUDIO_NORMALIZE_OFF
+    int _volumePercent = 100;
+    float _eqDb[3] = {0.0f, 0.0f, 0.0f}; // bass, mid, treble
+    bool _limiter = true;
     ePlaylistMode playlistMode = ePlaylistMode::Playlist;
     std::filesystem::path findFileStartDir;
     std::filesystem::path _fileRoot;
+    bool _musicFolderChosen = false; // _fileRoot came from the command line, not the working folder
     int selectedFile = 0;
     std::vector<std::filesystem::path> foldersAndFilesInCurrentDir;
+    char _searchText[256] = {};
+    search_query *_search = nullptr; // hits are library track indices
+    int _selectedHit = 0;
+    bool _focusSearch = false;
 
     void DrawTitleTicker();
     void DrawPlaybackControls();
     void DrawClock();
     void DrawSpectrum();
+    void DrawMeters(ImDrawList *drawList, ImVec2 p0, ImVec2 p1);
     void DrawTimeline();
+    void DrawWaveform(const waveform *wave, ImVec2 p0, ImVec2 p1, float filled_width);
+    void UpdateWaveform();
+    void UpdateLoudnessScan();
     void DrawPlaylist();
+    std::string TrackLabel(const std::filesystem::path &file) const;
+    const char *PlaylistLabel(uint32_t id);
     void DrawFileSelector();
+    void DrawSearch();
+    void RunSearch();
     void DrawSettings();
 
     void EnsurePlaylistVisible();
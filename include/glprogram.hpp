@@ -54,6 +54,21 @@ public:
         glUniformMatrix4fv(model, 1, GL_FALSE, glm::value_ptr(m));
     }
 
+    void setUniformInt(const char *name, int value)
+    {
+        glUniform1i(glGetUniformLocation(_index, name), value);
+    }
+
+    void setUniformFloat(const char *name, float value)
+    {
+        glUniform1f(glGetUniformLocation(_index, name), value);
+    }
+
+    void setUniformVec4(const char *name, const glm::vec4 &v)
+    {
+        glUniform4fv(glGetUniformLocation(_index, name), 1, glm::value_ptr(v));
+    }
+
     void use() const { glUseProgram(_index); }
 
     bool is_good() const { return _index > 0; }
@@ -0,0 +1,39 @@
+#ifndef SPECTROGRAM_HPP
+#define SPECTROGRAM_HPP
+
+#include <glprogram.hpp>
+#include <imgui.h>
+#include <memory>
+
+// Frequency over time for the spectrum area. Every analyzer frame becomes one column of a
+// ring texture, written with a single glTexSubImage2D, and the whole view is one quad whose
+// shader unrolls the ring. The cost per frame doesn't depend on the bands or the history shown.
+class Spectrogram
+{
+public:
+    static const int Columns = 256; // frames of history the texture holds
+
+    // Both need the GL context
+    void init();
+    void cleanup();
+
+    // Appends a frame of band levels in dB above -100 dBFS, the channels averaged. A change
+    // in the band count starts the history over.
+    void push(const float levels[][2], int bands);
+
+    // Queues the quad into drawList over p0 to p1, one column per pixel up to Columns
+    void draw(ImDrawList *drawList, ImVec2 p0, ImVec2 p1);
+
+private:
+    static void render(const ImDrawList *parentList, const ImDrawCmd *cmd);
+
+    std::unique_ptr<GlProgram> _program;
+    GLuint _texture = 0;
+    GLuint _vao = 0;  // empty, the vertex shader makes the corners
+    int _head = 0;    // column the next frame goes to
+    int _bands = 0;   // rows in use
+    glm::vec4 _rect;  // normalized device coordinates, top left and bottom right
+    float _visible = 0.0f;
+};
+
+#endif // SPECTROGRAM_HPP
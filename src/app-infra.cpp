@@ -10,9 +10,9 @@
 #include <chrono>
 #include <iostream>
 #include <memory>
-#include <thread>
 
 #include "audio_sdl.h"
+#include "playlist.h"
 
 #define OPENGL_LATEST_VERSION_MAJOR 4
 #define OPENGL_LATEST_VERSION_MINOR 6
@@ -45,8 +45,10 @@ static SDL_HitTestResult SDLCALL HitTestCallback(SDL_Window *window, const SDL_P
 }
 
 void *App::_render = nullptr;
-std::vector<std::filesystem::path> App::_playlist;
-int App::_current_playing_index = -1;
+playlist *App::_playlist = nullptr;
+uint32_t App::_current_playing_id = PLAYLIST_NONE;
+uint32_t App::_queuedId = PLAYLIST_NONE;
+int App::_failedOpens = 0;
 
 struct WindowHandle
 {
@@ -63,6 +65,7 @@ App::App(const std::vector<std::string> &args)
         if (std::filesystem::exists(candidate) && std::filesystem::is_directory(candidate))
         {
             _fileRoot = std::filesystem::canonical(candidate);
+            _musicFolderChosen = true;
             std::cout << "Using music folder: " << _fileRoot.string() << std::endl;
         }
         else
@@ -280,15 +283,6 @@ int App::Run()
 
     auto windowHandle = std::unique_ptr<WindowHandle>(GetWindowHandle<WindowHandle>());
 
-    std::thread t1([&running] {
-        while (running)
-        {
-            audio_pump(&App::_render);
-
-            SDL_Delay(10);
-        }
-    });
-
     int cachedW = 0, cachedH = 0;
     while (running)
     {
@@ -362,9 +356,7 @@ int App::Run()
         SDL_GL_SwapWindow(windowHandle->window);
     }
 
-    running = false;
-
-    t1.join();
+    OnExit();
 
     ClearWindowHandle();
 
@@ -1,5 +1,8 @@
 #include <app.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 #include <Base64.h>
 #include <entities.hpp>
 #include <glad/glad.h>
@@ -12,8 +15,22 @@
 #include "audio_sdl.h"
 
 #include "decode.h"
-
-decoder _dec;
+#include "dsp_kernels.h"
+#include "dsp_stages.h"
+#include "index_cache.h"
+#include "library.h"
+#include "loudness_scan.h"
+#include "playlist.h"
+#include "waveform.h"
+
+// Latest state published by the audio decode thread, refreshed once per frame
+static audio_status _status;
+static audio_spectrum _audible;                                     // latest frame that was heard
+static float _spectrum[SPECTRUM_MAX_BANDS][2];                      // what is drawn, decays while nothing plays
+static waveform_job *_waveformJob = nullptr;                        // overview of the current track for the timeline
+static loudness_scan *_loudnessScan = nullptr;                      // gains of the playlist tracks
+static uint32_t _loudnessScanSerial = 0;                            // playlist_serial the scan was started for
+static library *_library = nullptr;                                 // tracks under a chosen _fileRoot, loaded at startup and watched
 
 #define _CRT_SECURE_NO_WARNINGS
 #define STB_IMAGE_IMPLEMENTATION
@@ -74,9 +91,6 @@ void App::OnInit()
     glClearColor(0.56f, 0.7f, 0.67f, 1.0f);
     glEnable(GL_DEPTH_TEST);
 
-    // Set up auto-play callback with this App instance
-    sdl_audio_set_end_callback(_render, &App::OnSongEnded, this);
-
     pauseImage = LoadTextureFromFileData(pauseImageData);
     playImage = LoadTextureFromFileData(playImageData);
     squareImage = LoadTextureFromFileData(squareImageData);
@@ -92,6 +106,22 @@ void App::OnInit()
     shuffleImage = LoadTextureFromFileData(shuffleImageData);
     arrowUpImage = LoadTextureFromFileData(arrowUpImageData);
     arrowDownImage = LoadTextureFromFileData(arrowDownImageData);
+
+    _audible.bands = SPECTRUM_DEFAULT_BANDS;
+    _spectrogram.init();
+
+    // Only a folder picked as the music folder is indexed and watched, never wherever plyr
+    // happened to start. What the last run found is there at once and is only scanned again
+    // when it is old, the watch keeps it up to date from then on.
+    if (_musicFolderChosen)
+    {
+        _library = library_open(_fileRoot.string().c_str());
+    }
+    if (_library)
+    {
+        library_refresh(_library);
+        library_watch(_library, 1);
+    }
 }
 
 void App::OnResize(
@@ -115,25 +145,66 @@ void App::OnFrame(
     float scroll_speed = 50.0f;
     headerOffset += scroll_speed * (diff.count() / 1000000000.0f);
 
-    // Safe progress calculation (avoid division by zero)
-    if (_dec.mp3d.samples > 0)
+    // Track changes and ends reported by the decode thread
+    int reason;
+    while (sdl_audio_poll_event(_render, &reason))
+    {
+        OnSongEnded(reason);
+    }
+
+    UpdateWaveform();
+    UpdateLoudnessScan();
+
+    if (_library && library_poll(_library))
+    {
+        if (playlistMode == ePlaylistMode::FindFile)
+        {
+            ListFoldersAndFiles();
+        }
+
+        // Hits are indices of the tracks before, and the query reads the index it started on
+        RunSearch();
+        playlist_forget_labels(_playlist);
+    }
+
+    sdl_audio_get_status(_render, &_status);
+
+    // Safe progress calculation (avoid division by zero), estimated until the index is built
+    uint64_t totalSamples = _status.total;
+    if (playState != 0 && totalSamples > 0)
     {
-        progress = (float(_dec.mp3d.cur_sample) / float(_dec.mp3d.samples));
+        progress = std::min(float(_status.position) / float(totalSamples), 1.0f);
     }
     else
     {
         progress = 0.0f;
     }
 
-    // Decay spectrum when paused or stopped
-    if (playState == 0 || playState == 2)
+    // Spectrum of what is heard right now, decay it when paused, stopped or nothing is audible yet
+    int shownSerial = _audible.serial;
+    uint64_t shownPosition = _audible.position;
+    if (playState == 1 && sdl_audio_get_spectrum(_render, &_audible))
     {
-        decay_spectrum(&_dec);
+        memcpy(_spectrum, _audible.levels, sizeof(_spectrum));
+
+        // The spectrogram moves on by a column per analyzed block, not per frame drawn
+        if (_audible.serial != shownSerial || _audible.position != shownPosition)
+        {
+            _spectrogram.push(_audible.levels, _audible.bands);
+        }
+    }
+    else
+    {
+        DecaySpectrum(ImGui::GetIO().DeltaTime);
+        _audible.has_meters = 0; // levels of a moment that is over
     }
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    if (ImGui::IsKeyPressed(ImGuiKey_Space, false))
+    // Keys typed into the search field aren't shortcuts
+    bool typing = ImGui::GetIO().WantTextInput;
+
+    if (!typing && ImGui::IsKeyPressed(ImGuiKey_Space, false))
     {
         if (playState == 1)
         {
@@ -153,21 +224,21 @@ void App::OnFrame(
 
     float seconds = 10.0f * (ImGui::IsKeyDown(ImGuiKey_LeftCtrl) ? 6.0f : 1.0f);
 
-    float stepSize = ((1.0f / _dec.mp3d.samples) * (_dec.mp3d.info.hz * _dec.mp3d.info.channels)) * seconds;
+    float stepSize = ((1.0f / totalSamples) * (_status.hz * _status.channels)) * seconds;
 
-    if (playState == 1 && ImGui::IsKeyPressed(ImGuiKey_RightArrow, true))
+    if (!typing && playState == 1 && ImGui::IsKeyPressed(ImGuiKey_RightArrow, true))
     {
         progress += stepSize;
-        mp3dec_ex_seek(&_dec.mp3d, uint64_t(progress * _dec.mp3d.samples));
+        sdl_audio_seek(_render, uint64_t(progress * totalSamples));
     }
 
-    if (playState == 1 && ImGui::IsKeyPressed(ImGuiKey_LeftArrow, true))
+    if (!typing && playState == 1 && ImGui::IsKeyPressed(ImGuiKey_LeftArrow, true))
     {
         progress -= stepSize;
-        mp3dec_ex_seek(&_dec.mp3d, uint64_t(progress * _dec.mp3d.samples));
+        sdl_audio_seek(_render, uint64_t(progress * totalSamples));
     }
 
-    if (ImGui::IsKeyPressed(ImGuiKey_O, false) // ctrl+o
+    if (!typing && ImGui::IsKeyPressed(ImGuiKey_O, false) // ctrl+o
         && (ImGui::IsKeyDown(ImGuiKey_LeftCtrl) || ImGui::IsKeyDown(ImGuiKey_RightCtrl)))
     {
         playlistMode = ePlaylistMode::FindFile;
@@ -205,6 +276,10 @@ void App::OnFrame(
         {
             DrawFileSelector();
         }
+        else if (playlistMode == ePlaylistMode::Search)
+        {
+            DrawSearch();
+        }
         else if (playlistMode == ePlaylistMode::Settings)
         {
             DrawSettings();
@@ -250,17 +325,16 @@ void App::DrawPlaybackControls()
 
     if (ImGui::ImageButton("square", squareImage, ImVec2(24, 24)))
     {
-        sdl_audio_set_dec(_render, 0);
+        sdl_audio_stop(_render);
         playState = 0;
-        mp3dec_ex_seek(&_dec.mp3d, 0);
+        progress = 0.0f;
     }
 
     ImGui::SameLine();
 
-    if (ImGui::ImageButton("skip-back", skipBackImage, ImVec2(24, 24)))
+    if (ImGui::ImageButton("skip-back", skipBackImage, ImVec2(24, 24)) && playlist_count(_playlist) > 0)
     {
-        _selected--;
-        _selected = _selected % _playlist.size();
+        _selected = (_selected + playlist_count(_playlist) - 1) % playlist_count(_playlist);
 
         PlayPlaylistItem(_selected);
     }
@@ -272,10 +346,9 @@ void App::DrawPlaybackControls()
 
     ImGui::SameLine();
 
-    if (ImGui::ImageButton("skip-forward", skipForwardImage, ImVec2(24, 24)))
+    if (ImGui::ImageButton("skip-forward", skipForwardImage, ImVec2(24, 24)) && playlist_count(_playlist) > 0)
     {
-        _selected++;
-        _selected = _selected % _playlist.size();
+        _selected = (_selected + 1) % playlist_count(_playlist);
 
         PlayPlaylistItem(_selected);
     }
@@ -365,19 +438,21 @@ void App::DrawClock()
 {
     char buf[256];
 
+    uint64_t totalSamples = _status.total;
+
     // Check if we have valid decoder info
-    if (_dec.mp3d.samples == 0 || _dec.mp3d.info.channels == 0 || _dec.mp3d.info.hz == 0)
+    if (totalSamples == 0 || _status.channels == 0 || _status.hz == 0)
     {
         sprintf_s(buf, 256, "00:00:00 / 00:00:00");
         ImGui::Text("%s", buf);
         return;
     }
 
-    const int channelCount = _dec.mp3d.info.channels;
-    const int sampleRate = _dec.mp3d.info.hz;
+    const int channelCount = _status.channels;
+    const int sampleRate = _status.hz;
 
-    auto currentSeconds = (_dec.mp3d.cur_sample / channelCount) / sampleRate;
-    auto totalSeconds = (_dec.mp3d.samples / channelCount) / sampleRate;
+    auto currentSeconds = playState == 0 ? 0 : (_status.position / channelCount) / sampleRate;
+    auto totalSeconds = (totalSamples / channelCount) / sampleRate;
 
     auto currentMinutes = int(std::floor(currentSeconds / 60.0));
     auto totalMinutes = int(std::floor(totalSeconds / 60.0));
@@ -391,30 +466,48 @@ void App::DrawClock()
               int(totalSeconds % 60));
 
     ImGui::Text("%s", buf);
+
+    // The total is an estimate until the background scan has found every frame
+    if (!_status.duration_exact)
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("~ %d%%", int(_status.index_progress * 100.0f));
+    }
 }
 
 void App::DrawSpectrum()
 {
-    const int num_bands = 32;
-    const float bar_width = 5.0f;
-    const float bar_spacing = 1.0f;
+    const int num_bands = std::clamp(_audible.bands, 1, SPECTRUM_MAX_BANDS);
+    const float total_width = 192.0f; // 32 bands of 5 + 1 pixels
+    const float bar_spacing = num_bands > 48 ? 0.0f : 1.0f;
+    const float bar_width = total_width / num_bands - bar_spacing;
     const float max_height = 40.0f;
-    const float scale = 0.4f; // Adjusted for new DFT-based spectrum
+    const float scale = 0.4f; // band levels run from 0 (-100 dBFS) to 100 (full scale)
 
     ImVec2 cursor_pos = ImGui::GetCursorPos();
     ImVec2 screen_pos = ImGui::GetCursorScreenPos();
 
     // Reserve space for the spectrum
-    float total_width = num_bands * (bar_width + bar_spacing);
     ImGui::Dummy(ImVec2(total_width, max_height));
 
     ImDrawList *draw_list = ImGui::GetWindowDrawList();
 
+    if (_spectrumView == 1)
+    {
+        _spectrogram.draw(draw_list, screen_pos, ImVec2(screen_pos.x + total_width, screen_pos.y + max_height));
+        return;
+    }
+    if (_spectrumView == 2)
+    {
+        DrawMeters(draw_list, screen_pos, ImVec2(screen_pos.x + total_width, screen_pos.y + max_height));
+        return;
+    }
+
     // Draw spectrum bars
     for (int band = 0; band < num_bands; band++)
     {
         // Average both channels
-        float value = (_dec.spectrum[band][0] + _dec.spectrum[band][1]) * 0.5f;
+        float value = (_spectrum[band][0] + _spectrum[band][1]) * 0.5f;
 
         // Scale and clamp
         float height = (value * scale);
@@ -440,6 +533,70 @@ void App::DrawSpectrum()
     }
 }
 
+// Vectorscope on the left, then a bar per channel and the correlation. Everything was
+// measured by the decode thread, only the drawing happens here.
+void App::DrawMeters(ImDrawList *drawList, ImVec2 p0, ImVec2 p1)
+{
+    const meter_levels &levels = _audible.meters;
+    const bool live = _audible.has_meters != 0;
+    const float size = p1.y - p0.y;
+    const ImU32 guide = IM_COL32(60, 60, 70, 255);
+
+    // Mono is the vertical axis, a channel alone one of the diagonals
+    ImVec2 center(p0.x + size * 0.5f, p0.y + size * 0.5f);
+    drawList->AddRectFilled(p0, ImVec2(p0.x + size, p1.y), IM_COL32(13, 13, 26, 255));
+    drawList->AddLine(ImVec2(p0.x, p0.y), ImVec2(p0.x + size, p1.y), guide);
+    drawList->AddLine(ImVec2(p0.x + size, p0.y), ImVec2(p0.x, p1.y), guide);
+    drawList->AddLine(ImVec2(center.x, p0.y), ImVec2(center.x, p1.y), guide);
+    if (live && levels.scope_points > 1)
+    {
+        ImVec2 points[METERS_SCOPE_POINTS];
+        for (int i = 0; i < levels.scope_points; i++)
+        {
+            points[i] = ImVec2(
+                center.x + std::clamp(levels.scope[i][0], -1.0f, 1.0f) * size * 0.5f,
+                center.y - std::clamp(levels.scope[i][1], -1.0f, 1.0f) * size * 0.5f);
+        }
+        drawList->AddPolyline(points, levels.scope_points, IM_COL32(80, 220, 80, 160), ImDrawFlags_None, 1.0f);
+    }
+
+    // Bars show -60 to 0 dBFS: RMS filled, the peak as a line and the hold as a tick
+    const float left = p0.x + size + 6.0f;
+    const float width = p1.x - left;
+    const float row = (size - 4.0f) / 3.0f;
+    auto x = [left, width](float db) { return left + std::clamp(db / 60.0f + 1.0f, 0.0f, 1.0f) * width; };
+
+    for (int ch = 0; ch < 2; ch++)
+    {
+        float top = p0.y + ch * (row + 2.0f);
+        float bottom = top + row;
+        drawList->AddRectFilled(ImVec2(left, top), ImVec2(p1.x, bottom), IM_COL32(13, 13, 26, 255));
+        if (!live)
+        {
+            continue;
+        }
+
+        float heat = std::clamp(levels.peak_db[ch] / 60.0f + 1.0f, 0.0f, 1.0f);
+        ImU32 color = ImGui::GetColorU32(ImVec4(0.2f + heat * 0.8f, 0.8f - heat * 0.6f, 0.2f, 1.0f));
+        drawList->AddRectFilled(ImVec2(left, top), ImVec2(x(levels.rms_db[ch]), bottom), color);
+        drawList->AddLine(ImVec2(x(levels.peak_db[ch]), top), ImVec2(x(levels.peak_db[ch]), bottom), color, 2.0f);
+        ImU32 hold = levels.hold_db[ch] > -0.1f ? IM_COL32(255, 50, 50, 255) : IM_COL32(220, 220, 220, 255);
+        drawList->AddLine(ImVec2(x(levels.hold_db[ch]), top), ImVec2(x(levels.hold_db[ch]), bottom), hold);
+    }
+
+    // Correlation grows from the middle, right towards mono and left towards out of phase
+    float top = p0.y + 2.0f * (row + 2.0f);
+    float middle = left + width * 0.5f;
+    drawList->AddRectFilled(ImVec2(left, top), ImVec2(p1.x, p1.y), IM_COL32(13, 13, 26, 255));
+    if (live)
+    {
+        float end = middle + levels.correlation * width * 0.5f;
+        ImU32 color = levels.correlation < 0.0f ? IM_COL32(230, 60, 50, 255) : IM_COL32(50, 200, 50, 255);
+        drawList->AddRectFilled(ImVec2(std::min(middle, end), top), ImVec2(std::max(middle, end), p1.y), color);
+    }
+    drawList->AddLine(ImVec2(middle, top), ImVec2(middle, p1.y), guide);
+}
+
 void App::DrawTimeline()
 {
     ImGui::PushStyleVar(ImGuiStyleVar_FrameRounding, 12.0f);
@@ -450,6 +607,7 @@ void App::DrawTimeline()
     ImGui::PushStyleColor(ImGuiCol_SliderGrabActive, ImVec4(0.0f, 1.0f, 0.0f, 1.0f));
 
     static ImVec2 lastMousePos = ImGui::GetMousePos();
+    static float scrubProgress = 0.0f;
     auto posX = ImGui::GetCursorPosX();
     auto avail = ImGui::GetContentRegionAvail();
 
@@ -460,25 +618,89 @@ void App::DrawTimeline()
         auto mousePos = ImGui::GetMousePos();
         if (lastMousePos.x != mousePos.x)
         {
-            progress = ((mousePos.x - posX) / avail.x);
-            mp3dec_ex_seek(&_dec.mp3d, uint64_t(progress * _dec.mp3d.samples));
+            // Approximate while dragging, at most one seek per frame
+            scrubProgress = std::clamp((mousePos.x - posX) / avail.x, 0.0f, 1.0f);
+            sdl_audio_scrub(_render, uint64_t(scrubProgress * _status.total));
         }
 
+        progress = scrubProgress;
         lastMousePos = mousePos;
     }
 
+    // Exact position once the drag ends
+    if (ImGui::IsItemDeactivated())
+    {
+        sdl_audio_seek(_render, uint64_t(scrubProgress * _status.total));
+    }
+
     // draw overlay fill manually
     ImVec2 p0 = ImGui::GetItemRectMin();
     ImVec2 p1 = ImGui::GetItemRectMax();
     float filled_width = (p1.x - p0.x) * progress;
 
-    ImU32 col = ImGui::GetColorU32(ImGuiCol_PlotHistogram);
-    ImGui::GetWindowDrawList()->AddRectFilled(p0, ImVec2(p0.x + filled_width, p1.y), col);
+    const waveform *wave = playState != 0 && _waveformJob ? waveform_job_result(_waveformJob) : nullptr;
+    if (wave)
+    {
+        DrawWaveform(wave, p0, p1, filled_width);
+    }
+    else
+    {
+        ImU32 col = ImGui::GetColorU32(ImGuiCol_PlotHistogram);
+        ImGui::GetWindowDrawList()->AddRectFilled(p0, ImVec2(p0.x + filled_width, p1.y), col);
+    }
+
+    // Thin bar along the bottom while the seek index is still being built
+    if (playState != 0 && _status.index_progress < 1.0f)
+    {
+        float indexed_width = (p1.x - p0.x) * _status.index_progress;
+        ImU32 indexCol = ImGui::GetColorU32(ImGuiCol_ButtonHovered);
+        ImGui::GetWindowDrawList()->AddRectFilled(ImVec2(p0.x, p1.y - 3.0f), ImVec2(p0.x + indexed_width, p1.y), indexCol);
+    }
 
     ImGui::PopStyleColor(3);
     ImGui::PopStyleVar(3);
 }
 
+// Min/max envelope of the whole track with the RMS drawn over it, one line per pixel column
+void App::DrawWaveform(const waveform *wave, ImVec2 p0, ImVec2 p1, float filled_width)
+{
+    const int width = std::max(int(p1.x - p0.x), 1);
+    const int level = waveform_pick_level(wave, width);
+    const waveform_peak *peaks = wave->peaks[level];
+    const int count = wave->counts[level];
+    const float mid = (p0.y + p1.y) * 0.5f;
+    const float half_height = (p1.y - p0.y) * 0.5f / 127.0f;
+
+    ImU32 played_col = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.6f);
+    ImU32 played_rms_col = ImGui::GetColorU32(ImGuiCol_PlotHistogram);
+    ImU32 ahead_col = ImGui::GetColorU32(ImVec4(0.4f, 0.4f, 0.4f, 1.0f));
+    ImU32 ahead_rms_col = ImGui::GetColorU32(ImVec4(0.6f, 0.6f, 0.6f, 1.0f));
+
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+
+    for (int x = 0; x < width; x++)
+    {
+        // Columns cover the peaks in proportion, several of them when the level is finer than the pixels
+        int first = int(int64_t(x) * count / width);
+        int last = std::max(int(int64_t(x + 1) * count / width), first + 1);
+
+        int lo = 0, hi = 0, rms = 0;
+        for (int i = first; i < last && i < count; i++)
+        {
+            lo = std::min(lo, int(peaks[i].min));
+            hi = std::max(hi, int(peaks[i].max));
+            rms = std::max(rms, int(peaks[i].rms));
+        }
+
+        bool played = x < filled_width;
+        float column = p0.x + x + 0.5f;
+        float rms_height = rms * (127.0f / 255.0f) * half_height;
+
+        draw_list->AddLine(ImVec2(column, mid - hi * half_height), ImVec2(column, mid - lo * half_height + 1.0f), played ? played_col : ahead_col);
+        draw_list->AddLine(ImVec2(column, mid - rms_height), ImVec2(column, mid + rms_height + 1.0f), played ? played_rms_col : ahead_rms_col);
+    }
+}
+
 void App::ListFoldersAndFiles()
 {
     if (findFileStartDir.empty())
@@ -488,22 +710,80 @@ void App::ListFoldersAndFiles()
 
     foldersAndFilesInCurrentDir.clear();
 
-    auto diritr = std::filesystem::directory_iterator(findFileStartDir);
-
     if (std::filesystem::canonical(findFileStartDir).compare(_fileRoot) > 0)
     {
         foldersAndFilesInCurrentDir.push_back(findFileStartDir / "..");
     }
 
+    // Folders of the library come from its database, the disk is only read before the first scan
+    auto relative = findFileStartDir.lexically_relative(_fileRoot);
+    if (_library && library_count(_library) > 0 && !relative.empty() && *relative.begin() != "..")
+    {
+        std::string dir = relative == "." ? std::string() : relative.generic_string();
+        library_list_dir(
+            _library, dir.c_str(), [](void *user, const char *name, size_t nameLength, int track) {
+                (void)track;
+                auto app = static_cast<App *>(user);
+                app->foldersAndFilesInCurrentDir.push_back(app->findFileStartDir / std::string(name, nameLength));
+            },
+            this);
+        return;
+    }
+
+    auto diritr = std::filesystem::directory_iterator(findFileStartDir);
     for (const auto &entry : diritr)
     {
         foldersAndFilesInCurrentDir.push_back(entry.path());
     }
 }
 
+// Playlist paths are UTF-8 whatever the platform uses
+static std::filesystem::path PathOfUtf8(const char *path)
+{
+    return std::filesystem::path(std::u8string_view(reinterpret_cast<const char8_t *>(path)));
+}
+
+// "Artist - Title" when the library read them from the tags, the file name otherwise
+static std::string LibraryLabel(int index)
+{
+    const library_track *track = library_track_at(_library, index);
+    if (!track->title)
+    {
+        return std::filesystem::path(library_text(_library, track->path)).filename().generic_string();
+    }
+
+    std::string title = library_text(_library, track->title);
+    return track->artist ? std::string(library_text(_library, track->artist)) + " - " + title : title;
+}
+
+std::string App::TrackLabel(const std::filesystem::path &file) const
+{
+    auto relative = file.lexically_relative(_fileRoot);
+    int index = _library && !relative.empty() && *relative.begin() != ".." ? library_find(_library, relative.generic_string().c_str()) : -1;
+    return index >= 0 ? LibraryLabel(index) : file.filename().generic_string();
+}
+
+// Made once per path, the playlist keeps it until the library changes
+const char *App::PlaylistLabel(uint32_t id)
+{
+    const char *path = playlist_path(_playlist, id);
+    if (!path)
+    {
+        return "";
+    }
+
+    const char *label = playlist_label(_playlist, id);
+    if (!label && playlist_set_label(_playlist, id, TrackLabel(PathOfUtf8(path)).c_str()))
+    {
+        label = playlist_label(_playlist, id);
+    }
+    return label ? label : playlist_path(_playlist, id);
+}
+
 void App::DrawPlaylist()
 {
-    if (playlistMode == ePlaylistMode::Playlist && _playlist.size() >= 0)
+    int count = playlist_count(_playlist);
+    if (playlistMode == ePlaylistMode::Playlist)
     {
         if (ImGui::IsKeyPressed(ImGuiKey_UpArrow, true))
         {
@@ -513,7 +793,7 @@ void App::DrawPlaylist()
         else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow, true))
         {
             _selected += 1;
-            if (_selected >= _playlist.size()) _selected = _playlist.size() - 1;
+            if (_selected >= count) _selected = count - 1;
         }
         else if (ImGui::IsKeyPressed(ImGuiKey_Enter, false))
         {
@@ -525,24 +805,26 @@ void App::DrawPlaylist()
     }
 
     // Playlist
+    // Only the visible rows are drawn, with the labels the playlist keeps
     ImGui::BeginChild(23, ImVec2(0, -50.0f), true, ImGuiWindowFlags_NoSavedSettings);
-    for (size_t i = 0; i < _playlist.size(); i++)
+    ImGuiListClipper clipper;
+    clipper.Begin(count);
+    while (clipper.Step())
     {
-        auto f = std::filesystem::path(_playlist[i]);
-
-        std::string fn = f.filename().generic_string();
-
-        ImGui::PushID(i);
-        if (ImGui::Selectable(fn.c_str(), _selected == i))
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
         {
-            _selected = i;
-        }
+            ImGui::PushID(i);
+            if (ImGui::Selectable(PlaylistLabel(playlist_id_at(_playlist, i)), _selected == i))
+            {
+                _selected = i;
+            }
 
-        if (ImGui::IsItemActive() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
-        {
-            PlayPlaylistItem(_selected);
+            if (ImGui::IsItemActive() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+            {
+                PlayPlaylistItem(_selected);
+            }
+            ImGui::PopID();
         }
-        ImGui::PopID();
     }
     ImGui::EndChild();
 
@@ -561,25 +843,32 @@ void App::DrawPlaylist()
 
     if (ImGui::ImageButton("search", searchImage, ImVec2(24, 24)))
     {
+        playlistMode = ePlaylistMode::Search;
+        _focusSearch = true;
+        RunSearch();
     }
 
     if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
     {
-        ImGui::SetTooltip("Find music online");
+        ImGui::SetTooltip("Search the library");
     }
 
     ImGui::SameLine();
 
-    if (ImGui::ImageButton("trash", trashImage, ImVec2(24, 24)))
+    bool hasSelection = _selected >= 0 && _selected < count;
+    ImGui::BeginDisabled(!hasSelection);
+    if (ImGui::ImageButton("trash", trashImage, ImVec2(24, 24)) && hasSelection)
     {
-        _playlist.erase(_playlist.begin() + _selected);
-        if (_selected >= _playlist.size()) _selected = _playlist.size() - 1;
+        playlist_remove(_playlist, _selected, 1);
+        count = playlist_count(_playlist);
+        if (_selected >= count) _selected = count - 1;
     }
 
     if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
     {
         ImGui::SetTooltip("Remove selection from the playlist");
     }
+    ImGui::EndDisabled();
 
     ImGui::SameLine();
 
@@ -594,16 +883,19 @@ void App::DrawPlaylist()
 
     ImGui::SameLine();
 
-    if (ImGui::ImageButton("copy-plus", copyPlusImage, ImVec2(24, 24)))
+    hasSelection = _selected >= 0 && _selected < count;
+    ImGui::BeginDisabled(!hasSelection);
+    if (ImGui::ImageButton("copy-plus", copyPlusImage, ImVec2(24, 24)) && hasSelection)
     {
-        auto itemToCopy = _playlist[_selected];
-        _playlist.insert(_playlist.begin() + _selected + 1, itemToCopy);
+        playlist_copy(_playlist, _selected, 1, _selected + 1);
+        count = playlist_count(_playlist);
     }
 
     if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
     {
         ImGui::SetTooltip("Duplicate the playlist selection");
     }
+    ImGui::EndDisabled();
 
     ImGui::SameLine();
 
@@ -621,12 +913,9 @@ void App::DrawPlaylist()
     ImGui::BeginDisabled(_selected <= 0);
     if (ImGui::ImageButton("arrow-up", arrowUpImage, ImVec2(24, 24)) && _selected > 0)
     {
-        auto itemToMove = _playlist[_selected];
-        _playlist.erase(_playlist.begin() + _selected);
+        playlist_move(_playlist, _selected, 1, _selected - 1);
 
         _selected--;
-
-        _playlist.insert(_playlist.begin() + _selected, itemToMove);
     }
 
     if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
@@ -637,15 +926,12 @@ void App::DrawPlaylist()
 
     ImGui::SameLine();
 
-    ImGui::BeginDisabled(_selected >= _playlist.size() - 1);
-    if (ImGui::ImageButton("arrow-down", arrowDownImage, ImVec2(24, 24)) && _selected < _playlist.size() - 1)
+    ImGui::BeginDisabled(_selected < 0 || _selected >= count - 1);
+    if (ImGui::ImageButton("arrow-down", arrowDownImage, ImVec2(24, 24)) && _selected >= 0 && _selected < count - 1)
     {
-        auto itemToMove = _playlist[_selected];
-        _playlist.erase(_playlist.begin() + _selected);
+        playlist_move(_playlist, _selected, 1, _selected + 1);
 
         _selected++;
-
-        _playlist.insert(_playlist.begin() + _selected, itemToMove);
     }
 
     if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
@@ -751,11 +1037,287 @@ void App::DrawFileSelector()
     }
 }
 
+void App::RunSearch()
+{
+    search_end(_search);
+    _search = _library ? library_search(_library, _searchText) : nullptr;
+    _selectedHit = 0;
+}
+
+void App::DrawSearch()
+{
+    // Ranking goes on over the next frames, the list fills in and reorders meanwhile
+    bool searching = _search && library_search_step(_library, _search);
+    int hitCount = _search ? search_hit_count(_search) : 0;
+    const search_hit *hits = _search ? search_hits(_search) : nullptr;
+    int addHit = -1;
+
+    if (ImGui::IsKeyPressed(ImGuiKey_UpArrow, true))
+    {
+        _selectedHit = std::max(_selectedHit - 1, 0);
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow, true))
+    {
+        _selectedHit = std::max(std::min(_selectedHit + 1, hitCount - 1), 0);
+    }
+    else if (ImGui::IsKeyPressed(ImGuiKey_Enter, false))
+    {
+        addHit = _selectedHit;
+    }
+
+    if (_focusSearch)
+    {
+        ImGui::SetKeyboardFocusHere();
+        _focusSearch = false;
+    }
+    ImGui::SetNextItemWidth(-1.0f);
+    if (ImGui::InputTextWithHint("##search", "Title, artist, album or path", _searchText, sizeof(_searchText)))
+    {
+        RunSearch();
+        searching = _search && library_search_step(_library, _search);
+        hitCount = _search ? search_hit_count(_search) : 0;
+        hits = _search ? search_hits(_search) : nullptr;
+    }
+
+    // Only the visible rows are labelled
+    ImGui::BeginChild("search", ImVec2(0, -50.0f), true, ImGuiWindowFlags_NoSavedSettings);
+    ImGuiListClipper clipper;
+    clipper.Begin(hitCount);
+    while (clipper.Step())
+    {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+        {
+            std::string label = LibraryLabel((int)hits[i].doc);
+
+            ImGui::PushID(i);
+            if (ImGui::Selectable(label.c_str(), _selectedHit == i))
+            {
+                _selectedHit = i;
+            }
+
+            if (ImGui::IsItemActive() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+            {
+                addHit = i;
+            }
+            ImGui::PopID();
+        }
+    }
+    ImGui::EndChild();
+
+    if (ImGui::Button("Add"))
+    {
+        addHit = _selectedHit;
+    }
+
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+    {
+        ImGui::SetTooltip("Add the selection to the playlist");
+    }
+
+    ImGui::SameLine();
+
+    if (ImGui::Button("Close"))
+    {
+        playlistMode = ePlaylistMode::Playlist;
+    }
+
+    ImGui::SameLine();
+
+    if (!_library)
+    {
+        ImGui::Text("Start plyr with a music folder to search it");
+    }
+    else if (library_count(_library) == 0)
+    {
+        ImGui::Text("The library hasn't been scanned yet");
+    }
+    else if (_search)
+    {
+        ImGui::Text("%d found%s", hitCount, searching ? ", searching..." : "");
+    }
+    else
+    {
+        library_stats lib;
+        library_get_stats(_library, &lib);
+        if (lib.search_bytes == 0)
+        {
+            ImGui::Text("Indexing the library...");
+        }
+    }
+
+    char path[4096];
+    if (addHit >= 0 && addHit < hitCount && library_path(_library, (int)hits[addHit].doc, path, sizeof(path)))
+    {
+        const char *added = path;
+        playlist_insert(_playlist, playlist_count(_playlist), &added, 1);
+    }
+}
+
 void App::DrawSettings()
 {
     // Playlist
     ImGui::BeginChild("settings", ImVec2(0, -50.0f), true, ImGuiWindowFlags_NoSavedSettings);
     {
+        index_cache_stats stats;
+        index_cache_get_stats(&stats);
+
+        ImGui::Text("Seek index cache");
+        ImGui::Separator();
+        ImGui::Text("%d hits, %d misses, %d stored, %d evicted", stats.hits, stats.misses, stats.stores, stats.evictions);
+        ImGui::Text("%.1f MB on disk", stats.bytes / (1024.0f * 1024.0f));
+        if (ImGui::SliderInt("Size limit", &_indexCacheLimitMb, 8, 1024, "%d MB"))
+        {
+            index_cache_set_limit(uint64_t(_indexCacheLimitMb) * 1024 * 1024);
+        }
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("The oldest indexes are dropped when the next one is stored");
+        }
+
+        ImGui::Spacing();
+        ImGui::Text("Gapless playback");
+        ImGui::Separator();
+        if (ImGui::SliderInt("Pre-roll", &_prerollSeconds, 1, 30, "%d s"))
+        {
+            sdl_audio_set_preroll(_render, _prerollSeconds * 1000);
+        }
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("How long before the end of a song the next one is opened and decoded");
+        }
+        if (ImGui::SliderInt("Crossfade", &_crossfadeSeconds, 0, CROSSFADE_MAX_MS / 1000, _crossfadeSeconds ? "%d s" : "Off"))
+        {
+            sdl_audio_set_crossfade(_render, _crossfadeSeconds * 1000);
+        }
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Songs blend into each other at the end and when skipping, off plays them back to back");
+        }
+
+        ImGui::Spacing();
+        ImGui::Text("Output buffer");
+        ImGui::Separator();
+        bool latencyChanged = ImGui::SliderInt("Low latency", &_latencyMinMs, 50, 500, "%d ms");
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Smallest buffer, kept while playback runs without dropouts");
+        }
+        latencyChanged |= ImGui::SliderInt("Power saving", &_latencyMaxMs, 200, 1200, "%d ms");
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Largest buffer the player grows to after dropouts");
+        }
+        if (latencyChanged)
+        {
+            _latencyMaxMs = std::max(_latencyMaxMs, _latencyMinMs);
+            sdl_audio_set_latency(_render, _latencyMinMs, _latencyMaxMs);
+        }
+        ImGui::Text("Target %d ms, %d ms buffered, %d underruns", _status.latency_ms, _status.buffered_ms, _status.underruns);
+
+        ImGui::Spacing();
+        ImGui::Text("Loudness normalization");
+        ImGui::Separator();
+        static const char *normalizationModes[] = {"Off", "Track", "Album"};
+        if (ImGui::Combo("Mode", &_normalization, normalizationModes, IM_ARRAYSIZE(normalizationModes)))
+        {
+            sdl_audio_set_normalization(_render, _normalization);
+        }
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Plays tracks at the same loudness, album mode keeps the level differences within a folder");
+        }
+        if (_loudnessScan)
+        {
+            loudness_scan_stats scan;
+            loudness_scan_get_stats(_loudnessScan, &scan);
+            ImGui::Text("%d/%d tracks, %d scanned, %d failed, %.1f tracks/s", scan.done, scan.total, scan.scanned, scan.failed, scan.tracks_per_second);
+        }
+        ImGui::Text("Current track %+.1f dB", _status.gain_db);
+
+        ImGui::Spacing();
+        ImGui::Text("Output");
+        ImGui::Separator();
+        if (ImGui::SliderInt("Volume", &_volumePercent, 0, 100, "%d%%"))
+        {
+            // Cubic taper, so equal slider steps sound roughly equally loud
+            float volume = _volumePercent / 100.0f;
+            sdl_audio_set_dsp_param(_render, AUDIO_STAGE_VOLUME, DSP_GAIN_VOLUME, volume * volume * volume);
+        }
+        static const char *eqBands[] = {"Bass", "Mid", "Treble"};
+        for (int band = 0; band < IM_ARRAYSIZE(eqBands); band++)
+        {
+            if (ImGui::SliderFloat(eqBands[band], &_eqDb[band], -DSP_EQ_MAX_DB, DSP_EQ_MAX_DB, "%+.1f dB"))
+            {
+                sdl_audio_set_dsp_param(_render, AUDIO_STAGE_EQ, DSP_EQ_LOW_DB + band, _eqDb[band]);
+            }
+        }
+        if (ImGui::Checkbox("Limiter", &_limiter))
+        {
+            sdl_audio_set_dsp_enabled(_render, AUDIO_STAGE_LIMITER, _limiter);
+        }
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Keeps EQ boosts and normalization gain from clipping");
+        }
+        dsp_stage_stats stages[AUDIO_STAGE_COUNT];
+        int stageCount = std::min(sdl_audio_get_dsp_stats(_render, stages, AUDIO_STAGE_COUNT), (int)AUDIO_STAGE_COUNT);
+        for (int i = 0; i < stageCount; i++)
+        {
+            ImGui::Text("%-10s %5.2f%% CPU, %6.1f us slowest block%s", stages[i].name, stages[i].cpu_percent, stages[i].peak_us, stages[i].enabled ? "" : " (off)");
+        }
+
+        ImGui::Spacing();
+        ImGui::Text("Spectrum analyzer");
+        ImGui::Separator();
+        static const char *fftSizes[] = {"256", "512", "1024", "2048", "4096", "8192"};
+        bool spectrumChanged = ImGui::Combo("FFT size", &_fftSizeIndex, fftSizes, IM_ARRAYSIZE(fftSizes));
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip("Larger sizes resolve low frequencies better but react slower");
+        }
+        spectrumChanged |= ImGui::SliderInt("Bands", &_spectrumBands, 8, SPECTRUM_MAX_BANDS);
+        static const char *spectrumViews[] = {"Bars", "Spectrogram", "Meters"};
+        if (ImGui::Combo("View", &_spectrumView, spectrumViews, IM_ARRAYSIZE(spectrumViews)))
+        {
+            // Measured only while they are on screen
+            sdl_audio_set_meters(_render, _spectrumView == 2);
+        }
+        if (spectrumChanged)
+        {
+            sdl_audio_set_spectrum(_render, SPECTRUM_MIN_FFT_SIZE << _fftSizeIndex, _spectrumBands);
+        }
+
+        ImGui::Spacing();
+        ImGui::Text("Library");
+        ImGui::Separator();
+        if (_library)
+        {
+            library_stats lib;
+            library_get_stats(_library, &lib);
+            ImGui::Text("%d tracks, %.1f MB search index", lib.tracks, lib.search_bytes / (1024.0f * 1024.0f));
+            if (lib.watch == LIBRARY_WATCH_NOTIFY)
+            {
+                ImGui::Text("Watching for changes");
+            }
+            else if (lib.watch == LIBRARY_WATCH_RESCAN)
+            {
+                ImGui::Text("Rescanning every %d minutes", LIBRARY_RESCAN_INTERVAL_MS / 60000);
+            }
+            if (lib.indexing)
+            {
+                ImGui::Text("Indexing for search");
+            }
+            else if (lib.scanned)
+            {
+                ImGui::Text("%s %d found, %d read, %d unchanged, %d failed, %.0f tracks/s", lib.scanning ? (lib.updating ? "Updating:" : "Scanning:") : (lib.updating ? "Last update:" : "Last scan:"), lib.found, lib.probed, lib.reused, lib.failed, lib.tracks_per_second);
+            }
+            ImGui::BeginDisabled(lib.scanning != 0);
+            if (ImGui::Button("Rescan"))
+            {
+                library_scan(_library);
+            }
+            ImGui::EndDisabled();
+        }
     }
     ImGui::EndChild();
 
@@ -809,100 +1371,179 @@ void App::OpenSelectedFile()
         return;
     }
 
-    auto fn = file.wstring();
-    const std::string s(fn.begin(), fn.end());
-    std::cout << "Adding to playlist: " << s << std::endl;
+    auto path = file.u8string();
+    const char *added = reinterpret_cast<const char *>(path.c_str());
+    std::cout << "Adding to playlist: " << added << std::endl;
 
-    _playlist.push_back(s);
+    playlist_insert(_playlist, playlist_count(_playlist), &added, 1);
 }
 
 void App::PlayPlaylistItem(int index)
 {
-    if (index < 0 || index >= (int)_playlist.size())
+    if (index < 0 || index >= playlist_count(_playlist))
     {
-        printf("Error: Invalid playlist index: %d (playlist size: %zu)\n", index, _playlist.size());
+        printf("Error: Invalid playlist index: %d (playlist size: %d)\n", index, playlist_count(_playlist));
         playState = 0;
         return;
     }
 
-    auto playing = _playlist[index];
-    _currentPlaying = playing.filename().string();
-    _current_playing_index = index;
+    uint32_t id = playlist_id_at(_playlist, index);
+    _currentPlaying = PlaylistLabel(id);
+    _current_playing_id = id;
+    _failedOpens = 0;
 
-    sdl_audio_set_dec(_render, 0);
+    // Returns immediately, the decode thread opens the file and starts playback
+    sdl_audio_open(_render, playlist_path(_playlist, id));
 
-    if (!open_dec(&_dec, playing.string().c_str()))
+    playState = 1;
+    headerOffset = 0;
+}
+
+// Gradually decay spectrum values to zero (for pause effect), at the same speed whatever the frame rate
+void App::DecaySpectrum(float seconds)
+{
+    const float half_life = 0.57f; // seconds, adjust for faster/slower fall
+
+    // Values below 0.1 snap to zero to avoid floating point drift
+    dsp_decay(&_spectrum[0][0], SPECTRUM_MAX_BANDS * 2, std::exp2(-seconds / half_life), 0.1f);
+}
+
+// Builds or loads the waveform of the track that is playing, a background job per track
+void App::UpdateWaveform()
+{
+    const char *file_name = playlist_path(_playlist, _current_playing_id);
+    if (playState == 0 || !file_name)
     {
-        printf("Error: Failed to open MP3 file: %s\n", playing.string().c_str());
-        _currentPlaying = "Error loading: " + playing.filename().string();
-        playState = 0;
-        _current_playing_index = -1;
         return;
     }
 
-    // Update the audio stream to match the MP3's sample rate and channels
-    sdl_audio_update_stream_format(_render, _dec.mp3d.info.hz, _dec.mp3d.info.channels);
-
-    sdl_audio_set_dec(_render, &_dec);
+    if (_waveformJob && strcmp(file_name, waveform_job_file_name(_waveformJob)) == 0)
+    {
+        return;
+    }
 
-    playState = 1;
-    headerOffset = 0;
+    waveform_job_free(_waveformJob);
+    _waveformJob = waveform_job_start(file_name);
 }
 
-void App::OnSongEnded(void *userdata)
+// Measures the loudness of the playlist tracks in the background, again whenever
+// tracks are added or removed. Tracks measured before come from the cache.
+void App::UpdateLoudnessScan()
 {
-    App *app = static_cast<App *>(userdata);
+    if (_loudnessScan && _loudnessScanSerial == playlist_serial(_playlist))
+    {
+        return;
+    }
 
-    // Auto-advance to next song
-    if (_current_playing_index >= 0 && _playlist.size() > 0)
+    // The scan copies the names, the paths are read straight from the playlist
+    int count = playlist_count(_playlist);
+    std::vector<const char *> fileNames(count), albumKeys(count);
+    std::vector<std::string> albums(count);
+    for (int i = 0; i < count; i++)
     {
-        int attempts = 0;
-        const int max_attempts = _playlist.size();
+        fileNames[i] = playlist_path(_playlist, playlist_id_at(_playlist, i));
 
-        while (attempts < max_attempts)
-        {
-            _current_playing_index = (_current_playing_index + 1) % _playlist.size();
-            auto playing = _playlist[_current_playing_index];
+        // A folder is an album
+        std::string_view file = fileNames[i];
+        size_t folder = file.find_last_of("/\\");
+        albums[i] = folder == std::string_view::npos ? std::string() : std::string(file.substr(0, folder));
+        albumKeys[i] = albums[i].c_str();
+    }
 
-            sdl_audio_set_dec(_render, 0);
+    loudness_scan_free(_loudnessScan);
+    _loudnessScan = loudness_scan_start(fileNames.data(), albumKeys.data(), count);
+    _loudnessScanSerial = playlist_serial(_playlist);
+}
 
-            if (open_dec(&_dec, playing.string().c_str()))
+void App::OnSongEnded(int reason)
+{
+    int count = playlist_count(_playlist);
+    if (_current_playing_id == PLAYLIST_NONE || count == 0)
+    {
+        // Nothing to follow with, let the track end
+        if (reason == AUDIO_NEXT_NEEDED || reason == AUDIO_NEXT_FAILED)
+        {
+            sdl_audio_queue_next(_render, nullptr);
+        }
+        return;
+    }
+
+    switch (reason)
+    {
+        case AUDIO_END_OPEN_FAILED:
+        {
+            // Only songs the user picked are opened directly, playback stops on them
+            const char *current = playlist_path(_playlist, _current_playing_id);
+            printf("Error: Failed to open MP3 file: %s\n", current ? current : "(removed)");
+
+            _current_playing_id = PLAYLIST_NONE;
+            playState = 0;
+            _currentPlaying = "Error loading: " + (current ? PathOfUtf8(current).filename().string() : std::string());
+            break;
+        }
+        case AUDIO_NEXT_FAILED:
+        case AUDIO_NEXT_NEEDED:
+        {
+            // Auto-advance: the next song is opened while the current one is still playing.
+            // Entries are followed by id, so moving them around doesn't lose the place.
+            int at;
+            if (reason == AUDIO_NEXT_FAILED)
             {
-                // Successfully opened the file
-                sdl_audio_update_stream_format(_render, _dec.mp3d.info.hz, _dec.mp3d.info.channels);
-                sdl_audio_set_dec(_render, &_dec);
+                const char *failed = playlist_path(_playlist, _queuedId);
+                printf("Error: Failed to open MP3 file: %s\n", failed ? failed : "(removed)");
 
-                // Update UI to match current song
-                if (app)
+                if (++_failedOpens >= count)
                 {
-                    app->_selected = _current_playing_index;
-                    app->_currentPlaying = playing.filename().string();
-                    app->headerOffset = 0;
+                    printf("Error: All files in playlist failed to open\n");
+                    sdl_audio_queue_next(_render, nullptr);
+                    break;
                 }
-                break;
+                at = playlist_index_of(_playlist, _queuedId);
             }
             else
             {
-                // Failed to open, try next song
-                printf("Error: Failed to open MP3 file during auto-play: %s\n", playing.string().c_str());
-                attempts++;
+                at = playlist_index_of(_playlist, _current_playing_id);
             }
-        }
 
-        if (attempts >= max_attempts)
+            // Removed entries continue from the start
+            _queuedId = playlist_id_at(_playlist, (at + 1) % count);
+            sdl_audio_queue_next(_render, playlist_path(_playlist, _queuedId));
+            break;
+        }
+        case AUDIO_NEXT_STARTED:
         {
-            // All files failed to open
-            printf("Error: All files in playlist failed to open\n");
-            _current_playing_index = -1;
-            if (app)
+            _failedOpens = 0;
+            _current_playing_id = _queuedId;
+
+            // Update UI to match current song
+            int at = playlist_index_of(_playlist, _current_playing_id);
+            if (at >= 0)
             {
-                app->playState = 0;
-                app->_currentPlaying = "No playable files";
+                _selected = at;
             }
+            _currentPlaying = PlaylistLabel(_current_playing_id);
+            headerOffset = 0;
+            break;
+        }
+        case AUDIO_END_FINISHED:
+        {
+            _failedOpens = 0;
+            playState = 0;
+            _currentPlaying = "No playable files";
+            break;
         }
     }
 }
 
 void App::OnExit()
 {
+    _spectrogram.cleanup();
+    waveform_job_free(_waveformJob);
+    _waveformJob = nullptr;
+    loudness_scan_free(_loudnessScan);
+    _loudnessScan = nullptr;
+    search_end(_search);
+    _search = nullptr;
+    library_close(_library);
+    _library = nullptr;
 }
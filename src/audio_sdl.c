@@ -1,84 +1,983 @@
 #include "audio_sdl.h"
+#include "crossfade.h"
+#include "dsp_kernels.h"
+#include "dsp_stages.h"
+#include "pcm_ring.h"
+#include "play_clock.h"
+#include "resampler.h"
+#include "spectrum.h"
+#include "spsc_queue.h"
 
+#include <math.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <SDL3/SDL.h>
 #include <stdio.h>
 
+// Capacity of the command and event queues, must be a power of two
+#define AUDIO_QUEUE_SIZE 64
+
+// Buffer target the decode thread starts with, adapted within the latency bounds
+#define AUDIO_INITIAL_LATENCY_MS 250
+
+// Playback without underruns after which the buffer target is lowered one step
+#define AUDIO_LATENCY_STABLE_MS 10000
+
+// The stream is fed stereo float at the device rate, see resampler.h
+#define AUDIO_FRAME_BYTES (2 * (int)sizeof(float))
+
+// Spectrum frames on their way to the UI, enough to cover the largest buffer target.
+// Must be a power of two.
+#define AUDIO_SPECTRUM_QUEUE_SIZE 64
+
+typedef enum audio_command_type
+{
+    AUDIO_CMD_OPEN,
+    AUDIO_CMD_QUEUE_NEXT,
+    AUDIO_CMD_STOP,
+    AUDIO_CMD_SEEK,
+    AUDIO_CMD_SCRUB,
+    AUDIO_CMD_PAUSE,
+    AUDIO_CMD_SET_PREROLL,
+    AUDIO_CMD_SET_LATENCY,
+    AUDIO_CMD_SET_SPECTRUM,
+    AUDIO_CMD_SET_NORMALIZATION,
+    AUDIO_CMD_SET_CROSSFADE,
+    AUDIO_CMD_SET_METERS,
+} audio_command_type;
+
+typedef struct audio_command
+{
+    int type;
+    int generation;  // OPEN and STOP start a new generation
+    uint64_t value;  // seek target, pause state, pre-roll or crossfade time, latency bounds, analyzer setup or normalization
+    char *file_name; // OPEN and QUEUE_NEXT, freed by the decode thread
+} audio_command;
+
+typedef struct audio_event
+{
+    int reason;
+    int generation; // events of a replaced track are dropped by sdl_audio_poll_event
+} audio_event;
+
+typedef enum audio_next_state
+{
+    NEXT_IDLE,    // successor not asked for yet
+    NEXT_WAITING, // AUDIO_NEXT_NEEDED/AUDIO_NEXT_FAILED posted, waiting for sdl_audio_queue_next
+    NEXT_READY,   // successor open and its first block decoded
+    NEXT_NONE,    // nothing follows, playback stops at the end of the track
+} audio_next_state;
+
 typedef struct audio_ctx
 {
     SDL_AudioDeviceID dev;
     SDL_AudioStream *stream;
-    SDL_AudioSpec spec;
+    SDL_AudioSpec spec;     // native format of the device, the stream converts to its channel layout only
+    resampler *resampler;   // decoded rate to spec.freq, owned by the stream callback
+    float *resampled;       // resampler output of one RESAMPLER_CHUNK_FRAMES chunk
 
-    decoder *dec;
+    // Owned by the decode thread, nothing else touches the decoders
+    decoder decoders[3];
+    decoder *dec;     // current track, valid while loaded
+    decoder *next;    // successor for the gapless splice
+    decoder *fading;  // outgoing track of a crossfade, NULL once it ran out or none runs
+    pcm_block next_block;
+    int next_state;
+    bool loaded;
+    bool paused;
+    bool song_ended;
+    bool end_notified;
+    bool seek_pending;   // latest seek of the command batch, earlier ones are dropped
+    bool seek_exact;     // sdl_audio_seek rather than sdl_audio_scrub
+    bool refine_pending; // playing from an estimated position until the seek index is ready
+    uint64_t seek_sample;
+    uint32_t preroll_ms;
+    int track_generation;
+    int serial;         // bumped for every track that starts and every flush, tags the blocks it produces
+    bool start_pending; // spliced track not audible yet, AUDIO_NEXT_STARTED follows once it is
+    int prev_hz;        // track before the splice, reported until the clock has passed it
+    int prev_channels;
+    uint64_t prev_total;
+    spectrum_analyzer *analyzer;
+    int normalization; // audio_normalization
+    dsp_chain *chain;  // audio_dsp_stage order
+    bool meters_enabled;
+    meters meters;
+#if !DECODER_FLOAT_OUTPUT
+    float chain_buffer[PCM_BLOCK_SAMPLES]; // S16 blocks are mixed and processed as float
+#endif
 
-    audio_end_callback end_callback;
-    void *callback_userdata;
+    // Crossfades at track changes, 0 ms splices gaplessly. The outgoing track is decoded
+    // a chunk at a time alongside the current one and mixed into its blocks.
+    int crossfade_ms;
+    crossfade *fade;
+    mp3d_sample_t fade_decoded[RESAMPLER_CHUNK_FRAMES * 2];
 
-    bool running;
-    bool song_ended;
+    // Adaptive buffering: the ring is kept filled up to latency_ms, which doubles after an
+    // underrun and steps down again after a stretch of stable playback
+    int latency_ms;
+    int latency_min_ms;
+    int latency_max_ms;
+    int underruns_seen;
+    Uint64 stable_since;
+    SDL_AtomicInt primed;    // the ring reached its target, an empty ring from now on is an underrun
+    SDL_AtomicInt underruns; // counted by the stream callback
+
+    // Decode stage: the decode thread keeps the ring full, the stream callback drains it
+    pcm_ring ring;
+    SDL_Thread *decode_thread;
+    SDL_Semaphore *wake; // signalled on new commands and when ring space frees up
+    SDL_AtomicInt running;
+    play_clock clock;    // what is audible, advanced by the stream callback
+
+    // UI -> decode thread
+    spsc_queue commands;
+    audio_command command_storage[AUDIO_QUEUE_SIZE];
+    SDL_AtomicInt generation;
+
+    // Decode thread -> UI
+    spsc_queue events;
+    audio_event event_storage[AUDIO_QUEUE_SIZE];
+    spsc_queue spectra; // analyzed blocks in decode order, consumed as they become audible
+    audio_spectrum spectrum_storage[AUDIO_SPECTRUM_QUEUE_SIZE];
+    SDL_AtomicInt status_seq; // seqlock, odd while status is being written
+    audio_status status;
+
+    // Owned by the UI thread, see sdl_audio_get_spectrum
+    audio_spectrum spectrum_shown;   // latest frame the playback has reached
+    audio_spectrum spectrum_pending; // popped but not audible yet
+    bool spectrum_has_shown;
+    bool spectrum_has_pending;
 } audio_ctx;
 
 
 /* ============================================================
-   Audio pump (replaces SDL2 callback)
+   Stream callback (drains the ring, never decodes or allocates)
    ============================================================ */
-void audio_pump(
-    void **audio_render)
+static void SDLCALL audio_stream_callback(
+    void *userdata,
+    SDL_AudioStream *stream,
+    int additional_amount,
+    int total_amount)
 {
-    audio_ctx *ctx = (audio_ctx *)(*audio_render);
+    audio_ctx *ctx = (audio_ctx *)userdata;
+    (void)total_amount;
 
-    if (ctx == NULL ) {
-        return;
+    int released = 0;
+
+    while (additional_amount > 0)
+    {
+        pcm_block *block = pcm_ring_read_begin(&ctx->ring);
+        if (!block) {
+            // Decoder fell behind or the playlist ended, what the filter still holds plays out
+            int drained = resampler_drain(ctx->resampler, ctx->resampled);
+            if (drained > 0) {
+                SDL_PutAudioStreamData(stream, ctx->resampled, drained * AUDIO_FRAME_BYTES);
+            }
+
+            // SDL pads with silence. Counted once until the ring is primed again
+            if (SDL_CompareAndSwapAtomicInt(&ctx->primed, 1, 0)) {
+                SDL_AddAtomicInt(&ctx->underruns, 1);
+            }
+            break;
+        }
+
+        if (block->hz != resampler_in_hz(ctx->resampler))
+        {
+            // Rate change at a gapless splice, the end of the previous track goes first
+            int drained = resampler_drain(ctx->resampler, ctx->resampled);
+            if (drained > 0)
+            {
+                SDL_PutAudioStreamData(stream, ctx->resampled, drained * AUDIO_FRAME_BYTES);
+            }
+        }
+
+        int frames = block->samples / block->channels;
+        for (int done = 0; done < frames; done += RESAMPLER_CHUNK_FRAMES)
+        {
+            int chunk = SDL_min(frames - done, RESAMPLER_CHUNK_FRAMES);
+            int converted = resampler_process(ctx->resampler, block->data + done * block->channels, chunk, block->hz, block->channels, ctx->resampled);
+            SDL_PutAudioStreamData(stream, ctx->resampled, converted * AUDIO_FRAME_BYTES);
+            additional_amount -= converted * AUDIO_FRAME_BYTES;
+        }
+        play_clock_put(&ctx->clock, block->serial, block->position, block->samples, block->hz * block->channels);
+
+        pcm_ring_read_commit(&ctx->ring);
+        released++;
     }
 
-    if (ctx->running == false) {
-        return;
+    // Input the resampler holds back is as far from being heard as what is queued
+    play_clock_update(&ctx->clock, SDL_GetAudioStreamQueued(stream) / AUDIO_FRAME_BYTES + resampler_delay(ctx->resampler));
+
+    if (released) {
+        SDL_SignalSemaphore(ctx->wake);
     }
+}
 
-    if (ctx->stream == NULL ) {
-        return;
+
+/* ============================================================
+   Decode thread (runs the commands and keeps the ring full)
+   ============================================================ */
+static void audio_post_event(
+    audio_ctx *ctx,
+    int reason)
+{
+    audio_event event = {reason, ctx->track_generation};
+
+    if (!spsc_queue_push(&ctx->events, &event))
+    {
+        printf("warning: audio event %d dropped, queue full\n", reason);
     }
+}
 
-    if (ctx->dec == NULL) {
+// Linear loudness normalization gain of a track, 1 when it is off or the track wasn't scanned yet
+static float audio_track_gain(
+    const audio_ctx *ctx,
+    const decoder *dec)
+{
+    if (ctx->normalization == AUDIO_NORMALIZE_OFF || !dec->has_loudness)
+    {
+        return 1.0f;
+    }
+
+    const loudness_info *info = &dec->loudness;
+    if (ctx->normalization == AUDIO_NORMALIZE_ALBUM && info->has_album)
+    {
+        return loudness_linear_gain(info->album_gain, info->album_peak);
+    }
+
+    return loudness_linear_gain(info->gain, info->peak);
+}
+
+// Scales freshly decoded samples of dec, before they are mixed, analyzed or queued
+static void audio_apply_gain(
+    const audio_ctx *ctx,
+    const decoder *dec,
+    mp3d_sample_t *samples,
+    int count)
+{
+    float gain = audio_track_gain(ctx, dec);
+    if (gain == 1.0f)
+    {
         return;
     }
 
-    // Check how much data is queued, and top it up if needed
-    int queued = SDL_GetAudioStreamQueued(ctx->stream);
+#if DECODER_FLOAT_OUTPUT
+    dsp_gain_f32(samples, count, gain);
+#else
+    dsp_gain_s16(samples, count, gain);
+#endif
+}
+
+static void audio_publish_status(
+    audio_ctx *ctx)
+{
+    audio_status *status = &ctx->status;
+
+    // Readers retry while the sequence is odd or changed under them
+    SDL_AddAtomicInt(&ctx->status_seq, 1);
+    SDL_MemoryBarrierRelease();
+
+    status->generation = ctx->track_generation;
+    status->loaded = ctx->loaded;
+    status->underruns = SDL_GetAtomicInt(&ctx->underruns);
+    status->latency_ms = ctx->latency_ms;
+
+    if (ctx->loaded)
+    {
+        const decoder *dec = ctx->dec;
+
+        play_clock_state clock;
+        play_clock_get(&ctx->clock, &clock);
+
+        if (ctx->start_pending && clock.serial != ctx->serial)
+        {
+            // The end of the previous track is still playing
+            status->hz = ctx->prev_hz;
+            status->channels = ctx->prev_channels;
+            status->total = ctx->prev_total;
+            status->duration_exact = 1;
+            status->index_progress = 1.0f;
+        }
+        else
+        {
+            status->hz = dec->mp3d.info.hz;
+            status->channels = dec->mp3d.info.channels;
+            status->total = decoder_total_samples(dec);
+            status->duration_exact = decoder_duration_exact(dec);
+            status->index_progress = decoder_index_progress(dec);
+        }
+        status->gain_db = 20.0f * log10f(audio_track_gain(ctx, dec));
+
+        status->position = play_clock_position(&clock, SDL_GetTicksNS());
+
+        // The ring holds decoded samples, the stream resampled frames
+        int rate = dec->mp3d.info.hz * dec->mp3d.info.channels;
+        uint64_t ring_ms = rate ? (uint64_t)pcm_ring_count(&ctx->ring) * PCM_BLOCK_SAMPLES * 1000 / rate : 0;
+        uint64_t stream_ms = (uint64_t)(SDL_GetAudioStreamQueued(ctx->stream) / AUDIO_FRAME_BYTES) * 1000 / ctx->spec.freq;
+        status->buffered_ms = (int)(ring_ms + stream_ms);
+    }
+    else
+    {
+        status->hz = status->channels = 0;
+        status->position = status->total = 0;
+        status->duration_exact = 0;
+        status->index_progress = 0.0f;
+        status->buffered_ms = 0;
+        status->gain_db = 0.0f;
+    }
+
+    SDL_MemoryBarrierRelease();
+    SDL_AddAtomicInt(&ctx->status_seq, 1);
+}
+
+// Analyzes a block on its way into the ring, the UI picks the frame up once the block is heard
+static void audio_record_spectrum(
+    audio_ctx *ctx,
+    const pcm_block *block,
+    const float *samples)
+{
+    audio_spectrum frame;
+    frame.serial = block->serial;
+    frame.position = block->position;
+    frame.samples = block->samples;
+    frame.bands = spectrum_analyzer_bands(ctx->analyzer);
 
-    // Calculate bytes per sample based on format
-    int bytes_per_sample = (ctx->spec.format == SDL_AUDIO_F32) ? sizeof(float) : sizeof(Sint16);
-    int target_bytes = ctx->spec.freq * ctx->spec.channels * bytes_per_sample / 4; // ~250ms of audio
+    spectrum_analyzer_process(ctx->analyzer, block->data, block->samples, block->channels, block->hz, frame.levels);
 
-    if (queued >= target_bytes) {
-        return; // Already have enough queued
+    frame.has_meters = ctx->meters_enabled;
+    if (ctx->meters_enabled)
+    {
+        meters_process(&ctx->meters, samples, block->samples / block->channels, block->channels, block->hz, &frame.meters);
     }
 
-    int want = target_bytes - queued;
+    // Full only while the UI isn't drawing, the frame is of no use to anyone then
+    spsc_queue_push(&ctx->spectra, &frame);
+}
 
-    Uint8 *buffer = (Uint8 *)SDL_malloc(want);
-    if (!buffer) {
-        return;
+// Ends the crossfade, the outgoing track is dropped wherever it got to
+static void audio_fade_end(
+    audio_ctx *ctx)
+{
+    crossfade_stop(ctx->fade);
+    if (ctx->fading)
+    {
+        close_dec(ctx->fading);
+        ctx->fading = NULL;
+    }
+}
+
+// Mixes the outgoing track under a block of the current one, decoding as much of it as needed
+static void audio_mix_fade(
+    audio_ctx *ctx,
+    float *samples,
+    int frames,
+    int channels)
+{
+    while (ctx->fading && crossfade_wanted(ctx->fade, frames) > 0)
+    {
+        decoder *fading = ctx->fading;
+        int fading_channels = fading->mp3d.info.channels;
+        int decoded = decode_samples(fading, ctx->fade_decoded, RESAMPLER_CHUNK_FRAMES * fading_channels);
+        if (decoded > 0)
+        {
+            audio_apply_gain(ctx, fading, ctx->fade_decoded, decoded);
+        }
+        crossfade_feed(ctx->fade, ctx->fade_decoded, SDL_max(decoded, 0) / fading_channels, fading->mp3d.info.hz, fading_channels);
+
+        if (decoded <= 0)
+        {
+            // Ran out, the rest of the fade only raises the current track
+            close_dec(fading);
+            ctx->fading = NULL;
+        }
+    }
+
+    if (!crossfade_mix(ctx->fade, samples, frames, channels))
+    {
+        audio_fade_end(ctx);
+    }
+}
+
+// Mixes the track in ctx->fading under the current one for frames frames of it
+static void audio_fade_start(
+    audio_ctx *ctx,
+    int frames)
+{
+    if (!crossfade_start(ctx->fade, ctx->dec->mp3d.info.hz, frames))
+    {
+        printf("warning: no memory for the crossfade, cutting over\n");
+        audio_fade_end(ctx);
+    }
+}
+
+// Everything between the decoder and the ring: normalization, the crossfade, the DSP chain,
+// the analyzer and the meters
+static void audio_process_block(
+    audio_ctx *ctx,
+    const decoder *dec,
+    pcm_block *block)
+{
+    audio_apply_gain(ctx, dec, block->data, block->samples);
+
+    int frames = block->samples / block->channels;
+#if DECODER_FLOAT_OUTPUT
+    float *samples = block->data;
+#else
+    float *samples = ctx->chain_buffer;
+    for (int i = 0; i < block->samples; i++)
+    {
+        samples[i] = block->data[i] * (1.0f / 32768.0f);
+    }
+#endif
+
+    if (crossfade_active(ctx->fade))
+    {
+        audio_mix_fade(ctx, samples, frames, block->channels);
+    }
+    dsp_chain_process(ctx->chain, samples, frames, block->channels, block->hz);
+
+#if !DECODER_FLOAT_OUTPUT
+    for (int i = 0; i < block->samples; i++)
+    {
+        int value = (int)lrintf(samples[i] * 32768.0f);
+        block->data[i] = (mp3d_sample_t)SDL_clamp(value, -32768, 32767);
+    }
+#endif
+
+    audio_record_spectrum(ctx, block, samples);
+}
+
+// Drops everything queued, playback continues from position of the current track
+static void audio_flush(
+    audio_ctx *ctx,
+    uint64_t position)
+{
+    int rate = ctx->loaded ? ctx->dec->mp3d.info.hz * ctx->dec->mp3d.info.channels : 0;
+
+    // Only the decode thread produces, the stream lock parks the callback
+    SDL_LockAudioStream(ctx->stream);
+
+    pcm_ring_reset(&ctx->ring);
+    SDL_ClearAudioStream(ctx->stream);
+    resampler_reset(ctx->resampler);
+    SDL_SetAtomicInt(&ctx->primed, 0); // refilling after a flush is no underrun
+    ctx->serial++;                     // spectrum frames queued so far are never heard
+    play_clock_reset(&ctx->clock, ctx->serial, position, rate);
+
+    SDL_UnlockAudioStream(ctx->stream);
+
+    spectrum_analyzer_reset(ctx->analyzer);
+    dsp_chain_reset(ctx->chain);
+    meters_reset(&ctx->meters);
+
+    // A spliced track that was never heard is the current one all the same
+    if (ctx->start_pending)
+    {
+        ctx->start_pending = false;
+        audio_post_event(ctx, AUDIO_NEXT_STARTED);
+    }
+}
+
+static void audio_unload(
+    audio_ctx *ctx)
+{
+    audio_fade_end(ctx);
+    close_dec(ctx->next);
+    close_dec(ctx->dec);
+    ctx->next_state = NEXT_IDLE;
+    ctx->loaded = false;
+    ctx->song_ended = false;
+    ctx->end_notified = false;
+    ctx->seek_pending = false;
+    ctx->refine_pending = false;
+    audio_flush(ctx, 0);
+}
+
+static void audio_open_next(
+    audio_ctx *ctx,
+    const char *file_name)
+{
+    close_dec(ctx->next);
+
+    // Open and decode the first block now, so the splice costs no more than a copy
+    bool opened = open_dec(ctx->next, file_name) != 0;
+    if (opened)
+    {
+        ctx->next_block.samples = decode_samples(ctx->next, ctx->next_block.data, PCM_BLOCK_SAMPLES);
+        ctx->next_block.hz = ctx->next->mp3d.info.hz;
+        ctx->next_block.channels = ctx->next->mp3d.info.channels;
+        ctx->next_block.position = 0;
+        opened = ctx->next_block.samples > 0;
+    }
+
+    if (opened)
+    {
+        ctx->next_state = NEXT_READY;
+
+        // Rate converter of the fade built now, not when the fade has to start
+        if (ctx->crossfade_ms > 0)
+        {
+            crossfade_prepare(ctx->fade, ctx->next->mp3d.info.hz);
+        }
+    }
+    else
+    {
+        close_dec(ctx->next);
+        audio_post_event(ctx, AUDIO_NEXT_FAILED); // still waiting for a successor
+    }
+}
+
+// Decoder slot that holds no track
+static decoder *audio_spare_decoder(
+    audio_ctx *ctx)
+{
+    for (int i = 0; i < (int)SDL_arraysize(ctx->decoders); i++)
+    {
+        decoder *dec = &ctx->decoders[i];
+        if (dec != ctx->dec && dec != ctx->next && dec != ctx->fading)
+        {
+            return dec;
+        }
+    }
+    return NULL; // three slots for three roles, not reached
+}
+
+// Starts the successor: back to back, or with crossfade over what is left of the current
+// track, which keeps decoding until the fade is done
+static void audio_splice_next(
+    audio_ctx *ctx,
+    pcm_block *block,
+    bool crossfade)
+{
+    decoder *finished = ctx->dec;
+    uint64_t remaining = decoder_total_samples(finished) - SDL_min(finished->mp3d.cur_sample, decoder_total_samples(finished));
+    ctx->prev_hz = finished->mp3d.info.hz;
+    ctx->prev_channels = finished->mp3d.info.channels;
+    ctx->prev_total = crossfade ? decoder_total_samples(finished) : finished->mp3d.cur_sample;
+    ctx->dec = ctx->next;
+
+    if (crossfade)
+    {
+        audio_fade_end(ctx);
+        ctx->fading = finished;
+
+        // Ends with the current track, at the rate of the next one
+        int frames = (int)(remaining / ctx->prev_channels * ctx->dec->mp3d.info.hz / ctx->prev_hz);
+        audio_fade_start(ctx, frames);
+    }
+    else
+    {
+        close_dec(finished);
+
+        // A fade still running was converted to the rate of the finished track
+        if (ctx->dec->mp3d.info.hz != ctx->prev_hz)
+        {
+            audio_fade_end(ctx);
+        }
+    }
+    ctx->next = audio_spare_decoder(ctx);
+
+    SDL_memcpy(block->data, ctx->next_block.data, ctx->next_block.samples * sizeof(mp3d_sample_t));
+    block->samples = ctx->next_block.samples;
+    block->hz = ctx->next_block.hz;
+    block->channels = ctx->next_block.channels;
+    block->position = ctx->next_block.position;
+    block->serial = ++ctx->serial;
+    audio_process_block(ctx, ctx->dec, block);
+    pcm_ring_write_commit(&ctx->ring);
+
+    ctx->start_pending = true;
+
+    ctx->next_state = NEXT_IDLE;
+    ctx->song_ended = false;
+    ctx->end_notified = false;
+    ctx->seek_pending = false;
+    ctx->refine_pending = false;
+}
+
+static bool audio_preroll_due(
+    audio_ctx *ctx)
+{
+    const decoder *dec = ctx->dec;
+    uint64_t total = decoder_total_samples(dec);
+    uint64_t preroll = (uint64_t)(ctx->preroll_ms + ctx->crossfade_ms) * dec->mp3d.info.hz * dec->mp3d.info.channels / 1000;
+
+    // Without a duration estimate the successor is requested at the end of the track
+    return total > 0 && dec->mp3d.cur_sample + preroll >= total;
+}
+
+// The successor is ready and the current track is within the crossfade of its end. A fade
+// doesn't start while one runs, nor without a duration estimate; those tracks splice.
+static bool audio_crossfade_due(
+    audio_ctx *ctx)
+{
+    const decoder *dec = ctx->dec;
+    uint64_t total = decoder_total_samples(dec);
+    uint64_t fade = (uint64_t)ctx->crossfade_ms * dec->mp3d.info.hz * dec->mp3d.info.channels / 1000;
+
+    return ctx->crossfade_ms > 0 && ctx->next_state == NEXT_READY && !ctx->song_ended && !crossfade_active(ctx->fade) &&
+           total > 0 && dec->mp3d.cur_sample + fade >= total;
+}
+
+// On a manual skip: the current track becomes the outgoing one of a crossfade into the track
+// about to be opened. Queued blocks are dropped, so it is moved back to what is audible first.
+static bool audio_fade_out_current(
+    audio_ctx *ctx)
+{
+    if (ctx->crossfade_ms == 0 || !ctx->loaded || ctx->paused || ctx->start_pending || crossfade_active(ctx->fade))
+    {
+        return false;
+    }
+
+    play_clock_state clock;
+    play_clock_get(&ctx->clock, &clock);
+    uint64_t position = play_clock_position(&clock, SDL_GetTicksNS());
+    if (clock.serial != ctx->serial || position >= decoder_total_samples(ctx->dec))
+    {
+        return false;
+    }
+
+    decoder *outgoing = ctx->dec;
+    if (decoder_poll_index(outgoing))
+    {
+        mp3dec_ex_seek(&outgoing->mp3d, position);
+    }
+    else
+    {
+        decoder_seek_fast(outgoing, position);
+    }
+
+    close_dec(ctx->next);
+    ctx->fading = outgoing;
+    ctx->dec = audio_spare_decoder(ctx);
+    ctx->next_state = NEXT_IDLE;
+    ctx->loaded = false;
+    ctx->song_ended = false;
+    ctx->end_notified = false;
+    ctx->seek_pending = false;
+    ctx->refine_pending = false;
+    audio_flush(ctx, 0);
+    return true;
+}
+
+static bool audio_process_commands(
+    audio_ctx *ctx)
+{
+    audio_command cmd;
+    char *open_file_name = NULL;
+    bool processed = false;
+
+    while (spsc_queue_pop(&ctx->commands, &cmd))
+    {
+        processed = true;
+
+        switch (cmd.type)
+        {
+            case AUDIO_CMD_OPEN:
+            {
+                // Of several opens in a row only the last one is carried out, the first
+                // one fades out of the playing track if crossfades are on
+                bool fade_pending = ctx->fading && !ctx->loaded;
+                SDL_free(open_file_name);
+                open_file_name = cmd.file_name;
+                ctx->track_generation = cmd.generation;
+                if (!fade_pending && !audio_fade_out_current(ctx))
+                {
+                    audio_unload(ctx);
+                }
+                break;
+            }
+
+            case AUDIO_CMD_STOP:
+                SDL_free(open_file_name);
+                open_file_name = NULL;
+                ctx->track_generation = cmd.generation;
+                audio_unload(ctx);
+                break;
+
+            case AUDIO_CMD_SEEK:
+            case AUDIO_CMD_SCRUB:
+                // Only the last seek of a batch is carried out, a dragged timeline sends one per frame
+                if (ctx->loaded || open_file_name)
+                {
+                    ctx->seek_pending = true;
+                    ctx->seek_exact = cmd.type == AUDIO_CMD_SEEK;
+                    ctx->seek_sample = cmd.value;
+                }
+                break;
+
+            case AUDIO_CMD_QUEUE_NEXT:
+                // An answer that arrives after the track was replaced is stale
+                if (ctx->loaded && ctx->next_state == NEXT_WAITING)
+                {
+                    if (cmd.file_name)
+                    {
+                        audio_open_next(ctx, cmd.file_name);
+                    }
+                    else
+                    {
+                        ctx->next_state = NEXT_NONE;
+                    }
+                }
+                SDL_free(cmd.file_name);
+                break;
+
+            case AUDIO_CMD_PAUSE:
+                // The clock is written under the stream lock, like the callback does
+                ctx->paused = cmd.value != 0;
+                if (cmd.value) {
+                    SDL_PauseAudioDevice(ctx->dev);
+                    SDL_LockAudioStream(ctx->stream);
+                    play_clock_pause(&ctx->clock, 1);
+                    SDL_UnlockAudioStream(ctx->stream);
+                } else {
+                    SDL_LockAudioStream(ctx->stream);
+                    play_clock_pause(&ctx->clock, 0);
+                    SDL_UnlockAudioStream(ctx->stream);
+                    SDL_ResumeAudioDevice(ctx->dev);
+                }
+                break;
+
+            case AUDIO_CMD_SET_PREROLL:
+                ctx->preroll_ms = (uint32_t)cmd.value;
+                break;
+
+            case AUDIO_CMD_SET_LATENCY:
+                ctx->latency_min_ms = (int)(cmd.value & 0xFFFFFFFF);
+                ctx->latency_max_ms = SDL_max((int)(cmd.value >> 32), ctx->latency_min_ms);
+                ctx->latency_ms = SDL_clamp(ctx->latency_ms, ctx->latency_min_ms, ctx->latency_max_ms);
+                break;
+
+            case AUDIO_CMD_SET_CROSSFADE:
+                // From the next track change on
+                ctx->crossfade_ms = (int)cmd.value;
+                break;
+
+            case AUDIO_CMD_SET_METERS:
+                // Switched on, they start over rather than from wherever they were left
+                ctx->meters_enabled = cmd.value != 0;
+                meters_reset(&ctx->meters);
+                break;
+
+            case AUDIO_CMD_SET_NORMALIZATION:
+                // Applies from the next decoded block, what is buffered plays out as it is
+                ctx->normalization = (int)cmd.value;
+                break;
+
+            case AUDIO_CMD_SET_SPECTRUM:
+            {
+                spectrum_analyzer *analyzer = spectrum_analyzer_create((int)(cmd.value & 0xFFFFFFFF), (int)(cmd.value >> 32));
+                if (analyzer)
+                {
+                    spectrum_analyzer_destroy(ctx->analyzer);
+                    ctx->analyzer = analyzer;
+                }
+                break;
+            }
+        }
+    }
+
+    if (open_file_name)
+    {
+        if (open_dec(ctx->dec, open_file_name))
+        {
+            ctx->loaded = true;
+            audio_flush(ctx, 0); // starts a new serial
+            if (ctx->fading)
+            {
+                audio_fade_start(ctx, (int)((int64_t)ctx->crossfade_ms * ctx->dec->mp3d.info.hz / 1000));
+            }
+        }
+        else
+        {
+            audio_fade_end(ctx);
+            ctx->seek_pending = false;
+            audio_post_event(ctx, AUDIO_END_OPEN_FAILED);
+        }
+        SDL_free(open_file_name);
+    }
+
+    return processed;
+}
+
+static void audio_apply_seek(
+    audio_ctx *ctx)
+{
+    decoder *dec = ctx->dec;
+
+    if (ctx->seek_exact && decoder_poll_index(dec))
+    {
+        mp3dec_ex_seek(&dec->mp3d, ctx->seek_sample);
+        ctx->refine_pending = false;
+    }
+    else
+    {
+        // First phase: jump by byte offset at once, without pre-roll decoding or waiting for the index
+        decoder_seek_fast(dec, ctx->seek_sample);
+        ctx->refine_pending = ctx->seek_exact;
     }
 
-    int decoded_samples = decode_samples(ctx->dec, buffer, want);
-    int decoded_bytes = decoded_samples * sizeof(mp3d_sample_t);
+    ctx->seek_pending = false;
+    ctx->song_ended = false;
+    ctx->end_notified = false;
+    audio_fade_end(ctx); // what was queued of it is gone, it would restart mid fade
+    audio_flush(ctx, dec->mp3d.cur_sample);
+}
 
-    SDL_PutAudioStreamData(ctx->stream, buffer, decoded_bytes);
-    SDL_free(buffer);
+static void audio_adapt_latency(
+    audio_ctx *ctx)
+{
+    Uint64 now = SDL_GetTicks();
+    int underruns = SDL_GetAtomicInt(&ctx->underruns);
 
-    if (decoded_samples == 0 && !ctx->song_ended)
+    if (underruns != ctx->underruns_seen)
     {
-        ctx->song_ended = true;
-        printf("Song ended\n");
+        ctx->underruns_seen = underruns;
+        ctx->latency_ms = SDL_min(ctx->latency_ms * 2, ctx->latency_max_ms);
+        ctx->stable_since = now;
+        printf("audio underrun, buffering %d ms now\n", ctx->latency_ms);
+    }
+    else if (now - ctx->stable_since >= AUDIO_LATENCY_STABLE_MS)
+    {
+        ctx->latency_ms = SDL_max(ctx->latency_ms - ctx->latency_ms / 4, ctx->latency_min_ms);
+        ctx->stable_since = now;
+    }
+}
+
+// Ring blocks that make up the buffer target for the current format
+static int audio_target_blocks(
+    audio_ctx *ctx)
+{
+    const decoder *dec = ctx->dec;
+    uint64_t samples = (uint64_t)ctx->latency_ms * dec->mp3d.info.hz * dec->mp3d.info.channels / 1000;
+    int blocks = (int)((samples + PCM_BLOCK_SAMPLES - 1) / PCM_BLOCK_SAMPLES);
+
+    // One block is drained by the callback while the next is decoded
+    return SDL_clamp(blocks, 2, PCM_RING_BLOCKS);
+}
+
+static int SDLCALL audio_decode_thread(
+    void *data)
+{
+    audio_ctx *ctx = (audio_ctx *)data;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+    while (SDL_GetAtomicInt(&ctx->running))
+    {
+        bool produced = audio_process_commands(ctx);
+
+        if (ctx->loaded && ctx->seek_pending)
+        {
+            audio_apply_seek(ctx);
+        }
+
+        // Second phase: an exact seek made from an estimate is corrected once the index is in.
+        // Seeking before that would make minimp3 scan the whole file here.
+        if (ctx->loaded && ctx->refine_pending && !ctx->song_ended && decoder_poll_index(ctx->dec))
+        {
+            // Blocks already queued keep playing, only the estimation error is skipped or repeated
+            mp3dec_ex_seek(&ctx->dec->mp3d, ctx->dec->mp3d.cur_sample);
+            ctx->refine_pending = false;
+        }
+
+        audio_adapt_latency(ctx);
+
+        int target_blocks = ctx->loaded ? audio_target_blocks(ctx) : 0;
+        if (ctx->loaded && (!ctx->song_ended || ctx->next_state == NEXT_READY) && pcm_ring_count(&ctx->ring) < target_blocks)
+        {
+            pcm_block *block = pcm_ring_write_begin(&ctx->ring);
+            if (block)
+            {
+                // The successor takes over this block and the rest of the current track fades out under it
+                bool crossfade = audio_crossfade_due(ctx);
+                uint64_t position = ctx->dec->mp3d.cur_sample;
+                int decoded_samples = ctx->song_ended || crossfade ? 0 : decode_samples(ctx->dec, block->data, PCM_BLOCK_SAMPLES);
+
+                if (decoded_samples > 0)
+                {
+                    block->samples = decoded_samples;
+                    block->hz = ctx->dec->mp3d.info.hz;
+                    block->channels = ctx->dec->mp3d.info.channels;
+                    block->position = position;
+                    block->serial = ctx->serial;
+                    audio_process_block(ctx, ctx->dec, block);
+                    pcm_ring_write_commit(&ctx->ring);
+                    produced = true;
+                }
+                else if (!crossfade)
+                {
+                    ctx->song_ended = true;
+                    SDL_SetAtomicInt(&ctx->primed, 0); // the ring runs dry at the end, nothing is late
+                }
 
-        if (ctx->end_callback)
+                if ((ctx->song_ended || crossfade) && ctx->next_state == NEXT_READY)
+                {
+                    // Back to back in the same stream, the callback only switches formats if they differ
+                    audio_splice_next(ctx, block, crossfade);
+                    produced = true;
+                }
+                else if (ctx->next_state == NEXT_IDLE && !ctx->start_pending && (ctx->song_ended || audio_preroll_due(ctx)))
+                {
+                    ctx->next_state = NEXT_WAITING;
+                    audio_post_event(ctx, AUDIO_NEXT_NEEDED);
+                }
+            }
+        }
+
+        if (produced && pcm_ring_count(&ctx->ring) >= target_blocks)
+        {
+            SDL_SetAtomicInt(&ctx->primed, 1);
+        }
+
+        // Track changes and the end are reported when they are heard, not when they are decoded
+        bool audible_pending = ctx->start_pending || (ctx->loaded && ctx->song_ended && ctx->next_state == NEXT_NONE && !ctx->end_notified);
+        if (audible_pending)
+        {
+            play_clock_state clock;
+            play_clock_get(&ctx->clock, &clock);
+
+            if (ctx->start_pending && clock.serial == ctx->serial)
+            {
+                ctx->start_pending = false;
+                audio_post_event(ctx, AUDIO_NEXT_STARTED);
+            }
+            else if (!ctx->start_pending && pcm_ring_count(&ctx->ring) == 0 && play_clock_position(&clock, SDL_GetTicksNS()) >= clock.limit)
+            {
+                // Nothing follows a finished track
+                printf("Song ended\n");
+                ctx->end_notified = true;
+                audio_post_event(ctx, AUDIO_END_FINISHED);
+            }
+        }
+
+        if (ctx->loaded)
         {
-            ctx->end_callback(ctx->callback_userdata);
+            decoder_poll_index(ctx->dec);
+        }
+
+        audio_publish_status(ctx);
+
+        if (!produced)
+        {
+            // Wake up periodically while the index is still being built
+            if (ctx->loaded && ctx->dec->index_job != NULL)
+            {
+                SDL_WaitSemaphoreTimeout(ctx->wake, 50);
+            }
+            else if (audible_pending)
+            {
+                SDL_WaitSemaphoreTimeout(ctx->wake, 10);
+            }
+            else
+            {
+                SDL_WaitSemaphore(ctx->wake);
+            }
         }
     }
+
+    return 0;
 }
 
 
@@ -87,13 +986,8 @@ void audio_pump(
    ============================================================ */
 int sdl_audio_init(
     void **audio_render,
-    int samplerate,
-    int channels,
-    int format,
-    int buffer /* unused in SDL3 */
-    )
+    int samplerate)
 {
-    (void)buffer;
     *audio_render = NULL;
 
     if (!SDL_Init(SDL_INIT_AUDIO)) {
@@ -106,28 +1000,91 @@ int sdl_audio_init(
         return 0;
     }
 
-    SDL_zero(ctx->spec);
-    ctx->spec.freq = samplerate;
-    ctx->spec.format = format ? SDL_AUDIO_F32 : SDL_AUDIO_S16;
-    ctx->spec.channels = channels;
-
-    /* Open default output device */
-    ctx->dev = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &ctx->spec);
+    /* Open default output device, in its own format unless a rate is asked for */
+    SDL_AudioSpec requested = {SDL_AUDIO_F32, 2, samplerate};
+    ctx->dev = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, samplerate > 0 ? &requested : NULL);
     if (!ctx->dev) {
         printf("error: couldn't open audio: %s\n", SDL_GetError());
         free(ctx);
         return 0;
     }
 
-    /* Create passthrough stream */
-    ctx->stream = SDL_CreateAudioStream(&ctx->spec, &ctx->spec);
+    // The device buffer plays out after the stream, the clock takes it into account
+    int device_frames = 0;
+    if (!SDL_GetAudioDeviceFormat(ctx->dev, &ctx->spec, &device_frames)) {
+        ctx->spec = requested;
+        ctx->spec.freq = samplerate > 0 ? samplerate : 48000;
+    }
+
+    /* Tracks are resampled to the device rate by us, the stream never changes format */
+    SDL_AudioSpec src_spec = {SDL_AUDIO_F32, 2, ctx->spec.freq};
+    ctx->resampler = resampler_create(ctx->spec.freq);
+    ctx->resampled = ctx->resampler ? (float *)malloc(resampler_max_output(ctx->resampler, RESAMPLER_CHUNK_FRAMES) * AUDIO_FRAME_BYTES) : NULL;
+    ctx->stream = ctx->resampled ? SDL_CreateAudioStream(&src_spec, &ctx->spec) : NULL;
     if (!ctx->stream) {
         printf("error: couldn't create audio stream: %s\n", SDL_GetError());
         SDL_CloseAudioDevice(ctx->dev);
+        resampler_destroy(ctx->resampler);
+        free(ctx->resampled);
+        free(ctx);
+        return 0;
+    }
+    printf("Audio device runs at %d Hz, %d channels\n", ctx->spec.freq, ctx->spec.channels);
+
+    ctx->dec = &ctx->decoders[0];
+    ctx->next = &ctx->decoders[1];
+    ctx->fading = NULL;
+    ctx->preroll_ms = AUDIO_DEFAULT_PREROLL_MS;
+    ctx->latency_min_ms = AUDIO_DEFAULT_LATENCY_MIN_MS;
+    ctx->latency_max_ms = AUDIO_DEFAULT_LATENCY_MAX_MS;
+    ctx->latency_ms = AUDIO_INITIAL_LATENCY_MS;
+    ctx->stable_since = SDL_GetTicks();
+    meters_reset(&ctx->meters);
+
+    play_clock_init(&ctx->clock, ctx->spec.freq, device_frames);
+    spsc_queue_init(&ctx->commands, ctx->command_storage, sizeof(audio_command), AUDIO_QUEUE_SIZE);
+    spsc_queue_init(&ctx->events, ctx->event_storage, sizeof(audio_event), AUDIO_QUEUE_SIZE);
+    spsc_queue_init(&ctx->spectra, ctx->spectrum_storage, sizeof(audio_spectrum), AUDIO_SPECTRUM_QUEUE_SIZE);
+
+    ctx->analyzer = spectrum_analyzer_create(SPECTRUM_DEFAULT_FFT_SIZE, SPECTRUM_DEFAULT_BANDS);
+    ctx->chain = dsp_chain_create();
+    ctx->fade = crossfade_create();
+    bool chain_ok = ctx->chain &&
+        dsp_chain_add(ctx->chain, &dsp_stage_eq) == AUDIO_STAGE_EQ &&
+        dsp_chain_add(ctx->chain, &dsp_stage_gain) == AUDIO_STAGE_VOLUME &&
+        dsp_chain_add(ctx->chain, &dsp_stage_limiter) == AUDIO_STAGE_LIMITER;
+    if (!ctx->analyzer || !chain_ok || !ctx->fade) {
+        printf("error: couldn't create spectrum analyzer, DSP chain or crossfade\n");
+        SDL_DestroyAudioStream(ctx->stream);
+        SDL_CloseAudioDevice(ctx->dev);
+        resampler_destroy(ctx->resampler);
+        free(ctx->resampled);
+        spectrum_analyzer_destroy(ctx->analyzer);
+        dsp_chain_destroy(ctx->chain);
+        crossfade_destroy(ctx->fade);
+        free(ctx);
+        return 0;
+    }
+
+    ctx->wake = SDL_CreateSemaphore(0);
+    SDL_SetAtomicInt(&ctx->running, 1);
+
+    ctx->decode_thread = SDL_CreateThread(audio_decode_thread, "plyr decode", ctx);
+    if (!ctx->decode_thread) {
+        printf("error: couldn't create decode thread: %s\n", SDL_GetError());
+        SDL_DestroyAudioStream(ctx->stream);
+        SDL_CloseAudioDevice(ctx->dev);
+        SDL_DestroySemaphore(ctx->wake);
+        spectrum_analyzer_destroy(ctx->analyzer);
+        dsp_chain_destroy(ctx->chain);
+        crossfade_destroy(ctx->fade);
+        resampler_destroy(ctx->resampler);
+        free(ctx->resampled);
         free(ctx);
         return 0;
     }
 
+    SDL_SetAudioStreamGetCallback(ctx->stream, audio_stream_callback, ctx);
     SDL_BindAudioStream(ctx->dev, ctx->stream);
 
     printf("Opened audio device: %s\n",
@@ -136,8 +1093,6 @@ int sdl_audio_init(
     /* Resume the audio device to start playback */
     SDL_ResumeAudioDevice(ctx->dev);
 
-    ctx->running = true;
-
     *audio_render = ctx;
 
     return 1;
@@ -151,8 +1106,10 @@ void sdl_audio_release(void *audio_render)
     audio_ctx *ctx = (audio_ctx *)audio_render;
     if (!ctx) return;
 
-    // Stop all future audio_pump calls
-    ctx->running = false;
+    // Stop the decode thread
+    SDL_SetAtomicInt(&ctx->running, 0);
+    SDL_SignalSemaphore(ctx->wake);
+    SDL_WaitThread(ctx->decode_thread, NULL);
 
     if (ctx->dev) {
         SDL_CloseAudioDevice(ctx->dev);
@@ -162,89 +1119,319 @@ void sdl_audio_release(void *audio_render)
         SDL_DestroyAudioStream(ctx->stream);
     }
 
+    // Commands that were never picked up still own their file names
+    audio_command cmd;
+    while (spsc_queue_pop(&ctx->commands, &cmd))
+    {
+        SDL_free(cmd.file_name);
+    }
+
+    for (int i = 0; i < (int)SDL_arraysize(ctx->decoders); i++)
+    {
+        close_dec(&ctx->decoders[i]);
+    }
+    spectrum_analyzer_destroy(ctx->analyzer);
+    dsp_chain_destroy(ctx->chain);
+    crossfade_destroy(ctx->fade);
+    resampler_destroy(ctx->resampler);
+    free(ctx->resampled);
+    SDL_DestroySemaphore(ctx->wake);
+
     free(ctx);
 }
 
 
 /* ============================================================
-   Set decoder
+   Commands (UI thread -> decode thread)
    ============================================================ */
-void sdl_audio_set_dec(
+static void audio_send(
+    audio_ctx *ctx,
+    int type,
+    uint64_t value,
+    const char *file_name)
+{
+    audio_command cmd;
+    cmd.type = type;
+    cmd.generation = SDL_GetAtomicInt(&ctx->generation);
+    cmd.value = value;
+    cmd.file_name = file_name ? SDL_strdup(file_name) : NULL;
+
+    if (!spsc_queue_push(&ctx->commands, &cmd))
+    {
+        printf("warning: audio command %d dropped, queue full\n", type);
+        SDL_free(cmd.file_name);
+        return;
+    }
+
+    SDL_SignalSemaphore(ctx->wake);
+}
+
+void sdl_audio_open(
     void *audio_render,
-    decoder *dec)
+    const char *file_name)
 {
     audio_ctx *ctx = (audio_ctx *)audio_render;
-    ctx->dec = dec;
-    ctx->song_ended = false;  // Reset flag when new decoder is set
+    if (!ctx) return;
+
+    SDL_AddAtomicInt(&ctx->generation, 1);
+    audio_send(ctx, AUDIO_CMD_OPEN, 0, file_name);
 }
 
-/* ============================================================
-   Update stream format (for new file with different sample rate)
-   ============================================================ */
-void sdl_audio_update_stream_format(
+void sdl_audio_queue_next(
     void *audio_render,
-    int samplerate,
-    int channels)
+    const char *file_name)
 {
     audio_ctx *ctx = (audio_ctx *)audio_render;
     if (!ctx) return;
 
-    // Destroy old stream
-    if (ctx->stream) {
-        SDL_DestroyAudioStream(ctx->stream);
-        ctx->stream = NULL;
-    }
+    audio_send(ctx, AUDIO_CMD_QUEUE_NEXT, 0, file_name);
+}
 
-    // Create new stream with correct input format (from MP3) and output format (device)
-    SDL_AudioSpec src_spec, dst_spec;
-    SDL_zero(src_spec);
-    SDL_zero(dst_spec);
+void sdl_audio_set_preroll(
+    void *audio_render,
+    int milliseconds)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
 
-    // Source: MP3 file format
-    src_spec.freq = samplerate;
-    src_spec.format = SDL_AUDIO_S16;  // minimp3 outputs S16
-    src_spec.channels = channels;
+    audio_send(ctx, AUDIO_CMD_SET_PREROLL, (uint64_t)SDL_max(milliseconds, 0), NULL);
+}
 
-    // Destination: Output device format
-    dst_spec = ctx->spec;
+void sdl_audio_set_latency(
+    void *audio_render,
+    int min_ms,
+    int max_ms)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
 
-    ctx->stream = SDL_CreateAudioStream(&src_spec, &dst_spec);
-    if (ctx->stream) {
-        SDL_BindAudioStream(ctx->dev, ctx->stream);
-        printf("Updated audio stream: %d Hz, %d channels -> %d Hz, %d channels\n",
-               samplerate, channels, ctx->spec.freq, ctx->spec.channels);
-    } else {
-        printf("error: couldn't recreate audio stream: %s\n", SDL_GetError());
-    }
+    uint64_t bounds = ((uint64_t)SDL_max(max_ms, 0) << 32) | (uint32_t)SDL_max(min_ms, 0);
+    audio_send(ctx, AUDIO_CMD_SET_LATENCY, bounds, NULL);
 }
 
-/* ============================================================
-   Set end callback
-   ============================================================ */
-void sdl_audio_set_end_callback(
+void sdl_audio_set_spectrum(
     void *audio_render,
-    audio_end_callback callback,
-    void *userdata)
+    int fft_size,
+    int bands)
 {
     audio_ctx *ctx = (audio_ctx *)audio_render;
     if (!ctx) return;
 
-    ctx->end_callback = callback;
-    ctx->callback_userdata = userdata;
+    uint64_t setup = ((uint64_t)SDL_max(bands, 0) << 32) | (uint32_t)SDL_max(fft_size, 0);
+    audio_send(ctx, AUDIO_CMD_SET_SPECTRUM, setup, NULL);
+}
+
+void sdl_audio_set_crossfade(
+    void *audio_render,
+    int milliseconds)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    audio_send(ctx, AUDIO_CMD_SET_CROSSFADE, (uint64_t)SDL_clamp(milliseconds, 0, CROSSFADE_MAX_MS), NULL);
+}
+
+void sdl_audio_set_meters(
+    void *audio_render,
+    int enabled)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    audio_send(ctx, AUDIO_CMD_SET_METERS, enabled ? 1 : 0, NULL);
+}
+
+void sdl_audio_set_normalization(
+    void *audio_render,
+    int mode)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    audio_send(ctx, AUDIO_CMD_SET_NORMALIZATION, (uint64_t)SDL_clamp(mode, AUDIO_NORMALIZE_OFF, AUDIO_NORMALIZE_ALBUM), NULL);
+}
+
+void sdl_audio_set_dsp_param(
+    void *audio_render,
+    int stage,
+    int param,
+    float value)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    dsp_chain_set_param(ctx->chain, stage, param, value);
+}
+
+void sdl_audio_set_dsp_enabled(
+    void *audio_render,
+    int stage,
+    int enabled)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    dsp_chain_set_enabled(ctx->chain, stage, enabled);
+}
+
+int sdl_audio_get_dsp_stats(
+    void *audio_render,
+    dsp_stage_stats *stats,
+    int max)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return 0;
+
+    return dsp_chain_get_stats(ctx->chain, stats, max);
+}
+
+void sdl_audio_stop(
+    void *audio_render)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    SDL_AddAtomicInt(&ctx->generation, 1);
+    audio_send(ctx, AUDIO_CMD_STOP, 0, NULL);
+}
+
+void sdl_audio_seek(
+    void *audio_render,
+    uint64_t sample)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    audio_send(ctx, AUDIO_CMD_SEEK, sample, NULL);
+}
+
+void sdl_audio_scrub(
+    void *audio_render,
+    uint64_t sample)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    audio_send(ctx, AUDIO_CMD_SCRUB, sample, NULL);
 }
 
-/* ============================================================
-   Pause
-   ============================================================ */
 void sdl_audio_pause(
     void *audio_render,
     int state)
 {
     audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return;
+
+    audio_send(ctx, AUDIO_CMD_PAUSE, state ? 1 : 0, NULL);
+}
+
+
+/* ============================================================
+   Events and status (decode thread -> UI thread)
+   ============================================================ */
+int sdl_audio_poll_event(
+    void *audio_render,
+    int *reason)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return 0;
+
+    audio_event event;
+    while (spsc_queue_pop(&ctx->events, &event))
+    {
+        // Events of a track that was replaced by a later open or stop are of no interest
+        if (event.generation == SDL_GetAtomicInt(&ctx->generation))
+        {
+            *reason = event.reason;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void sdl_audio_get_status(
+    void *audio_render,
+    audio_status *status)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx)
+    {
+        SDL_zerop(status);
+        return;
+    }
+
+    for (;;)
+    {
+        int seq = SDL_GetAtomicInt(&ctx->status_seq);
+        if (seq & 1)
+        {
+            SDL_CPUPauseInstruction();
+            continue;
+        }
+
+        SDL_MemoryBarrierAcquire();
+        SDL_memcpy(status, &ctx->status, sizeof(*status));
+        SDL_MemoryBarrierAcquire();
+
+        if (SDL_GetAtomicInt(&ctx->status_seq) == seq)
+        {
+            break;
+        }
+    }
+
+    // Interpolated to the moment of the call, the snapshot is only refreshed once per block
+    if (status->loaded)
+    {
+        play_clock_state clock;
+        play_clock_get(&ctx->clock, &clock);
+        status->position = play_clock_position(&clock, SDL_GetTicksNS());
+    }
+}
+
+int sdl_audio_get_spectrum(
+    void *audio_render,
+    audio_spectrum *spectrum)
+{
+    audio_ctx *ctx = (audio_ctx *)audio_render;
+    if (!ctx) return 0;
 
-    if (state) {
-        SDL_PauseAudioDevice(ctx->dev);
-    } else {
-        SDL_ResumeAudioDevice(ctx->dev);
+    play_clock_state clock;
+    play_clock_get(&ctx->clock, &clock);
+    uint64_t position = play_clock_position(&clock, SDL_GetTicksNS());
+
+    // Frames arrive in decode order: serials only grow and positions grow within a serial
+    for (;;)
+    {
+        if (!ctx->spectrum_has_pending)
+        {
+            if (!spsc_queue_pop(&ctx->spectra, &ctx->spectrum_pending))
+            {
+                break;
+            }
+            ctx->spectrum_has_pending = true;
+        }
+
+        const audio_spectrum *pending = &ctx->spectrum_pending;
+        if (pending->serial > clock.serial || (pending->serial == clock.serial && pending->position > position))
+        {
+            break; // still queued for playback
+        }
+
+        // Flushed or already played, the last one reached is what is heard now
+        if (pending->serial == clock.serial)
+        {
+            ctx->spectrum_shown = *pending;
+            ctx->spectrum_has_shown = true;
+        }
+        ctx->spectrum_has_pending = false;
     }
+
+    if (!ctx->spectrum_has_shown || ctx->spectrum_shown.serial != clock.serial)
+    {
+        return 0;
+    }
+
+    SDL_memcpy(spectrum, &ctx->spectrum_shown, sizeof(*spectrum));
+    return 1;
 }
@@ -1,43 +1,188 @@
 #pragma once
 
+#include "crossfade.h"
 #include "decode.h"
+#include "dsp_chain.h"
+#include "meters.h"
+#include "spectrum.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef void (*audio_end_callback)(void *userdata);
+// The audio engine runs on its own decode thread. Every function below is meant
+// for a single controlling thread (the UI): transport calls are queued as commands
+// and return at once, results come back through events and the status snapshot.
 
-void audio_pump(
-    void **audio_render);
+typedef enum audio_end_reason
+{
+    AUDIO_END_FINISHED,    // the track ended and nothing was queued after it
+    AUDIO_END_OPEN_FAILED, // the file passed to sdl_audio_open couldn't be opened
+    AUDIO_NEXT_NEEDED,     // the track is about to end, answer with sdl_audio_queue_next
+    AUDIO_NEXT_FAILED,     // the queued track couldn't be opened, answer with sdl_audio_queue_next
+    AUDIO_NEXT_STARTED,    // the queued track was spliced in and is the current one now
+} audio_end_reason;
 
+// Loudness normalization from the gains of the loudness scanner, see loudness.h
+typedef enum audio_normalization
+{
+    AUDIO_NORMALIZE_OFF,
+    AUDIO_NORMALIZE_TRACK,
+    AUDIO_NORMALIZE_ALBUM, // album gain where known, track gain otherwise
+} audio_normalization;
+
+// Stages of the output DSP chain in processing order, parameters are in dsp_stages.h
+typedef enum audio_dsp_stage
+{
+    AUDIO_STAGE_EQ,
+    AUDIO_STAGE_VOLUME,
+    AUDIO_STAGE_LIMITER,
+    AUDIO_STAGE_COUNT,
+} audio_dsp_stage;
+
+// How long before the end of a track its successor is opened and pre-decoded
+#define AUDIO_DEFAULT_PREROLL_MS 5000
+
+// Bounds of the adaptive output buffer: low latency for seeking, headroom for a busy system
+#define AUDIO_DEFAULT_LATENCY_MIN_MS 100
+#define AUDIO_DEFAULT_LATENCY_MAX_MS 1000
+
+// Published by the decode thread after every block and command
+typedef struct audio_status
+{
+    int generation;       // sdl_audio_open/sdl_audio_stop call this state belongs to
+    int loaded;           // a track is open
+    int hz;
+    int channels;
+    uint64_t position;    // audible sample (channels included), queued audio and device latency accounted for
+    uint64_t total;       // total samples, estimated until duration_exact is set
+    int duration_exact;
+    float index_progress; // background seek index scan in [0, 1]
+    int underruns;        // times the device found no data while playing
+    int latency_ms;       // current buffer target
+    int buffered_ms;      // decoded audio waiting for the device
+    float gain_db;        // loudness normalization applied to the current track
+} audio_status;
+
+// Spectrum of one decoded block, tagged with the samples it was taken from
+typedef struct audio_spectrum
+{
+    int serial;        // playback segment, a new one starts with every track, seek and stop
+    uint64_t position; // first sample of the block (channels included)
+    int samples;
+    int bands;
+    float levels[SPECTRUM_MAX_BANDS][2]; // dB above -100 dBFS per band and channel, low to high
+    int has_meters;      // measured only while sdl_audio_set_meters has them on
+    meter_levels meters;
+} audio_spectrum;
+
+// Opens the default device at samplerate, or at its native rate when samplerate is 0.
+// Tracks at other rates are resampled on the way to the device.
 int sdl_audio_init(
     void **audio_render,
-    int samplerate,
-    int channels,
-    int format,
-    int buffer);
+    int samplerate);
 
 void sdl_audio_release(
     void *audio_render);
 
-void sdl_audio_set_dec(
+// Drops whatever is playing and opens file_name, AUDIO_END_OPEN_FAILED is posted on failure.
+// With a crossfade set, what is playing fades out under the new track instead.
+void sdl_audio_open(
+    void *audio_render,
+    const char *file_name);
+
+// Answers AUDIO_NEXT_NEEDED/AUDIO_NEXT_FAILED with the track that follows the current one
+// without a gap. NULL means there is none and playback stops at the end of the track.
+void sdl_audio_queue_next(
+    void *audio_render,
+    const char *file_name);
+
+void sdl_audio_set_preroll(
+    void *audio_render,
+    int milliseconds);
+
+// Length of the constant power crossfade at track changes and skips, up to CROSSFADE_MAX_MS.
+// 0 splices tracks back to back. The successor is opened this much earlier than the pre-roll.
+void sdl_audio_set_crossfade(
+    void *audio_render,
+    int milliseconds);
+
+// Bounds the buffer target adapts within, it grows after underruns and shrinks while stable
+void sdl_audio_set_latency(
+    void *audio_render,
+    int min_ms,
+    int max_ms);
+
+// FFT size (power of two) and number of log-spaced bands of the spectrum analyzer
+void sdl_audio_set_spectrum(
+    void *audio_render,
+    int fft_size,
+    int bands);
+
+// Level meters and vectorscope in the spectrum frames, off costs nothing on the decode thread
+void sdl_audio_set_meters(
+    void *audio_render,
+    int enabled);
+
+// audio_normalization mode, applied from the next decoded block on
+void sdl_audio_set_normalization(
+    void *audio_render,
+    int mode);
+
+// DSP chain controls, written straight into the chain without queueing. They apply from the
+// next decoded block, so what is buffered already plays out unchanged.
+void sdl_audio_set_dsp_param(
+    void *audio_render,
+    int stage,
+    int param,
+    float value);
+
+void sdl_audio_set_dsp_enabled(
+    void *audio_render,
+    int stage,
+    int enabled);
+
+// CPU time per stage, returns the number of stages
+int sdl_audio_get_dsp_stats(
+    void *audio_render,
+    dsp_stage_stats *stats,
+    int max);
+
+void sdl_audio_stop(
+    void *audio_render);
+
+// Sample exact. Until the seek index is ready playback resumes from an estimate at once
+// and is moved to the exact position when the index comes in.
+void sdl_audio_seek(
     void *audio_render,
-    decoder *dec);
+    uint64_t sample);
 
-void sdl_audio_update_stream_format(
+// Approximate seek for timeline dragging: jumps to a nearby frame by byte offset without
+// decoding ahead, finish with sdl_audio_seek when the drag ends
+void sdl_audio_scrub(
     void *audio_render,
-    int samplerate,
-    int channels);
+    uint64_t sample);
 
 void sdl_audio_pause(
     void *audio_render,
     int state);
 
-void sdl_audio_set_end_callback(
+// Returns 1 and the next audio_end_reason of the current track, 0 when there is none
+int sdl_audio_poll_event(
+    void *audio_render,
+    int *reason);
+
+// Consistent copy of the latest state, never blocks the decode thread
+void sdl_audio_get_status(
+    void *audio_render,
+    audio_status *status);
+
+// Spectrum of the block being heard right now. The decode thread queues a frame per block
+// it decodes, frames are taken from that queue as playback reaches them. Returns 0 when
+// nothing audible has been analyzed, e.g. while stopped or right after a seek.
+int sdl_audio_get_spectrum(
     void *audio_render,
-    audio_end_callback callback,
-    void *userdata);
+    audio_spectrum *spectrum);
 
 #ifdef __cplusplus
 }
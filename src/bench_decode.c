@@ -0,0 +1,108 @@
+// Measures the CPU time the playback path spends per second of audio:
+// minimp3 decoding plus the SDL stream conversion to the F32 device format.
+// Built twice, bench_decode_s16 and bench_decode_f32 (MINIMP3_FLOAT_OUTPUT).
+#define MINIMP3_IMPLEMENTATION
+#include <minimp3_ex.h>
+
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef MINIMP3_FLOAT_OUTPUT
+#define BENCH_FORMAT SDL_AUDIO_F32
+#define BENCH_NAME "f32"
+#else
+#define BENCH_FORMAT SDL_AUDIO_S16
+#define BENCH_NAME "s16"
+#endif
+
+#define BENCH_BLOCK_SAMPLES 4096
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <file.mp3> [passes]\n", argv[0]);
+        return 1;
+    }
+
+    int passes = argc > 2 ? atoi(argv[2]) : 5;
+    if (passes < 1) passes = 1;
+
+    // Decode from memory so disk reads don't end up in the numbers
+    size_t file_size = 0;
+    void *file_data = SDL_LoadFile(argv[1], &file_size);
+    if (!file_data)
+    {
+        printf("ERROR: Cannot load file: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    static mp3dec_ex_t dec;
+    static mp3d_sample_t block[BENCH_BLOCK_SAMPLES];
+    static float device[BENCH_BLOCK_SAMPLES];
+
+    if (mp3dec_ex_open_buf(&dec, (const uint8_t *)file_data, file_size, MP3D_SEEK_TO_SAMPLE) || !dec.info.hz)
+    {
+        printf("ERROR: Not an MP3 file: %s\n", argv[1]);
+        SDL_free(file_data);
+        return 1;
+    }
+
+    SDL_AudioSpec src = {BENCH_FORMAT, dec.info.channels, dec.info.hz};
+    SDL_AudioSpec dst = {SDL_AUDIO_F32, dec.info.channels, dec.info.hz};
+    SDL_AudioStream *stream = SDL_CreateAudioStream(&src, &dst);
+    if (!stream)
+    {
+        printf("ERROR: Cannot create audio stream: %s\n", SDL_GetError());
+        mp3dec_ex_close(&dec);
+        SDL_free(file_data);
+        return 1;
+    }
+
+    Uint64 decode_ticks = 0, convert_ticks = 0, samples = 0;
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        mp3dec_ex_seek(&dec, 0);
+
+        for (;;)
+        {
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            size_t decoded = mp3dec_ex_read(&dec, block, BENCH_BLOCK_SAMPLES);
+            Uint64 t1 = SDL_GetPerformanceCounter();
+
+            if (!decoded)
+            {
+                break;
+            }
+
+            // Same hand-off as the stream callback: put, then let SDL produce device samples
+            SDL_PutAudioStreamData(stream, block, (int)(decoded * sizeof(mp3d_sample_t)));
+            while (SDL_GetAudioStreamData(stream, device, sizeof(device)) > 0)
+            {
+            }
+            Uint64 t2 = SDL_GetPerformanceCounter();
+
+            decode_ticks += t1 - t0;
+            convert_ticks += t2 - t1;
+            samples += decoded;
+        }
+    }
+
+    double freq = (double)SDL_GetPerformanceFrequency();
+    double audio_seconds = (double)samples / dec.info.channels / dec.info.hz;
+    double decode_ms = decode_ticks * 1000.0 / freq / audio_seconds;
+    double convert_ms = convert_ticks * 1000.0 / freq / audio_seconds;
+
+    printf("%s: %.1f s of audio, %d Hz, %d channels, %d passes\n", BENCH_NAME, audio_seconds / passes, dec.info.hz, dec.info.channels, passes);
+    printf("  decode   %.3f ms CPU per second of audio\n", decode_ms);
+    printf("  convert  %.3f ms CPU per second of audio\n", convert_ms);
+    printf("  total    %.3f ms CPU per second of audio (%.0fx realtime)\n", decode_ms + convert_ms, 1000.0 / (decode_ms + convert_ms));
+
+    SDL_DestroyAudioStream(stream);
+    mp3dec_ex_close(&dec);
+    SDL_free(file_data);
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Measures the resampler once per instruction set the CPU supports, for the rate pairs
+// a 48 kHz or 44.1 kHz device sees, and reports the cost per output frame, how much
+// faster than real time that is, and the quality: the signal to error ratio of a 1 kHz
+// sine and how far a tone above the output Nyquist frequency is pushed down.
+#include "dsp_kernels.h"
+#include "resampler.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BENCH_SECONDS 2
+#define BENCH_SKIP_FRAMES RESAMPLER_TAPS // filter start up, left out of the quality figures
+
+typedef struct bench_pair
+{
+    int in_hz;
+    int out_hz;
+} bench_pair;
+
+static const bench_pair pairs[] = {
+    {44100, 48000},
+    {22050, 48000},
+    {32000, 48000},
+    {48000, 44100},
+    {8000, 48000},
+};
+
+// Stereo sine at amplitude, interleaved decoder samples
+static void make_sine(mp3d_sample_t *samples, int frames, int hz, double frequency, double amplitude)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        double v = amplitude * sin(2.0 * M_PI * frequency * i / hz);
+#ifdef MINIMP3_FLOAT_OUTPUT
+        samples[i * 2] = samples[i * 2 + 1] = (float)v;
+#else
+        samples[i * 2] = samples[i * 2 + 1] = (int16_t)lrint(v * 32768.0);
+#endif
+    }
+}
+
+// Feeds the input in decoder sized chunks as the stream callback does, returns the output frames
+static int run(resampler *r, const mp3d_sample_t *samples, int frames, int hz, float *out)
+{
+    int written = 0;
+    for (int done = 0; done < frames; done += RESAMPLER_CHUNK_FRAMES)
+    {
+        int chunk = SDL_min(frames - done, RESAMPLER_CHUNK_FRAMES);
+        written += resampler_process(r, samples + done * 2, chunk, hz, 2, out + written * 2);
+    }
+    return written + resampler_drain(r, out + written * 2);
+}
+
+// Signal to error ratio in dB of the left channel against the ideal sine at the output rate
+static double sine_snr(const float *out, int frames, int hz, double frequency, double amplitude)
+{
+    double signal = 0.0, error = 0.0;
+    for (int i = BENCH_SKIP_FRAMES; i < frames - BENCH_SKIP_FRAMES; i++)
+    {
+        double ideal = amplitude * sin(2.0 * M_PI * frequency * i / hz);
+        signal += ideal * ideal;
+        error += (out[i * 2] - ideal) * (out[i * 2] - ideal);
+    }
+    return 10.0 * log10(signal / (error + 1e-30));
+}
+
+static double rms_db(const float *out, int frames, double amplitude)
+{
+    double sum = 0.0;
+    for (int i = BENCH_SKIP_FRAMES; i < frames - BENCH_SKIP_FRAMES; i++)
+    {
+        sum += out[i * 2] * out[i * 2];
+    }
+    double rms = sqrt(sum / (frames - 2 * BENCH_SKIP_FRAMES));
+    return 20.0 * log10(rms / (amplitude / sqrt(2.0)) + 1e-30);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 10;
+    if (rounds < 1) rounds = 1;
+
+    dsp_isa best = dsp_kernels_isa();
+
+    printf("%d rounds of %d s stereo, %d taps\n\n", rounds, BENCH_SECONDS, RESAMPLER_TAPS);
+    printf("%-14s %-8s %14s %14s %10s %12s\n", "rates", "isa", "ns per frame", "x real time", "SNR (dB)", "alias (dB)");
+
+    for (int p = 0; p < (int)SDL_arraysize(pairs); p++)
+    {
+        int in_hz = pairs[p].in_hz;
+        int out_hz = pairs[p].out_hz;
+        int frames = in_hz * BENCH_SECONDS;
+
+        resampler *r = resampler_create(out_hz);
+        mp3d_sample_t *samples = (mp3d_sample_t *)malloc((size_t)frames * 2 * sizeof(mp3d_sample_t));
+        float *out = (float *)malloc((size_t)resampler_max_output(r, frames) * 2 * sizeof(float));
+        if (!r || !samples || !out)
+        {
+            printf("out of memory\n");
+            return 1;
+        }
+
+        // A tone in the band the output can't carry, only downsampling has one
+        double alias = -INFINITY;
+        double nyquist = SDL_min(in_hz, out_hz) / 2.0;
+        if (out_hz < in_hz)
+        {
+            make_sine(samples, frames, in_hz, nyquist + (in_hz / 2.0 - nyquist) / 2.0, 0.5);
+            alias = rms_db(out, run(r, samples, frames, in_hz, out), 0.5);
+        }
+
+        make_sine(samples, frames, in_hz, 1000.0, 0.5);
+
+        double scalar_ns = 0.0;
+        for (int isa = DSP_ISA_SCALAR; isa <= (int)best; isa++)
+        {
+            dsp_kernels_select((dsp_isa)isa);
+
+            int written = 0;
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int i = 0; i < rounds; i++)
+            {
+                written = run(r, samples, frames, in_hz, out);
+            }
+            double ns = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / rounds / written;
+            if (isa == DSP_ISA_SCALAR)
+            {
+                scalar_ns = ns;
+            }
+
+            char rates[32];
+            SDL_snprintf(rates, sizeof(rates), "%d>%d", in_hz, out_hz);
+            printf("%-14s %-8s %7.1f (x%4.1f) %14.0f %10.1f", rates, dsp_isa_name((dsp_isa)isa), ns, scalar_ns / ns, 1e9 / out_hz / ns, sine_snr(out, written, out_hz, 1000.0, 0.5));
+            if (isfinite(alias))
+            {
+                printf(" %12.1f", alias);
+            }
+            printf("\n");
+        }
+
+        resampler_destroy(r);
+        free(samples);
+        free(out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Measures the spectrum kernels of dsp_kernels.c once per instruction set the CPU
+// supports and reports their speedup over the plain C variant, together with the
+// log10f loop the dB conversion replaces and its largest deviation from it.
+#include "dsp_kernels.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_FFT_SIZE 8192
+#define BENCH_BINS (BENCH_FFT_SIZE / 2 + 1)
+#define BENCH_BANDS 64
+#define BENCH_LEVELS (BENCH_BANDS * 2)
+
+typedef struct bench_result
+{
+    double band_power_ns;
+    double to_db_ns;
+    double decay_ns;
+} bench_result;
+
+static float bin_re[BENCH_BINS], bin_im[BENCH_BINS];
+static int band_start[BENCH_BANDS + 1];
+static float powers[BENCH_LEVELS], levels[BENCH_LEVELS];
+
+static double elapsed_ns(Uint64 start, int calls)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / calls;
+}
+
+static bench_result bench_kernels(int calls)
+{
+    bench_result result;
+    Uint64 start;
+
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < calls; i++)
+    {
+        dsp_band_power(bin_re, bin_im, band_start, BENCH_BANDS, &powers[0], 2);
+        dsp_band_power(bin_re, bin_im, band_start, BENCH_BANDS, &powers[1], 2);
+    }
+    result.band_power_ns = elapsed_ns(start, calls);
+
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < calls; i++)
+    {
+        dsp_to_db(powers, 1e-6f, 100.0f, levels, BENCH_LEVELS);
+    }
+    result.to_db_ns = elapsed_ns(start, calls);
+
+    // Scaled back up every round so the values don't all end up snapped to zero
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < calls; i++)
+    {
+        dsp_decay(levels, BENCH_LEVELS, 0.98f, 0.1f);
+        dsp_decay(levels, BENCH_LEVELS, 1.0f / 0.98f, 0.0f);
+    }
+    result.decay_ns = elapsed_ns(start, calls) / 2;
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    int calls = argc > 1 ? atoi(argv[1]) : 20000;
+    if (calls < 1) calls = 1;
+
+    // White noise spectrum, 64 log-spaced bands from 20 Hz to 20 kHz at 48 kHz
+    srand(1);
+    for (int i = 0; i < BENCH_BINS; i++)
+    {
+        bin_re[i] = (float)rand() / RAND_MAX - 0.5f;
+        bin_im[i] = (float)rand() / RAND_MAX - 0.5f;
+    }
+
+    double bin_hz = 48000.0 / BENCH_FFT_SIZE;
+    int start = (int)(20.0 / bin_hz);
+    for (int band = 0; band < BENCH_BANDS; band++)
+    {
+        int end = (int)(20.0 * pow(1000.0, (double)(band + 1) / BENCH_BANDS) / bin_hz + 0.5);
+        if (end <= start) end = start + 1;
+        band_start[band] = start;
+        start = end;
+    }
+    band_start[BENCH_BANDS] = start;
+
+    dsp_band_power(bin_re, bin_im, band_start, BENCH_BANDS, &powers[0], 2);
+    dsp_band_power(bin_re, bin_im, band_start, BENCH_BANDS, &powers[1], 2);
+
+    // What the dB conversion used to be
+    Uint64 ticks = SDL_GetPerformanceCounter();
+    for (int i = 0; i < calls; i++)
+    {
+        for (int j = 0; j < BENCH_LEVELS; j++)
+        {
+            float db = 10.0f * log10f(powers[j] * 1e-6f + 1e-10f) + 100.0f;
+            levels[j] = db > 0.0f ? db : 0.0f;
+        }
+    }
+    double log10f_ns = elapsed_ns(ticks, calls);
+
+    dsp_isa best = dsp_kernels_isa();
+    bench_result scalar = {0};
+
+    printf("%d calls, %d bins in %d bands per channel, %d levels\n\n", calls, band_start[BENCH_BANDS] - band_start[0], BENCH_BANDS, BENCH_LEVELS);
+    printf("%-8s %16s %16s %16s\n", "isa", "band power (ns)", "to dB (ns)", "decay (ns)");
+    printf("%-8s %16s %16.0f %16s\n", "log10f", "", log10f_ns, "");
+
+    for (int isa = DSP_ISA_SCALAR; isa <= (int)best; isa++)
+    {
+        dsp_kernels_select((dsp_isa)isa);
+        bench_result result = bench_kernels(calls);
+        if (isa == DSP_ISA_SCALAR)
+        {
+            scalar = result;
+        }
+
+        // Deviation from libm over the whole range the analyzer produces
+        float values[BENCH_LEVELS], approx[BENCH_LEVELS];
+        for (int i = 0; i < BENCH_LEVELS; i++)
+        {
+            values[i] = ldexpf(1.0f + i / (float)BENCH_LEVELS, i * 80 / BENCH_LEVELS - 40);
+        }
+        dsp_to_db(values, 1.0f, 200.0f, approx, BENCH_LEVELS);
+
+        float max_error = 0.0f;
+        for (int i = 0; i < BENCH_LEVELS; i++)
+        {
+            float reference = 10.0f * log10f(values[i] + 1e-10f) + 200.0f;
+            max_error = fmaxf(max_error, fabsf(approx[i] - reference));
+        }
+
+        printf("%-8s %9.0f (x%4.1f) %9.0f (x%4.1f) %9.0f (x%4.1f)   max dB error %.5f\n",
+               dsp_isa_name((dsp_isa)isa),
+               result.band_power_ns, scalar.band_power_ns / result.band_power_ns,
+               result.to_db_ns, scalar.to_db_ns / result.to_db_ns,
+               result.decay_ns, scalar.decay_ns / result.decay_ns,
+               max_error);
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include "cache.h"
+
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static SDL_InitState cache_init_state;
+static char cache_root[1024];
+
+static void cache_join(char *out, size_t out_size, const char *base, const char *tail)
+{
+    size_t len = strlen(base);
+    const char *sep = (len > 0 && (base[len - 1] == '/' || base[len - 1] == '\\')) ? "" : "/";
+
+    SDL_snprintf(out, out_size, "%s%s%s", base, sep, tail);
+}
+
+const char *cache_dir(void)
+{
+    if (SDL_ShouldInit(&cache_init_state))
+    {
+        const char *base = NULL;
+        const char *tail = "plyr";
+        char home_cache[1024];
+
+#if defined(_WIN32)
+        base = SDL_getenv("LOCALAPPDATA");
+        tail = "plyr/cache";
+#elif defined(__APPLE__)
+        if (SDL_getenv("HOME"))
+        {
+            cache_join(home_cache, sizeof(home_cache), SDL_getenv("HOME"), "Library/Caches");
+            base = home_cache;
+        }
+#else
+        base = SDL_getenv("XDG_CACHE_HOME");
+        if ((!base || !*base) && SDL_getenv("HOME"))
+        {
+            cache_join(home_cache, sizeof(home_cache), SDL_getenv("HOME"), ".cache");
+            base = home_cache;
+        }
+#endif
+
+        cache_root[0] = '\0';
+        if (base && *base)
+        {
+            cache_join(cache_root, sizeof(cache_root), base, tail);
+
+            if (!SDL_CreateDirectory(cache_root))
+            {
+                printf("warning: cache disabled, couldn't create %s: %s\n", cache_root, SDL_GetError());
+                cache_root[0] = '\0';
+            }
+        }
+
+        SDL_SetInitialized(&cache_init_state, true);
+    }
+
+    return cache_root[0] ? cache_root : NULL;
+}
+
+uint64_t cache_hash(const char *s)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while (*s)
+    {
+        hash ^= (uint8_t)*s++;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+int cache_entry_path(char *out, size_t out_size, const char *kind, const char *file_name, const char *ext)
+{
+    const char *root = cache_dir();
+    if (!root)
+    {
+        return 0;
+    }
+
+    char dir[1100];
+    cache_join(dir, sizeof(dir), root, kind);
+    if (!SDL_CreateDirectory(dir))
+    {
+        return 0;
+    }
+
+    SDL_snprintf(out, out_size, "%s/%016llx%s", dir, (unsigned long long)cache_hash(file_name), ext);
+
+    return 1;
+}
+
+int cache_file_stamp(const char *file_name, uint64_t *size, int64_t *mtime)
+{
+    SDL_PathInfo info;
+
+    if (!SDL_GetPathInfo(file_name, &info) || info.type != SDL_PATHTYPE_FILE)
+    {
+        return 0;
+    }
+
+    *size = info.size;
+    *mtime = info.modify_time;
+
+    return 1;
+}
+
+int cache_write_file(const char *path, const void *data, size_t size)
+{
+    char tmp[1200];
+    SDL_snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    if (!SDL_SaveFile(tmp, data, size))
+    {
+        return 0;
+    }
+
+    if (!SDL_RenamePath(tmp, path))
+    {
+        SDL_RemovePath(tmp);
+        return 0;
+    }
+
+    return 1;
+}
+
+typedef struct cache_entry
+{
+    char name[64];
+    uint64_t size;
+    SDL_Time used;
+} cache_entry;
+
+typedef struct cache_listing
+{
+    cache_entry *entries;
+    size_t count, capacity;
+    uint64_t total;
+} cache_listing;
+
+static SDL_EnumerationResult SDLCALL cache_list_entry(void *userdata, const char *dirname, const char *fname)
+{
+    cache_listing *listing = (cache_listing *)userdata;
+    char path[1200];
+    SDL_PathInfo info;
+
+    cache_join(path, sizeof(path), dirname, fname);
+    if (!SDL_GetPathInfo(path, &info) || info.type != SDL_PATHTYPE_FILE || strlen(fname) >= sizeof(listing->entries[0].name))
+    {
+        return SDL_ENUM_CONTINUE;
+    }
+
+    if (listing->count == listing->capacity)
+    {
+        size_t capacity = listing->capacity ? listing->capacity * 2 : 256;
+        cache_entry *entries = (cache_entry *)realloc(listing->entries, capacity * sizeof(cache_entry));
+        if (!entries)
+        {
+            return SDL_ENUM_FAILURE;
+        }
+        listing->entries = entries;
+        listing->capacity = capacity;
+    }
+
+    cache_entry *entry = &listing->entries[listing->count++];
+    SDL_strlcpy(entry->name, fname, sizeof(entry->name));
+    entry->size = info.size;
+    // Reads bump the access time on most mounts, fall back to the write time
+    entry->used = info.access_time > info.modify_time ? info.access_time : info.modify_time;
+    listing->total += info.size;
+
+    return SDL_ENUM_CONTINUE;
+}
+
+static int SDLCALL cache_compare_used(const void *a, const void *b)
+{
+    const cache_entry *ea = (const cache_entry *)a;
+    const cache_entry *eb = (const cache_entry *)b;
+
+    return (ea->used > eb->used) - (ea->used < eb->used);
+}
+
+int cache_evict(const char *kind, uint64_t max_bytes, uint64_t *total_bytes)
+{
+    const char *root = cache_dir();
+    cache_listing listing;
+    char dir[1100];
+    int evicted = 0;
+
+    if (!root)
+    {
+        return 0;
+    }
+
+    memset(&listing, 0, sizeof(listing));
+    cache_join(dir, sizeof(dir), root, kind);
+    SDL_EnumerateDirectory(dir, cache_list_entry, &listing);
+
+    if (listing.total > max_bytes)
+    {
+        SDL_qsort(listing.entries, listing.count, sizeof(cache_entry), cache_compare_used);
+
+        for (size_t i = 0; i < listing.count && listing.total > max_bytes; i++)
+        {
+            char path[1200];
+            cache_join(path, sizeof(path), dir, listing.entries[i].name);
+
+            if (SDL_RemovePath(path))
+            {
+                listing.total -= listing.entries[i].size;
+                evicted++;
+            }
+        }
+    }
+
+    if (total_bytes)
+    {
+        *total_bytes = listing.total;
+    }
+
+    free(listing.entries);
+
+    return evicted;
+}
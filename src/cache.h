@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per-user cache directory shared by the on-disk caches, e.g. ~/.cache/plyr
+const char *cache_dir(void);
+
+// 64-bit FNV-1a, used to turn a track path into a cache key
+uint64_t cache_hash(const char *s);
+
+// Builds "<cache_dir>/<kind>/<hash of file_name><ext>" and makes sure the kind directory exists.
+// Returns 0 when the cache directory is unavailable.
+int cache_entry_path(char *out, size_t out_size, const char *kind, const char *file_name, const char *ext);
+
+// Size and modification time a cache entry is validated against, returns 0 if the file is missing
+int cache_file_stamp(const char *file_name, uint64_t *size, int64_t *mtime);
+
+// Writes data to path through a temporary file so readers never see a partial entry
+int cache_write_file(const char *path, const void *data, size_t size);
+
+// Removes the least recently used entries of kind until their total size is at most max_bytes.
+// Returns the number of evicted entries, the remaining total is stored in total_bytes.
+int cache_evict(const char *kind, uint64_t max_bytes, uint64_t *total_bytes);
+
+#ifdef __cplusplus
+}
+#endif
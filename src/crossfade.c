@@ -0,0 +1,190 @@
+#include "crossfade.h"
+#include "dsp_kernels.h"
+#include "pcm_ring.h"
+#include "resampler.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct crossfade
+{
+    resampler *resampler; // outgoing rate to the incoming one
+
+    // Outgoing audio converted but not mixed yet, stereo float at the incoming rate. Holds
+    // a block of the largest size plus the output of one more chunk.
+    float *fifo;
+    int fifo_frames;
+    int fifo_capacity;
+
+    int active;
+    int ended; // the outgoing track ran out, no more feeding
+    int frames;
+    int done;
+
+    // Per block scratch, a mono block is the longest
+    float mono[PCM_BLOCK_SAMPLES];
+    float gain_in[PCM_BLOCK_SAMPLES];
+    float gain_out[PCM_BLOCK_SAMPLES];
+};
+
+crossfade *crossfade_create(void)
+{
+    return (crossfade *)calloc(1, sizeof(crossfade));
+}
+
+void crossfade_destroy(crossfade *fade)
+{
+    if (!fade)
+    {
+        return;
+    }
+
+    resampler_destroy(fade->resampler);
+    free(fade->fifo);
+    free(fade);
+}
+
+int crossfade_prepare(crossfade *fade, int hz)
+{
+    // A running fade keeps its converter, the next start builds the new one
+    if ((fade->resampler && resampler_out_hz(fade->resampler) == hz) || fade->active)
+    {
+        return 1;
+    }
+
+    resampler_destroy(fade->resampler);
+    free(fade->fifo);
+    fade->fifo = NULL;
+
+    fade->resampler = resampler_create(hz);
+    if (fade->resampler)
+    {
+        fade->fifo_capacity = PCM_BLOCK_SAMPLES + resampler_max_output(fade->resampler, RESAMPLER_CHUNK_FRAMES);
+        fade->fifo = (float *)malloc((size_t)fade->fifo_capacity * 2 * sizeof(float));
+    }
+
+    if (!fade->fifo)
+    {
+        resampler_destroy(fade->resampler);
+        fade->resampler = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+int crossfade_start(crossfade *fade, int hz, int frames)
+{
+    fade->active = 0;
+    if (!crossfade_prepare(fade, hz))
+    {
+        return 0;
+    }
+
+    resampler_reset(fade->resampler);
+    fade->fifo_frames = 0;
+    fade->ended = 0;
+    fade->frames = SDL_max(frames, 1);
+    fade->done = 0;
+    fade->active = 1;
+    return 1;
+}
+
+void crossfade_stop(crossfade *fade)
+{
+    fade->active = 0;
+}
+
+int crossfade_active(const crossfade *fade)
+{
+    return fade->active;
+}
+
+int crossfade_wanted(const crossfade *fade, int frames)
+{
+    if (!fade->active || fade->ended || fade->fifo_frames >= frames)
+    {
+        return 0;
+    }
+
+    return frames - fade->fifo_frames;
+}
+
+void crossfade_feed(crossfade *fade, const mp3d_sample_t *samples, int frames, int hz, int channels)
+{
+    if (!fade->active || fade->ended)
+    {
+        return;
+    }
+
+    float *out = fade->fifo + fade->fifo_frames * 2;
+    if (frames > 0)
+    {
+        fade->fifo_frames += resampler_process(fade->resampler, samples, frames, hz, channels, out);
+    }
+    else
+    {
+        // What the filter holds back is the end of the outgoing track
+        fade->fifo_frames += resampler_drain(fade->resampler, out);
+        fade->ended = 1;
+    }
+}
+
+int crossfade_mix(crossfade *fade, float *samples, int frames, int channels)
+{
+    if (!fade->active)
+    {
+        return 0;
+    }
+
+    if (fade->fifo_frames < frames)
+    {
+        memset(fade->fifo + fade->fifo_frames * 2, 0, (size_t)(frames - fade->fifo_frames) * 2 * sizeof(float));
+    }
+
+    const float *outgoing = fade->fifo;
+    if (channels == 1)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            fade->mono[i] = 0.5f * (fade->fifo[i * 2] + fade->fifo[i * 2 + 1]);
+        }
+        outgoing = fade->mono;
+    }
+
+    // Gains along the quarter circle, rotated a step per frame from the exact start of the block
+    double step = M_PI / 2.0 / fade->frames;
+    double c = cos(fade->done * step), s = sin(fade->done * step);
+    double cs = cos(step), sn = sin(step);
+    for (int i = 0; i < frames; i++)
+    {
+        int ramping = fade->done + i < fade->frames;
+        float in = ramping ? (float)s : 1.0f;
+        float out = ramping ? (float)c : 0.0f;
+        for (int ch = 0; ch < channels; ch++)
+        {
+            fade->gain_in[i * channels + ch] = in;
+            fade->gain_out[i * channels + ch] = out;
+        }
+
+        double t = c * cs - s * sn;
+        s = s * cs + c * sn;
+        c = t;
+    }
+
+    dsp_mix_f32(samples, fade->gain_in, outgoing, fade->gain_out, frames * channels);
+
+    int used = SDL_min(frames, fade->fifo_frames);
+    fade->fifo_frames -= used;
+    memmove(fade->fifo, fade->fifo + used * 2, (size_t)fade->fifo_frames * 2 * sizeof(float));
+
+    fade->done += frames;
+    fade->active = fade->done < fade->frames;
+    return fade->active;
+}
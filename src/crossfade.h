@@ -0,0 +1,44 @@
+#pragma once
+
+#include <minimp3_ex.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Constant power crossfade from the track that ends into the one that starts. The outgoing
+// track is fed in as it is decoded, converted to the rate and channels of the incoming one
+// and mixed into its blocks with gains of cos and sin over a quarter turn, so the summed
+// power stays level through the fade. Runs on the decode thread, mixing never allocates.
+#define CROSSFADE_MAX_MS 12000
+
+typedef struct crossfade crossfade;
+
+crossfade *crossfade_create(void);
+void crossfade_destroy(crossfade *fade);
+
+// Builds the rate converter into hz, one of the MPEG rates, ahead of a fade into a track
+// at that rate, so starting the fade costs nothing. Returns 0 when out of memory.
+int crossfade_prepare(crossfade *fade, int hz);
+
+// Starts a fade over frames frames of an incoming track at hz, cutting short the one
+// running. Returns 0 when out of memory.
+int crossfade_start(crossfade *fade, int hz, int frames);
+void crossfade_stop(crossfade *fade);
+int crossfade_active(const crossfade *fade);
+
+// Outgoing frames still needed to mix the next frames incoming frames, 0 once the outgoing
+// track ended
+int crossfade_wanted(const crossfade *fade, int frames);
+
+// Hands over decoded outgoing audio, interleaved mono or stereo at hz, at most
+// RESAMPLER_CHUNK_FRAMES frames per call. 0 frames mark the end of the outgoing track.
+void crossfade_feed(crossfade *fade, const mp3d_sample_t *samples, int frames, int hz, int channels);
+
+// Mixes the fade into the next frames of the incoming track, interleaved float. Outgoing
+// audio that ran out early counts as silence. Returns 0 once the fade is complete.
+int crossfade_mix(crossfade *fade, float *samples, int frames, int channels);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,56 +5,264 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdlib.h>
-#include <math.h>
 #define MINIMP3_IMPLEMENTATION
 #include "decode.h"
+#include "index_cache.h"
+#include "stream_io.h"
+
+#include <SDL3/SDL.h>
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-static void get_spectrum(decoder *dec, int numch)
+// Background scan that builds the frame index the way mp3dec_ex_seek() would,
+// streaming the file through its own reader so the decoder can play while it runs
+struct decoder_index_job
+{
+    SDL_Thread *thread;
+    SDL_AtomicInt cancel;
+    SDL_AtomicInt progress; // permille of the file scanned
+    SDL_AtomicInt done;     // 1 when the index is complete, -1 on failure
+    char *file_name;
+    size_t file_size;
+    mp3dec_ex_t scan;
+};
+
+static int index_job_frame(void *user_data, const uint8_t *frame, int frame_size, int free_format_bytes, size_t buf_size, uint64_t offset, mp3dec_frame_info_t *info)
 {
-    int i, ch, band;
-    const mp3dec_t *d = &dec->mp3d.mp3d;
-    // Average spectrum power for 32 frequency bands
-    for (ch = 0; ch < numch; ch++)
+    decoder_index_job *job = (decoder_index_job *)user_data;
+
+    if (SDL_GetAtomicInt(&job->cancel))
+    {
+        return MP3D_E_USER;
+    }
+
+    if ((job->scan.index.num_frames & 63) == 0 && job->file_size)
     {
-        for (band = 0; band < 32; band++)
+        uint64_t scanned = job->scan.start_offset + offset;
+        SDL_SetAtomicInt(&job->progress, (int)(scanned * 1000 / job->file_size));
+    }
+
+    return mp3dec_load_index(&job->scan, frame, frame_size, free_format_bytes, buf_size, offset, info);
+}
+
+static int SDLCALL index_job_thread(void *data)
+{
+    decoder_index_job *job = (decoder_index_job *)data;
+    stream_io *stream = stream_io_open(job->file_name, 0);
+    uint8_t *buf = (uint8_t *)malloc(MINIMP3_IO_SIZE);
+    int result = -1;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    if (stream && buf)
+    {
+        job->file_size = stream->size;
+
+        if (job->scan.start_offset < stream->size && stream->io.seek(job->scan.start_offset, stream) == 0)
         {
-            float band_power = 0;
-            for (i = 0; i < 9; i++)
+            int ret = mp3dec_iterate_cb(&stream->io, buf, MINIMP3_IO_SIZE, index_job_frame, job);
+
+            if ((!ret || ret == MP3D_E_USER) && !SDL_GetAtomicInt(&job->cancel))
             {
-                float sample = d->mdct_overlap[ch][i + band*9];
-                band_power += sample*sample;
+                for (size_t i = 0; i < job->scan.index.num_frames; i++)
+                {
+                    job->scan.index.frames[i].offset += job->scan.start_offset;
+                }
+                result = 1;
+
+                index_cache_store(job->file_name, &job->scan.index, job->scan.samples);
             }
-            // w/o averaging
-            dec->spectrum[band][ch] = band_power/9;
         }
     }
-    // Calculate dB scale from power for better visualization
-    for (ch = 0; ch < numch; ch++)
+
+    stream_io_close(stream);
+    free(buf);
+
+    SDL_SetAtomicInt(&job->progress, 1000);
+    SDL_SetAtomicInt(&job->done, result);
+
+    return 0;
+}
+
+static void index_job_free(decoder_index_job *job)
+{
+    if (job->scan.index.frames)
+    {
+        free(job->scan.index.frames);
+    }
+    SDL_free(job->file_name);
+    free(job);
+}
+
+static void start_index_job(decoder *dec, const char *file_name)
+{
+    decoder_index_job *job = (decoder_index_job *)calloc(1, sizeof(decoder_index_job));
+    if (!job)
+    {
+        return;
+    }
+
+    // Same starting state mp3dec_ex_seek() uses for its lazy scan
+    job->file_name = SDL_strdup(file_name);
+    job->scan.flags = MP3D_SEEK_TO_SAMPLE;
+    job->scan.info = dec->mp3d.info;
+    job->scan.start_offset = dec->mp3d.start_offset;
+    job->scan.free_format_bytes = dec->mp3d.free_format_bytes;
+    mp3dec_init(&job->scan.mp3d);
+
+    job->thread = SDL_CreateThread(index_job_thread, "plyr index", job);
+    if (!job->thread)
+    {
+        index_job_free(job);
+        return;
+    }
+
+    dec->index_job = job;
+}
+
+static void stop_index_job(decoder *dec)
+{
+    decoder_index_job *job = dec->index_job;
+    if (!job)
+    {
+        return;
+    }
+
+    SDL_SetAtomicInt(&job->cancel, 1);
+    SDL_WaitThread(job->thread, NULL);
+    index_job_free(job);
+    dec->index_job = NULL;
+}
+
+// Picks the seek table out of the first frame, minimp3 only reads the frame count and gapless info
+static int xing_toc_frame(void *user_data, const uint8_t *frame, int frame_size, int free_format_bytes, size_t buf_size, uint64_t offset, mp3dec_frame_info_t *info)
+{
+    decoder *dec = (decoder *)user_data;
+    (void)free_format_bytes;
+    (void)buf_size;
+
+    if (info->layer != 3)
+    {
+        return MP3D_E_USER;
+    }
+
+    // Side info length: MPEG1 17/32 bytes, MPEG2 and 2.5 9/17 bytes for mono/stereo
+    int mono = (frame[3] & 0xC0) == 0xC0;
+    int pos = 4 + (HDR_IS_CRC(frame) ? 2 : 0) + (HDR_TEST_MPEG1(frame) ? (mono ? 17 : 32) : (mono ? 9 : 17));
+    if (pos + 8 > frame_size || (memcmp(frame + pos, "Xing", 4) && memcmp(frame + pos, "Info", 4)))
+    {
+        return MP3D_E_USER;
+    }
+
+    const uint8_t *tag = frame + pos + 4;
+    uint32_t flags = (uint32_t)(tag[0] << 24) | (tag[1] << 16) | (tag[2] << 8) | tag[3];
+    tag += 4;
+
+    if (flags & FRAMES_FLAG)
     {
-        for (band = 0; band < 32; band++)
+        tag += 4;
+    }
+    if (flags & BYTES_FLAG)
+    {
+        dec->toc_bytes = (uint32_t)(tag[0] << 24) | (tag[1] << 16) | (tag[2] << 8) | tag[3];
+        tag += 4;
+    }
+    if ((flags & TOC_FLAG) && tag + 100 <= frame + frame_size)
+    {
+        memcpy(dec->toc, tag, sizeof(dec->toc));
+        dec->has_toc = 1;
+        dec->toc_offset = offset;
+        if (!dec->toc_bytes)
         {
-            float power = dec->spectrum[band][ch];
-            float db_offset = 100;      // to shift dB values from [0..-inf] to [max..0]
-            float db = 10*log10f(power + 1e-15f) + db_offset;
-            if (db < 0) db = 0;
-            dec->spectrum[band][ch] = db;
+            dec->toc_bytes = dec->stream->size - offset;
         }
     }
+
+    return MP3D_E_USER;
+}
+
+static void read_xing_toc(decoder *dec)
+{
+    mp3dec_ex_t *d = &dec->mp3d;
+
+    // The read buffer is empty right after opening and the reader is put back where minimp3 left it
+    if (dec->stream->io.seek(0, dec->stream) == 0)
+    {
+        mp3dec_iterate_cb(&dec->stream->io, (uint8_t *)d->file.buffer, d->file.size, xing_toc_frame, dec);
+    }
+    dec->stream->io.seek(d->start_offset, dec->stream);
 }
 
-int decode_samples(decoder *dec, uint8_t *buf, int bytes)
+static void seek_to_byte(decoder *dec, uint64_t offset, uint64_t sample)
 {
-    memset(buf, 0, bytes);
-    int samples = mp3dec_ex_read(&dec->mp3d, (mp3d_sample_t*)buf, bytes/sizeof(mp3d_sample_t));
+    mp3dec_ex_t *d = &dec->mp3d;
+    int flags = d->flags;
+
+    // Without MP3D_SEEK_TO_SAMPLE minimp3 only moves the reader, the decoder resyncs on the next frame header
+    d->flags &= ~MP3D_SEEK_TO_SAMPLE;
+    mp3dec_ex_seek(d, offset);
+    d->flags = flags;
+
+    d->cur_sample = sample;
+    d->to_skip = 0;
+}
+
+void decoder_seek_fast(decoder *dec, uint64_t sample)
+{
+    mp3dec_ex_t *d = &dec->mp3d;
+    uint64_t total = decoder_total_samples(dec);
+
+    if (sample == 0 || total == 0)
+    {
+        mp3dec_ex_seek(d, 0);
+        return;
+    }
+
+    if (d->indexes_built && d->index.num_frames)
+    {
+        // Start of the frame holding sample, the bit reservoir isn't refilled so a frame may come out silent
+        size_t i = mp3dec_idx_binary_search(&d->index, sample + d->start_delay);
+        uint64_t frame_sample = d->index.frames[i].sample;
+        seek_to_byte(dec, d->index.frames[i].offset, frame_sample > (uint64_t)d->start_delay ? frame_sample - d->start_delay : 0);
+        return;
+    }
 
-    if (samples > 0)
+    if (sample >= total)
     {
-        get_spectrum(dec, dec->mp3d.info.channels);
+        sample = total - 1;
     }
 
-    return samples;
+    uint64_t offset;
+    if (dec->has_toc)
+    {
+        // Linear interpolation between the percent entries, as the Xing reference decoder does
+        float percent = (float)sample * 100.0f / (float)total;
+        int a = (int)percent;
+        if (a > 99) a = 99;
+        float fa = dec->toc[a];
+        float fb = a < 99 ? dec->toc[a + 1] : 256.0f;
+        float fx = fa + (fb - fa) * (percent - a);
+        offset = dec->toc_offset + (uint64_t)(fx * (1.0f / 256.0f) * (float)dec->toc_bytes);
+    }
+    else
+    {
+        // Constant bitrate assumed, the same estimate decoder_total_samples makes
+        uint64_t bytes = dec->stream->size > d->start_offset ? dec->stream->size - d->start_offset : 0;
+        offset = d->start_offset + bytes * sample / total;
+    }
+
+    if (offset < d->start_offset)
+    {
+        offset = d->start_offset;
+    }
+
+    seek_to_byte(dec, offset, sample);
+}
+
+// Decodes up to max_samples interleaved samples, only the returned count is written
+int decode_samples(decoder *dec, mp3d_sample_t *buf, int max_samples)
+{
+    return (int)mp3dec_ex_read(&dec->mp3d, buf, max_samples);
 }
 
 int open_dec(decoder *dec, const char *file_name)
@@ -69,7 +277,10 @@ int open_dec(decoder *dec, const char *file_name)
 
     printf("Attempting to open file: %s\n", file_name);
 
-    int result = mp3dec_ex_open(&dec->mp3d, file_name, MP3D_SEEK_TO_SAMPLE);
+    // Only the first frames are parsed here, the index is built in the background.
+    // The file is streamed rather than mapped, so opening costs the same for any length.
+    dec->stream = stream_io_open(file_name, 0);
+    int result = dec->stream ? mp3dec_ex_open_cb(&dec->mp3d, &dec->stream->io, MP3D_SEEK_TO_SAMPLE | MP3D_DO_NOT_SCAN) : MP3D_E_IOERROR;
 
     printf("mp3dec_ex_open result: %d\n", result);
     printf("  samples: %llu\n", (unsigned long long)dec->mp3d.samples);
@@ -87,47 +298,136 @@ int open_dec(decoder *dec, const char *file_name)
         else if (result == -2) fprintf(stderr, "  Error: Not enough memory\n");
         else fprintf(stderr, "  Error: Unknown error code\n");
 
+        close_dec(dec);
         return 0;
     }
 
-    if (!dec->mp3d.samples)
+    if (!dec->mp3d.info.hz || !dec->mp3d.info.channels)
     {
         fprintf(stderr, "decode error: no audio samples found in file: %s\n", file_name);
         fprintf(stderr, "  This might indicate a corrupted file or unsupported format (e.g., MP4/M4A)\n");
-        mp3dec_ex_close(&dec->mp3d);
+        close_dec(dec);
         return 0;
     }
 
     printf("Successfully opened MP3: %llu samples, %d Hz, %d channels\n",
            (unsigned long long)dec->mp3d.samples, dec->mp3d.info.hz, dec->mp3d.info.channels);
 
+    if (dec->mp3d.vbr_tag_found)
+    {
+        read_xing_toc(dec);
+    }
+
+    // Tracks the loudness scanner hasn't reached yet play at their own level
+    dec->has_loudness = loudness_cache_load(file_name, &dec->loudness, NULL);
+
+    uint64_t cached_samples = 0;
+    if (index_cache_load(file_name, &dec->mp3d.index, &cached_samples))
+    {
+        // Known track, no need to scan it again
+        dec->mp3d.indexes_built = 1;
+        if (!dec->mp3d.vbr_tag_found)
+        {
+            dec->mp3d.samples = cached_samples;
+        }
+        dec->index_ready = 1;
+        return 1;
+    }
+
+    start_index_job(dec, file_name);
+    if (!dec->index_job)
+    {
+        // Let minimp3 build the index on the first seek instead
+        dec->index_ready = 1;
+    }
+
     return 1;
 }
 
-int close_dec(decoder *dec)
+int decoder_poll_index(decoder *dec)
 {
-    mp3dec_ex_close(&dec->mp3d);
-    memset(dec, 0, sizeof(*dec));
+    decoder_index_job *job = dec->index_job;
+    if (!job)
+    {
+        return dec->index_ready;
+    }
+
+    int done = SDL_GetAtomicInt(&job->done);
+    if (!done)
+    {
+        return 0;
+    }
+
+    SDL_WaitThread(job->thread, NULL);
+
+    if (done > 0)
+    {
+        if (dec->mp3d.index.frames)
+        {
+            free(dec->mp3d.index.frames);
+        }
+
+        dec->mp3d.index = job->scan.index;
+        dec->mp3d.indexes_built = 1;
+        memset(&job->scan.index, 0, sizeof(job->scan.index));
+
+        if (!dec->mp3d.vbr_tag_found)
+        {
+            dec->mp3d.samples = job->scan.samples;
+        }
+    }
+
+    index_job_free(job);
+    dec->index_job = NULL;
+    dec->index_ready = 1;
+
     return 1;
 }
 
-// Gradually decay spectrum values to zero (for pause effect)
-void decay_spectrum(decoder *dec)
+float decoder_index_progress(const decoder *dec)
 {
-    if (!dec)
-        return;
+    if (!dec->index_job)
+    {
+        return dec->index_ready ? 1.0f : 0.0f;
+    }
 
-    const float decay_rate = 0.98f; // Adjust for faster/slower fall
+    return SDL_GetAtomicInt(&dec->index_job->progress) / 1000.0f;
+}
 
-    for (int band = 0; band < 32; band++)
+int decoder_duration_exact(const decoder *dec)
+{
+    return dec->mp3d.vbr_tag_found || dec->index_ready;
+}
+
+uint64_t decoder_estimate_samples(const mp3dec_ex_t *d, uint64_t file_size)
+{
+    if (!d->info.bitrate_kbps)
     {
-        for (int ch = 0; ch < 2; ch++)
-        {
-            dec->spectrum[band][ch] *= decay_rate;
+        return d->samples;
+    }
 
-            // Snap to zero when very small to avoid floating point drift
-            if (dec->spectrum[band][ch] < 0.1f)
-                dec->spectrum[band][ch] = 0.0f;
-        }
+    uint64_t bytes = file_size > d->start_offset ? file_size - d->start_offset : 0;
+    return bytes * 8 * (uint64_t)d->info.hz * d->info.channels / ((uint64_t)d->info.bitrate_kbps * 1000);
+}
+
+uint64_t decoder_total_samples(const decoder *dec)
+{
+    const mp3dec_ex_t *d = &dec->mp3d;
+
+    if (decoder_duration_exact(dec))
+    {
+        return d->samples;
     }
+
+    // Good enough for CBR files, corrected once the scan has finished
+    return decoder_estimate_samples(d, dec->stream ? dec->stream->size : d->file.size);
+}
+
+int close_dec(decoder *dec)
+{
+    stop_index_job(dec);
+    mp3dec_ex_close(&dec->mp3d);
+    stream_io_close(dec->stream);
+    memset(dec, 0, sizeof(*dec));
+    return 1;
 }
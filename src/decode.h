@@ -1,26 +1,61 @@
 #pragma once
 #include <minimp3_ex.h>
+#include "loudness.h"
 #include <stdint.h>
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Set by the PLYR_FLOAT_DECODE build option: minimp3 then decodes straight to float32,
+// which the resampler takes as is instead of converting it from S16
+#ifdef MINIMP3_FLOAT_OUTPUT
+#define DECODER_FLOAT_OUTPUT 1
+#else
+#define DECODER_FLOAT_OUTPUT 0
+#endif
+
 typedef int (*PARSE_GET_FILE_CB)(void *user, char **file_name);
 typedef int (*PARSE_INFO_CB)(void *user, char *file_name, int rate, int mp3_channels, float duration);
 
+typedef struct decoder_index_job decoder_index_job;
+typedef struct stream_io stream_io;
+
 typedef struct decoder
 {
     mp3dec_ex_t mp3d;
+    stream_io *stream; // file input of mp3d, heap allocated so the decoder can be moved
     float mp3_duration;
-    float spectrum[32][2]; // for visualization
+    decoder_index_job *index_job; // background scan building the seek index
+    int index_ready;              // seek index and exact duration are available
+    uint8_t toc[100];             // Xing table: file position of every percent of the track, in 256ths of toc_bytes
+    int has_toc;
+    uint64_t toc_offset;          // file position of the Xing frame the table is relative to
+    uint64_t toc_bytes;
+    loudness_info loudness;       // from the loudness cache, valid when has_loudness is set
+    int has_loudness;
 } decoder;
 
-extern decoder _dec;
-
 int open_dec(decoder *dec, const char *file_name);
 int close_dec(decoder *dec);
-int decode_samples(decoder *dec, uint8_t *buf, int bytes);
-void decay_spectrum(decoder *dec);
+int decode_samples(decoder *dec, mp3d_sample_t *buf, int max_samples);
+
+// Installs the background index once it is complete, returns index_ready.
+// The caller must own the decoder, like the audio decode thread does.
+int decoder_poll_index(decoder *dec);
+
+// Jumps close to sample by byte offset without decoding anything: to the frame from the index
+// when it is ready, otherwise to the Xing table or bitrate estimate. mp3dec_ex_seek() is exact.
+void decoder_seek_fast(decoder *dec, uint64_t sample);
+
+// Progress of the background index scan in [0, 1]
+float decoder_index_progress(const decoder *dec);
+
+// Total samples (channels included), estimated from the bitrate until the duration is known
+uint64_t decoder_total_samples(const decoder *dec);
+
+// Total samples of a file opened without scanning, from the size and the first frame's bitrate
+uint64_t decoder_estimate_samples(const mp3dec_ex_t *d, uint64_t file_size);
+int decoder_duration_exact(const decoder *dec);
 
 #ifdef __cplusplus
 }
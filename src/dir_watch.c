@@ -0,0 +1,459 @@
+#include "dir_watch.h"
+
+#include <SDL3/SDL.h>
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#define DIR_WATCH_MAX_DEPTH 32 // the library walk goes no deeper either
+#define DIR_WATCH_POLL_MS 250  // how long stopping the thread can take
+
+// The inotify watches of a user are shared by all of their programs: editors, file managers and
+// sync clients stop working once they run out. The tree gets a quarter of them at most.
+#define DIR_WATCH_SHARE 4
+#define DIR_WATCH_DEFAULT_LIMIT 8192 // the kernel's limit before it scaled with memory
+
+// Files are reported once written, folders as soon as they appear since their content may
+// arrive before the watch on them does
+#define DIR_WATCH_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+// statfs magic numbers of file systems other machines can change
+static const uint32_t dir_watch_remote_fs[] = {
+    0x00006969, // NFS
+    0x0000517B, // SMB
+    0xFF534D42, // CIFS
+    0xFE534D42, // SMB2
+    0x65735546, // FUSE: sshfs, rclone and the like
+    0x01021997, // 9P
+    0x00C36400, // Ceph
+    0x5346414F, // AFS
+};
+
+struct dir_watch
+{
+    char *root;
+    int fd;
+    SDL_Thread *thread;
+    SDL_AtomicInt stop;
+    SDL_AtomicInt active;
+
+    // Changes not taken yet
+    SDL_Mutex *lock;
+    char **changes;
+    int change_count;
+    int change_capacity;
+    int lost;
+    Uint64 last_event_ns;
+
+    // Folder of every watch descriptor, only the thread uses it
+    char **dirs;
+    int dir_capacity;
+    int dir_count;
+    int dir_limit;
+};
+
+static int dir_watch_depth(const char *dir)
+{
+    int depth = *dir ? 1 : 0;
+    for (; *dir; dir++)
+    {
+        depth += *dir == '/';
+    }
+    return depth;
+}
+
+static void dir_watch_changed(dir_watch *w, char *path)
+{
+    SDL_LockMutex(w->lock);
+    if (w->change_count == w->change_capacity)
+    {
+        int capacity = w->change_capacity ? w->change_capacity * 2 : 64;
+        char **changes = (char **)SDL_realloc(w->changes, capacity * sizeof(char *));
+        if (!changes)
+        {
+            // Can't keep track any more, a full scan will catch up
+            w->lost = 1;
+            SDL_free(path);
+            path = NULL;
+        }
+        else
+        {
+            w->changes = changes;
+            w->change_capacity = capacity;
+        }
+    }
+
+    if (path)
+    {
+        w->changes[w->change_count++] = path;
+    }
+    w->last_event_ns = SDL_GetTicksNS();
+    SDL_UnlockMutex(w->lock);
+}
+
+static int dir_watch_limit(void)
+{
+    int limit = DIR_WATCH_DEFAULT_LIMIT;
+    FILE *file = fopen("/proc/sys/fs/inotify/max_user_watches", "r");
+    if (file)
+    {
+        if (fscanf(file, "%d", &limit) != 1 || limit <= 0)
+        {
+            limit = DIR_WATCH_DEFAULT_LIMIT;
+        }
+        fclose(file);
+    }
+    return limit / DIR_WATCH_SHARE;
+}
+
+// Watches dir and the folders below it, returns 0 when the watches ran out
+static int dir_watch_add(dir_watch *w, const char *dir)
+{
+    if (w->dir_count >= w->dir_limit)
+    {
+        return 0;
+    }
+
+    char *full = NULL;
+    if (SDL_asprintf(&full, "%s%s%s", w->root, *dir ? "/" : "", dir) < 0)
+    {
+        return 0;
+    }
+
+    int wd = inotify_add_watch(w->fd, full, DIR_WATCH_EVENTS);
+    if (wd < 0)
+    {
+        // A folder that is gone again doesn't matter. SDL_free may be an allocator that
+        // doesn't keep errno.
+        int err = errno;
+        SDL_free(full);
+        return err != ENOSPC && err != ENOMEM;
+    }
+
+    if (wd >= w->dir_capacity)
+    {
+        int capacity = SDL_max(wd + 1, w->dir_capacity * 2);
+        char **dirs = (char **)realloc(w->dirs, capacity * sizeof(char *));
+        if (!dirs)
+        {
+            SDL_free(full);
+            return 0;
+        }
+        memset(dirs + w->dir_capacity, 0, (capacity - w->dir_capacity) * sizeof(char *));
+        w->dirs = dirs;
+        w->dir_capacity = capacity;
+    }
+
+    // The same folder reached by another path keeps its descriptor, the path is updated
+    w->dir_count += !w->dirs[wd];
+    SDL_free(w->dirs[wd]);
+    w->dirs[wd] = SDL_strdup(dir);
+
+    DIR *listing = dir_watch_depth(dir) < DIR_WATCH_MAX_DEPTH ? opendir(full) : NULL;
+    SDL_free(full);
+    if (!listing)
+    {
+        return 1;
+    }
+
+    int ok = 1;
+    struct dirent *entry;
+    while (ok && !SDL_GetAtomicInt(&w->stop) && (entry = readdir(listing)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        int is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+        {
+            struct stat st;
+            is_dir = fstatat(dirfd(listing), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+        }
+
+        char *child = NULL;
+        if (is_dir && SDL_asprintf(&child, "%s%s%s", dir, *dir ? "/" : "", entry->d_name) >= 0)
+        {
+            ok = dir_watch_add(w, child);
+            SDL_free(child);
+        }
+    }
+    closedir(listing);
+
+    return ok;
+}
+
+static int dir_watch_event(dir_watch *w, const struct inotify_event *event)
+{
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+        SDL_LockMutex(w->lock);
+        w->lost = 1;
+        w->last_event_ns = SDL_GetTicksNS();
+        SDL_UnlockMutex(w->lock);
+        return 1;
+    }
+
+    if (event->wd < 0 || event->wd >= w->dir_capacity || !w->dirs[event->wd])
+    {
+        return 1;
+    }
+
+    if (event->mask & IN_IGNORED)
+    {
+        SDL_free(w->dirs[event->wd]);
+        w->dirs[event->wd] = NULL;
+        w->dir_count--;
+        return 1;
+    }
+
+    // New files are reported once they have been written
+    if (!event->len || event->name[0] == '.' || ((event->mask & IN_CREATE) && !(event->mask & IN_ISDIR)))
+    {
+        return 1;
+    }
+
+    const char *dir = w->dirs[event->wd];
+    char *path = NULL;
+    if (SDL_asprintf(&path, "%s%s%s", dir, *dir ? "/" : "", event->name) < 0)
+    {
+        return 1;
+    }
+
+    int ok = 1;
+    if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+    {
+        ok = dir_watch_add(w, path);
+    }
+    dir_watch_changed(w, path);
+
+    return ok;
+}
+
+static int SDLCALL dir_watch_thread(void *data)
+{
+    dir_watch *w = (dir_watch *)data;
+    union
+    {
+        struct inotify_event event; // aligns the buffer for the events in it
+        char bytes[16 * 1024];
+    } buffer;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    int ok = dir_watch_add(w, "");
+    while (ok && !SDL_GetAtomicInt(&w->stop))
+    {
+        struct pollfd p = {w->fd, POLLIN, 0};
+        if (poll(&p, 1, DIR_WATCH_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t length = read(w->fd, buffer.bytes, sizeof(buffer.bytes));
+        for (const char *at = buffer.bytes; ok && length > 0 && at < buffer.bytes + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)at;
+            at += sizeof(struct inotify_event) + event->len;
+            ok = dir_watch_event(w, event);
+        }
+    }
+
+    if (!ok)
+    {
+        SDL_SetAtomicInt(&w->active, 0);
+    }
+
+    return 0;
+}
+
+dir_watch *dir_watch_start(const char *root)
+{
+    struct statfs fs;
+    if (statfs(root, &fs) != 0)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < (int)SDL_arraysize(dir_watch_remote_fs); i++)
+    {
+        if ((uint32_t)fs.f_type == dir_watch_remote_fs[i])
+        {
+            return NULL;
+        }
+    }
+
+    dir_watch *w = (dir_watch *)calloc(1, sizeof(dir_watch));
+    if (!w)
+    {
+        return NULL;
+    }
+
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    w->root = SDL_strdup(root);
+    w->lock = SDL_CreateMutex();
+    w->dir_limit = dir_watch_limit();
+    SDL_SetAtomicInt(&w->active, 1);
+    if (w->fd >= 0 && w->root && w->lock)
+    {
+        w->thread = SDL_CreateThread(dir_watch_thread, "plyr watch", w);
+    }
+
+    if (!w->thread)
+    {
+        dir_watch_stop(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+void dir_watch_stop(dir_watch *w)
+{
+    if (!w)
+    {
+        return;
+    }
+
+    SDL_SetAtomicInt(&w->stop, 1);
+    if (w->thread)
+    {
+        SDL_WaitThread(w->thread, NULL);
+    }
+    if (w->fd >= 0)
+    {
+        close(w->fd);
+    }
+
+    for (int i = 0; i < w->dir_capacity; i++)
+    {
+        SDL_free(w->dirs[i]);
+    }
+    for (int i = 0; i < w->change_count; i++)
+    {
+        SDL_free(w->changes[i]);
+    }
+    free(w->dirs);
+    SDL_free(w->changes);
+    SDL_DestroyMutex(w->lock);
+    SDL_free(w->root);
+    free(w);
+}
+
+int dir_watch_active(dir_watch *w)
+{
+    return SDL_GetAtomicInt(&w->active);
+}
+
+static int dir_watch_compare(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Sorts the paths and drops repeats and paths inside folders that are in the list already
+static int dir_watch_collapse(char **paths, int count)
+{
+    SDL_qsort(paths, count, sizeof(char *), dir_watch_compare);
+
+    // A folder sorts before everything in it, so the kept ones are all that need searching
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+    {
+        char *path = paths[i];
+        int covered = kept > 0 && strcmp(paths[kept - 1], path) == 0;
+
+        char *slash = strrchr(path, '/');
+        while (!covered && slash)
+        {
+            *slash = '\0';
+            covered = bsearch(&path, paths, kept, sizeof(char *), dir_watch_compare) != NULL;
+            char *parent = strrchr(path, '/');
+            *slash = '/';
+            slash = parent;
+        }
+
+        if (covered)
+        {
+            SDL_free(path);
+        }
+        else
+        {
+            paths[kept++] = path;
+        }
+    }
+
+    return kept;
+}
+
+int dir_watch_take(dir_watch *w, char ***paths)
+{
+    int result = 0;
+    *paths = NULL;
+
+    SDL_LockMutex(w->lock);
+    if (SDL_GetTicksNS() - w->last_event_ns >= SDL_MS_TO_NS(DIR_WATCH_SETTLE_MS))
+    {
+        if (w->lost)
+        {
+            for (int i = 0; i < w->change_count; i++)
+            {
+                SDL_free(w->changes[i]);
+            }
+            w->change_count = 0;
+            w->lost = 0;
+            result = DIR_WATCH_RESCAN;
+        }
+        else if (w->change_count)
+        {
+            *paths = w->changes;
+            result = w->change_count;
+            w->changes = NULL;
+            w->change_count = 0;
+            w->change_capacity = 0;
+        }
+    }
+    SDL_UnlockMutex(w->lock);
+
+    return result > 0 ? dir_watch_collapse(*paths, result) : result;
+}
+
+#else
+
+// Other platforms fall back to rescanning now and then
+dir_watch *dir_watch_start(const char *root)
+{
+    (void)root;
+    return NULL;
+}
+
+void dir_watch_stop(dir_watch *w)
+{
+    (void)w;
+}
+
+int dir_watch_active(dir_watch *w)
+{
+    (void)w;
+    return 0;
+}
+
+int dir_watch_take(dir_watch *w, char ***paths)
+{
+    (void)w;
+    *paths = NULL;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Change notification for a folder tree. On Linux every folder gets an inotify watch from a
+// thread of its own; the paths that changed are collected and handed over in batches once the
+// tree has been quiet for DIR_WATCH_SETTLE_MS, so a file being copied is reported once,
+// complete. Hidden entries are ignored, like the library does.
+typedef struct dir_watch dir_watch;
+
+#define DIR_WATCH_SETTLE_MS 2000
+#define DIR_WATCH_RESCAN -1 // events were lost, only a full scan is reliable now
+
+// NULL where changes can't be watched: other platforms, and network file systems, where
+// changes made by other machines never raise an event
+dir_watch *dir_watch_start(const char *root);
+void dir_watch_stop(dir_watch *w);
+
+// 0 once the watch had to be given up, when the folders outnumber the watches allowed or a
+// quarter of the user's inotify watches, which other programs need too
+int dir_watch_active(dir_watch *w);
+
+// Hands over the paths, relative to the root, that were created, written, moved or deleted.
+// A folder stands for everything in it. Returns their count or DIR_WATCH_RESCAN; the array and
+// the paths are the caller's to SDL_free.
+int dir_watch_take(dir_watch *w, char ***paths);
+
+#ifdef __cplusplus
+}
+#endif
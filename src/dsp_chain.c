@@ -0,0 +1,223 @@
+#include "dsp_chain.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct dsp_stage
+{
+    const dsp_stage_type *type;
+    void *state;
+
+    // Written by any thread: float bits of the parameters, bumped version after each write
+    SDL_AtomicInt params[DSP_STAGE_MAX_PARAMS];
+    SDL_AtomicInt version;
+    SDL_AtomicInt enabled;
+    int seen_version; // processing thread
+    int active;       // enabled as of the last block, processing thread
+
+    // CPU time of the current window, published as float bits when it is full
+    Uint64 window_ticks;
+    Uint64 window_peak;
+    SDL_AtomicU32 cpu_percent;
+    SDL_AtomicU32 peak_us;
+} dsp_stage;
+
+struct dsp_chain
+{
+    dsp_stage stages[DSP_CHAIN_MAX_STAGES];
+    int count;
+    int hz;
+    int channels;
+    int window_frames; // audio in the current stats window
+};
+
+static Uint32 float_bits(float value)
+{
+    Uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(Uint32 bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+dsp_chain *dsp_chain_create(void)
+{
+    return (dsp_chain *)calloc(1, sizeof(dsp_chain));
+}
+
+void dsp_chain_destroy(dsp_chain *chain)
+{
+    if (!chain)
+    {
+        return;
+    }
+
+    for (int i = 0; i < chain->count; i++)
+    {
+        free(chain->stages[i].state);
+    }
+    free(chain);
+}
+
+int dsp_chain_add(dsp_chain *chain, const dsp_stage_type *type)
+{
+    if (chain->count >= DSP_CHAIN_MAX_STAGES)
+    {
+        return -1;
+    }
+
+    dsp_stage *stage = &chain->stages[chain->count];
+    stage->state = calloc(1, type->state_size ? type->state_size : 1);
+    if (!stage->state)
+    {
+        return -1;
+    }
+
+    stage->type = type;
+    for (int i = 0; i < type->param_count; i++)
+    {
+        SDL_SetAtomicInt(&stage->params[i], (int)float_bits(type->defaults[i]));
+    }
+    SDL_SetAtomicInt(&stage->version, 1); // seen_version 0, the first block runs update
+    SDL_SetAtomicInt(&stage->enabled, 1);
+
+    return chain->count++;
+}
+
+void dsp_chain_set_param(dsp_chain *chain, int stage, int param, float value)
+{
+    if (stage < 0 || stage >= chain->count || param < 0 || param >= chain->stages[stage].type->param_count)
+    {
+        return;
+    }
+
+    SDL_SetAtomicInt(&chain->stages[stage].params[param], (int)float_bits(value));
+    SDL_AddAtomicInt(&chain->stages[stage].version, 1);
+}
+
+float dsp_chain_get_param(dsp_chain *chain, int stage, int param)
+{
+    if (stage < 0 || stage >= chain->count || param < 0 || param >= chain->stages[stage].type->param_count)
+    {
+        return 0.0f;
+    }
+
+    return bits_float((Uint32)SDL_GetAtomicInt(&chain->stages[stage].params[param]));
+}
+
+void dsp_chain_set_enabled(dsp_chain *chain, int stage, int enabled)
+{
+    if (stage >= 0 && stage < chain->count)
+    {
+        SDL_SetAtomicInt(&chain->stages[stage].enabled, enabled != 0);
+    }
+}
+
+// Hands the latest parameters to the stage if they changed since its last block
+static void dsp_stage_sync(dsp_stage *stage, int force)
+{
+    int version = SDL_GetAtomicInt(&stage->version);
+    if (!force && version == stage->seen_version)
+    {
+        return;
+    }
+
+    // A write racing this read bumps the version again, the next block picks it up
+    float params[DSP_STAGE_MAX_PARAMS];
+    for (int i = 0; i < stage->type->param_count; i++)
+    {
+        params[i] = bits_float((Uint32)SDL_GetAtomicInt(&stage->params[i]));
+    }
+    stage->seen_version = version;
+
+    if (stage->type->update)
+    {
+        stage->type->update(stage->state, params);
+    }
+}
+
+void dsp_chain_process(dsp_chain *chain, float *samples, int frames, int channels, int hz)
+{
+    bool configure = hz != chain->hz || channels != chain->channels;
+    if (configure)
+    {
+        chain->hz = hz;
+        chain->channels = channels;
+    }
+
+    for (int i = 0; i < chain->count; i++)
+    {
+        dsp_stage *stage = &chain->stages[i];
+        if (configure && stage->type->configure)
+        {
+            stage->type->configure(stage->state, hz, channels);
+        }
+        dsp_stage_sync(stage, configure);
+
+        int enabled = SDL_GetAtomicInt(&stage->enabled);
+        if (enabled && !stage->active && stage->type->reset)
+        {
+            // Whatever the stage saw before it was bypassed is stale
+            stage->type->reset(stage->state);
+        }
+        stage->active = enabled;
+
+        if (enabled)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            stage->type->process(stage->state, samples, frames, channels);
+            Uint64 ticks = SDL_GetPerformanceCounter() - start;
+
+            stage->window_ticks += ticks;
+            stage->window_peak = SDL_max(stage->window_peak, ticks);
+        }
+    }
+
+    // Publish once a window of audio went through
+    chain->window_frames += frames;
+    if (chain->window_frames >= hz * DSP_CHAIN_STATS_SECONDS)
+    {
+        double frequency = (double)SDL_GetPerformanceFrequency();
+        double audio_seconds = (double)chain->window_frames / hz;
+
+        for (int i = 0; i < chain->count; i++)
+        {
+            dsp_stage *stage = &chain->stages[i];
+            SDL_SetAtomicU32(&stage->cpu_percent, float_bits((float)(stage->window_ticks / frequency / audio_seconds * 100.0)));
+            SDL_SetAtomicU32(&stage->peak_us, float_bits((float)(stage->window_peak / frequency * 1e6)));
+            stage->window_ticks = 0;
+            stage->window_peak = 0;
+        }
+        chain->window_frames = 0;
+    }
+}
+
+void dsp_chain_reset(dsp_chain *chain)
+{
+    for (int i = 0; i < chain->count; i++)
+    {
+        if (chain->stages[i].type->reset)
+        {
+            chain->stages[i].type->reset(chain->stages[i].state);
+        }
+    }
+}
+
+int dsp_chain_get_stats(dsp_chain *chain, dsp_stage_stats *stats, int max)
+{
+    for (int i = 0; i < chain->count && i < max; i++)
+    {
+        dsp_stage *stage = &chain->stages[i];
+        stats[i].name = stage->type->name;
+        stats[i].enabled = SDL_GetAtomicInt(&stage->enabled);
+        stats[i].cpu_percent = bits_float(SDL_GetAtomicU32(&stage->cpu_percent));
+        stats[i].peak_us = bits_float(SDL_GetAtomicU32(&stage->peak_us));
+    }
+
+    return chain->count;
+}
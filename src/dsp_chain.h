@@ -0,0 +1,71 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Processing between the decoder and the output: an ordered list of stages that work in
+// place on interleaved float blocks on the decode thread. Stage state is allocated when
+// the stage is added, processing never allocates or locks. Parameters are written from
+// any thread into atomics and picked up by the stage at the start of the next block.
+#define DSP_CHAIN_MAX_STAGES 8
+#define DSP_STAGE_MAX_PARAMS 8
+#define DSP_STAGE_MAX_CHANNELS 2
+
+// How often the CPU time figures are refreshed, in seconds of processed audio
+#define DSP_CHAIN_STATS_SECONDS 1
+
+typedef struct dsp_stage_type
+{
+    const char *name;
+    int param_count;
+    float defaults[DSP_STAGE_MAX_PARAMS];
+    size_t state_size; // zeroed when the stage is added
+
+    // New rate or channel count, update follows. May be NULL.
+    void (*configure)(void *state, int hz, int channels);
+
+    // Parameters changed, or the format did. May be NULL.
+    void (*update)(void *state, const float *params);
+
+    // Forgets the signal seen so far, after a seek. May be NULL.
+    void (*reset)(void *state);
+
+    void (*process)(void *state, float *samples, int frames, int channels);
+} dsp_stage_type;
+
+typedef struct dsp_stage_stats
+{
+    const char *name;
+    int enabled;
+    float cpu_percent; // CPU time per second of audio
+    float peak_us;     // slowest block of the last window
+} dsp_stage_stats;
+
+typedef struct dsp_chain dsp_chain;
+
+dsp_chain *dsp_chain_create(void);
+void dsp_chain_destroy(dsp_chain *chain);
+
+// Appends a stage before processing starts, returns its index or -1
+int dsp_chain_add(dsp_chain *chain, const dsp_stage_type *type);
+
+// Any thread, applied from the next block on
+void dsp_chain_set_param(dsp_chain *chain, int stage, int param, float value);
+float dsp_chain_get_param(dsp_chain *chain, int stage, int param);
+void dsp_chain_set_enabled(dsp_chain *chain, int stage, int enabled);
+
+// Processing thread only
+void dsp_chain_process(dsp_chain *chain, float *samples, int frames, int channels, int hz);
+void dsp_chain_reset(dsp_chain *chain);
+
+// Any thread. Returns the number of stages, stats holds up to max of them.
+int dsp_chain_get_stats(dsp_chain *chain, dsp_stage_stats *stats, int max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,692 @@
+#include "dsp_kernels.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DSP_X86 1
+#include <immintrin.h>
+
+// GCC and Clang only emit AVX2 inside functions marked for it, MSVC emits any intrinsic
+#if defined(_MSC_VER) && !defined(__clang__)
+#define DSP_TARGET(isa)
+#else
+#define DSP_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+// 10 * log10(m) = 20 / ln(10) * atanh((m - 1) / (m + 1)), the series to t^7 is
+// exact to float precision while m stays within [sqrt(1/2), sqrt(2))
+#define DSP_DB_PER_OCTAVE 3.01029995664f
+#define DSP_DB_C1 8.68588963807f
+#define DSP_DB_C3 (DSP_DB_C1 / 3.0f)
+#define DSP_DB_C5 (DSP_DB_C1 / 5.0f)
+#define DSP_DB_C7 (DSP_DB_C1 / 7.0f)
+#define DSP_SQRT2 1.41421356237f
+#define DSP_DB_EPSILON 1e-10f
+
+
+/* ============================================================
+   Plain C
+   ============================================================ */
+static void band_power_scalar(const float *re, const float *im, const int *edges, int bands, float *out, int stride)
+{
+    for (int band = 0; band < bands; band++)
+    {
+        float power = 0.0f;
+        for (int bin = edges[band]; bin < edges[band + 1]; bin++)
+        {
+            power += re[bin] * re[bin] + im[bin] * im[bin];
+        }
+        out[band * stride] = power;
+    }
+}
+
+static float to_db_one(float value, float scale, float offset)
+{
+    float x = value * scale + DSP_DB_EPSILON;
+
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int exponent = (int)((bits >> 23) & 0xFF) - 127;
+    bits = (bits & 0x007FFFFF) | 0x3F800000;
+
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    if (m >= DSP_SQRT2)
+    {
+        m *= 0.5f;
+        exponent++;
+    }
+
+    float t = (m - 1.0f) / (m + 1.0f);
+    float t2 = t * t;
+    float db = exponent * DSP_DB_PER_OCTAVE + t * (DSP_DB_C1 + t2 * (DSP_DB_C3 + t2 * (DSP_DB_C5 + t2 * DSP_DB_C7))) + offset;
+    return db > 0.0f ? db : 0.0f;
+}
+
+static void to_db_scalar(const float *values, float scale, float offset, float *out, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        out[i] = to_db_one(values[i], scale, offset);
+    }
+}
+
+static void decay_scalar(float *values, int count, float factor, float threshold)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float v = values[i] * factor;
+        values[i] = v >= threshold ? v : 0.0f;
+    }
+}
+
+static void gain_f32_scalar(float *samples, int count, float gain)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float v = samples[i] * gain;
+        samples[i] = v > 1.0f ? 1.0f : v < -1.0f ? -1.0f : v;
+    }
+}
+
+static void gain_s16_scalar(int16_t *samples, int count, float gain)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float v = samples[i] * gain;
+        samples[i] = (int16_t)(v > 32767.0f ? 32767 : v < -32768.0f ? -32768 : (int)lrintf(v));
+    }
+}
+
+static void mix_f32_scalar(float *dst, const float *dst_gain, const float *src, const float *src_gain, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        dst[i] = dst[i] * dst_gain[i] + src[i] * src_gain[i];
+    }
+}
+
+static void stereo_measure_scalar(const float *samples, int frames, dsp_stereo_sums *sums)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        float left = samples[i * 2];
+        float right = samples[i * 2 + 1];
+        sums->peak[0] = fmaxf(sums->peak[0], fabsf(left));
+        sums->peak[1] = fmaxf(sums->peak[1], fabsf(right));
+        sums->square[0] += left * left;
+        sums->square[1] += right * right;
+        sums->product += left * right;
+    }
+}
+
+static void fir_stereo_scalar(const float *frames, const int *offsets, const float *const *kernels, int taps, float *out, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const float *x = frames + offsets[i] * 2;
+        const float *k = kernels[i];
+        float left = 0.0f, right = 0.0f;
+        for (int t = 0; t < taps; t++)
+        {
+            left += x[t * 2] * k[t];
+            right += x[t * 2 + 1] * k[t];
+        }
+        out[i * 2] = left;
+        out[i * 2 + 1] = right;
+    }
+}
+
+
+#ifdef DSP_X86
+/* ============================================================
+   SSE2
+   ============================================================ */
+DSP_TARGET("sse2")
+static float hsum_sse2(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+DSP_TARGET("sse2")
+static void band_power_sse2(const float *re, const float *im, const int *edges, int bands, float *out, int stride)
+{
+    for (int band = 0; band < bands; band++)
+    {
+        int bin = edges[band];
+        int end = edges[band + 1];
+
+        __m128 acc = _mm_setzero_ps();
+        for (; bin + 4 <= end; bin += 4)
+        {
+            __m128 r = _mm_loadu_ps(re + bin);
+            __m128 i = _mm_loadu_ps(im + bin);
+            acc = _mm_add_ps(acc, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i)));
+        }
+
+        float power = hsum_sse2(acc);
+        for (; bin < end; bin++)
+        {
+            power += re[bin] * re[bin] + im[bin] * im[bin];
+        }
+        out[band * stride] = power;
+    }
+}
+
+DSP_TARGET("sse2")
+static void to_db_sse2(const float *values, float scale, float offset, float *out, int count)
+{
+    const __m128 v_scale = _mm_set1_ps(scale);
+    const __m128 v_epsilon = _mm_set1_ps(DSP_DB_EPSILON);
+    const __m128 v_offset = _mm_set1_ps(offset);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sqrt2 = _mm_set1_ps(DSP_SQRT2);
+    const __m128i mantissa_mask = _mm_set1_epi32(0x007FFFFF);
+    const __m128i exponent_bias = _mm_set1_epi32(127);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(values + i), v_scale), v_epsilon);
+        __m128i bits = _mm_castps_si128(x);
+
+        __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), exponent_bias);
+        __m128 m = _mm_or_ps(_mm_castsi128_ps(_mm_and_si128(bits, mantissa_mask)), one);
+
+        // Halve mantissas of sqrt(2) and above, counting one octave more
+        __m128 high = _mm_cmpge_ps(m, sqrt2);
+        m = _mm_mul_ps(m, _mm_or_ps(_mm_and_ps(high, half), _mm_andnot_ps(high, one)));
+        exponent = _mm_sub_epi32(exponent, _mm_castps_si128(high));
+
+        __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 poly = _mm_add_ps(_mm_set1_ps(DSP_DB_C5), _mm_mul_ps(t2, _mm_set1_ps(DSP_DB_C7)));
+        poly = _mm_add_ps(_mm_set1_ps(DSP_DB_C3), _mm_mul_ps(t2, poly));
+        poly = _mm_add_ps(_mm_set1_ps(DSP_DB_C1), _mm_mul_ps(t2, poly));
+
+        __m128 db = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(exponent), _mm_set1_ps(DSP_DB_PER_OCTAVE)), _mm_mul_ps(t, poly));
+        db = _mm_max_ps(_mm_add_ps(db, v_offset), _mm_setzero_ps());
+        _mm_storeu_ps(out + i, db);
+    }
+
+    for (; i < count; i++)
+    {
+        out[i] = to_db_one(values[i], scale, offset);
+    }
+}
+
+DSP_TARGET("sse2")
+static void decay_sse2(float *values, int count, float factor, float threshold)
+{
+    const __m128 v_factor = _mm_set1_ps(factor);
+    const __m128 v_threshold = _mm_set1_ps(threshold);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(values + i), v_factor);
+        _mm_storeu_ps(values + i, _mm_and_ps(v, _mm_cmpge_ps(v, v_threshold)));
+    }
+
+    decay_scalar(values + i, count - i, factor, threshold);
+}
+
+DSP_TARGET("sse2")
+static void gain_f32_sse2(float *samples, int count, float gain)
+{
+    const __m128 v_gain = _mm_set1_ps(gain);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(samples + i), v_gain);
+        _mm_storeu_ps(samples + i, _mm_max_ps(_mm_min_ps(v, hi), lo));
+    }
+
+    gain_f32_scalar(samples + i, count - i, gain);
+}
+
+DSP_TARGET("sse2")
+static void gain_s16_sse2(int16_t *samples, int count, float gain)
+{
+    const __m128 v_gain = _mm_set1_ps(gain);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+
+        // Sign extend to 32 bits, scale as float and pack back with saturation
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), v_gain));
+        hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), v_gain));
+        _mm_storeu_si128((__m128i *)(samples + i), _mm_packs_epi32(lo, hi));
+    }
+
+    gain_s16_scalar(samples + i, count - i, gain);
+}
+
+DSP_TARGET("sse2")
+static void mix_f32_sse2(float *dst, const float *dst_gain, const float *src, const float *src_gain, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(dst_gain + i));
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(src_gain + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(a, b));
+    }
+
+    mix_f32_scalar(dst + i, dst_gain + i, src + i, src_gain + i, count - i);
+}
+
+DSP_TARGET("sse2")
+static void stereo_measure_sse2(const float *samples, int frames, dsp_stereo_sums *sums)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 peak = _mm_setzero_ps();
+    __m128 square = _mm_setzero_ps();
+    __m128 product = _mm_setzero_ps();
+
+    // Lanes hold left, right, left, right; the swap pairs every sample with its other channel
+    int i = 0;
+    for (; i + 2 <= frames; i += 2)
+    {
+        __m128 v = _mm_loadu_ps(samples + i * 2);
+        peak = _mm_max_ps(peak, _mm_andnot_ps(sign, v));
+        square = _mm_add_ps(square, _mm_mul_ps(v, v));
+        product = _mm_add_ps(product, _mm_mul_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+    }
+
+    float p[4], q[4], r[4];
+    _mm_storeu_ps(p, peak);
+    _mm_storeu_ps(q, square);
+    _mm_storeu_ps(r, product);
+    sums->peak[0] = fmaxf(sums->peak[0], fmaxf(p[0], p[2]));
+    sums->peak[1] = fmaxf(sums->peak[1], fmaxf(p[1], p[3]));
+    sums->square[0] += q[0] + q[2];
+    sums->square[1] += q[1] + q[3];
+    sums->product += r[0] + r[2];
+
+    stereo_measure_scalar(samples + i * 2, frames - i, sums);
+}
+
+DSP_TARGET("sse2")
+static void fir_stereo_sse2(const float *frames, const int *offsets, const float *const *kernels, int taps, float *out, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const float *x = frames + offsets[i] * 2;
+        const float *k = kernels[i];
+
+        // Lanes hold left, right, left, right of two frames, each coefficient is used twice
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        for (int t = 0; t < taps; t += 4)
+        {
+            __m128 c = _mm_loadu_ps(k + t);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + t * 2), _mm_unpacklo_ps(c, c)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + t * 2 + 4), _mm_unpackhi_ps(c, c)));
+        }
+        acc0 = _mm_add_ps(acc0, acc1);
+        acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+        _mm_storel_pi((__m64 *)(out + i * 2), acc0);
+    }
+}
+
+
+/* ============================================================
+   AVX2
+   ============================================================ */
+DSP_TARGET("avx2")
+static void band_power_avx2(const float *re, const float *im, const int *edges, int bands, float *out, int stride)
+{
+    for (int band = 0; band < bands; band++)
+    {
+        int bin = edges[band];
+        int end = edges[band + 1];
+
+        __m256 acc = _mm256_setzero_ps();
+        for (; bin + 8 <= end; bin += 8)
+        {
+            __m256 r = _mm256_loadu_ps(re + bin);
+            __m256 i = _mm256_loadu_ps(im + bin);
+            acc = _mm256_add_ps(acc, _mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(i, i)));
+        }
+
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+        float power = _mm_cvtss_f32(sum);
+        for (; bin < end; bin++)
+        {
+            power += re[bin] * re[bin] + im[bin] * im[bin];
+        }
+        out[band * stride] = power;
+    }
+}
+
+DSP_TARGET("avx2")
+static void to_db_avx2(const float *values, float scale, float offset, float *out, int count)
+{
+    const __m256 v_scale = _mm256_set1_ps(scale);
+    const __m256 v_epsilon = _mm256_set1_ps(DSP_DB_EPSILON);
+    const __m256 v_offset = _mm256_set1_ps(offset);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 sqrt2 = _mm256_set1_ps(DSP_SQRT2);
+    const __m256i mantissa_mask = _mm256_set1_epi32(0x007FFFFF);
+    const __m256i exponent_bias = _mm256_set1_epi32(127);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(values + i), v_scale), v_epsilon);
+        __m256i bits = _mm256_castps_si256(x);
+
+        __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), exponent_bias);
+        __m256 m = _mm256_or_ps(_mm256_castsi256_ps(_mm256_and_si256(bits, mantissa_mask)), one);
+
+        __m256 high = _mm256_cmp_ps(m, sqrt2, _CMP_GE_OQ);
+        m = _mm256_mul_ps(m, _mm256_blendv_ps(one, half, high));
+        exponent = _mm256_sub_epi32(exponent, _mm256_castps_si256(high));
+
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 poly = _mm256_add_ps(_mm256_set1_ps(DSP_DB_C5), _mm256_mul_ps(t2, _mm256_set1_ps(DSP_DB_C7)));
+        poly = _mm256_add_ps(_mm256_set1_ps(DSP_DB_C3), _mm256_mul_ps(t2, poly));
+        poly = _mm256_add_ps(_mm256_set1_ps(DSP_DB_C1), _mm256_mul_ps(t2, poly));
+
+        __m256 db = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(exponent), _mm256_set1_ps(DSP_DB_PER_OCTAVE)), _mm256_mul_ps(t, poly));
+        db = _mm256_max_ps(_mm256_add_ps(db, v_offset), _mm256_setzero_ps());
+        _mm256_storeu_ps(out + i, db);
+    }
+
+    for (; i < count; i++)
+    {
+        out[i] = to_db_one(values[i], scale, offset);
+    }
+}
+
+DSP_TARGET("avx2")
+static void decay_avx2(float *values, int count, float factor, float threshold)
+{
+    const __m256 v_factor = _mm256_set1_ps(factor);
+    const __m256 v_threshold = _mm256_set1_ps(threshold);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(values + i), v_factor);
+        _mm256_storeu_ps(values + i, _mm256_and_ps(v, _mm256_cmp_ps(v, v_threshold, _CMP_GE_OQ)));
+    }
+
+    decay_scalar(values + i, count - i, factor, threshold);
+}
+
+DSP_TARGET("avx2")
+static void gain_f32_avx2(float *samples, int count, float gain)
+{
+    const __m256 v_gain = _mm256_set1_ps(gain);
+    const __m256 hi = _mm256_set1_ps(1.0f);
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(samples + i), v_gain);
+        _mm256_storeu_ps(samples + i, _mm256_max_ps(_mm256_min_ps(v, hi), lo));
+    }
+
+    gain_f32_scalar(samples + i, count - i, gain);
+}
+
+DSP_TARGET("avx2")
+static void gain_s16_avx2(int16_t *samples, int count, float gain)
+{
+    const __m256 v_gain = _mm256_set1_ps(gain);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples + i)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples + i + 8)));
+        lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), v_gain));
+        hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), v_gain));
+
+        // packs works per 128 bit lane, the permute puts the halves back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256((__m256i *)(samples + i), packed);
+    }
+
+    gain_s16_scalar(samples + i, count - i, gain);
+}
+
+DSP_TARGET("avx2")
+static void mix_f32_avx2(float *dst, const float *dst_gain, const float *src, const float *src_gain, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(dst_gain + i));
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(src_gain + i));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(a, b));
+    }
+
+    mix_f32_scalar(dst + i, dst_gain + i, src + i, src_gain + i, count - i);
+}
+
+DSP_TARGET("avx2")
+static void stereo_measure_avx2(const float *samples, int frames, dsp_stereo_sums *sums)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 peak = _mm256_setzero_ps();
+    __m256 square = _mm256_setzero_ps();
+    __m256 product = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m256 v = _mm256_loadu_ps(samples + i * 2);
+        peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, v));
+        square = _mm256_add_ps(square, _mm256_mul_ps(v, v));
+        product = _mm256_add_ps(product, _mm256_mul_ps(v, _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1))));
+    }
+
+    float p[8], q[8], r[8];
+    _mm256_storeu_ps(p, peak);
+    _mm256_storeu_ps(q, square);
+    _mm256_storeu_ps(r, product);
+    for (int lane = 0; lane < 8; lane += 2)
+    {
+        sums->peak[0] = fmaxf(sums->peak[0], p[lane]);
+        sums->peak[1] = fmaxf(sums->peak[1], p[lane + 1]);
+        sums->square[0] += q[lane];
+        sums->square[1] += q[lane + 1];
+        sums->product += r[lane];
+    }
+
+    stereo_measure_scalar(samples + i * 2, frames - i, sums);
+}
+
+DSP_TARGET("avx2")
+static void fir_stereo_avx2(const float *frames, const int *offsets, const float *const *kernels, int taps, float *out, int count)
+{
+    const __m256i spread = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+
+    for (int i = 0; i < count; i++)
+    {
+        const float *x = frames + offsets[i] * 2;
+        const float *k = kernels[i];
+
+        // Four frames per step, the coefficients spread to left and right
+        __m256 acc = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t += 4)
+        {
+            __m256 c = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(k + t)), spread);
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + t * 2), c));
+        }
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        _mm_storel_pi((__m64 *)(out + i * 2), sum);
+    }
+}
+#endif
+
+
+/* ============================================================
+   Dispatch
+   ============================================================ */
+static SDL_AtomicInt dsp_selected; // dsp_isa + 1, 0 until the first call
+
+static dsp_isa dsp_best_isa(void)
+{
+#ifdef DSP_X86
+    if (SDL_HasAVX2())
+    {
+        return DSP_ISA_AVX2;
+    }
+    if (SDL_HasSSE2())
+    {
+        return DSP_ISA_SSE2;
+    }
+#endif
+    return DSP_ISA_SCALAR;
+}
+
+dsp_isa dsp_kernels_isa(void)
+{
+    int selected = SDL_GetAtomicInt(&dsp_selected);
+    if (!selected)
+    {
+        // Racing first calls all come to the same answer
+        selected = dsp_best_isa() + 1;
+        SDL_SetAtomicInt(&dsp_selected, selected);
+    }
+    return (dsp_isa)(selected - 1);
+}
+
+void dsp_kernels_select(dsp_isa isa)
+{
+    dsp_isa best = dsp_best_isa();
+    SDL_SetAtomicInt(&dsp_selected, (isa < best ? isa : best) + 1);
+}
+
+const char *dsp_isa_name(dsp_isa isa)
+{
+    switch (isa)
+    {
+        case DSP_ISA_SSE2: return "sse2";
+        case DSP_ISA_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+void dsp_band_power(const float *re, const float *im, const int *edges, int bands, float *out, int stride)
+{
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: band_power_avx2(re, im, edges, bands, out, stride); return;
+        case DSP_ISA_SSE2: band_power_sse2(re, im, edges, bands, out, stride); return;
+#endif
+        default: band_power_scalar(re, im, edges, bands, out, stride); return;
+    }
+}
+
+void dsp_to_db(const float *values, float scale, float offset, float *out, int count)
+{
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: to_db_avx2(values, scale, offset, out, count); return;
+        case DSP_ISA_SSE2: to_db_sse2(values, scale, offset, out, count); return;
+#endif
+        default: to_db_scalar(values, scale, offset, out, count); return;
+    }
+}
+
+void dsp_decay(float *values, int count, float factor, float threshold)
+{
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: decay_avx2(values, count, factor, threshold); return;
+        case DSP_ISA_SSE2: decay_sse2(values, count, factor, threshold); return;
+#endif
+        default: decay_scalar(values, count, factor, threshold); return;
+    }
+}
+
+void dsp_gain_f32(float *samples, int count, float gain)
+{
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: gain_f32_avx2(samples, count, gain); return;
+        case DSP_ISA_SSE2: gain_f32_sse2(samples, count, gain); return;
+#endif
+        default: gain_f32_scalar(samples, count, gain); return;
+    }
+}
+
+void dsp_gain_s16(int16_t *samples, int count, float gain)
+{
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: gain_s16_avx2(samples, count, gain); return;
+        case DSP_ISA_SSE2: gain_s16_sse2(samples, count, gain); return;
+#endif
+        default: gain_s16_scalar(samples, count, gain); return;
+    }
+}
+
+void dsp_mix_f32(float *dst, const float *dst_gain, const float *src, const float *src_gain, int count)
+{
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: mix_f32_avx2(dst, dst_gain, src, src_gain, count); return;
+        case DSP_ISA_SSE2: mix_f32_sse2(dst, dst_gain, src, src_gain, count); return;
+#endif
+        default: mix_f32_scalar(dst, dst_gain, src, src_gain, count); return;
+    }
+}
+
+void dsp_stereo_measure(const float *samples, int frames, dsp_stereo_sums *sums)
+{
+    memset(sums, 0, sizeof(*sums));
+
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: stereo_measure_avx2(samples, frames, sums); return;
+        case DSP_ISA_SSE2: stereo_measure_sse2(samples, frames, sums); return;
+#endif
+        default: stereo_measure_scalar(samples, frames, sums); return;
+    }
+}
+
+void dsp_fir_stereo(const float *frames, const int *offsets, const float *const *kernels, int taps, float *out, int count)
+{
+    switch (dsp_kernels_isa())
+    {
+#ifdef DSP_X86
+        case DSP_ISA_AVX2: fir_stereo_avx2(frames, offsets, kernels, taps, out, count); return;
+        case DSP_ISA_SSE2: fir_stereo_sse2(frames, offsets, kernels, taps, out, count); return;
+#endif
+        default: fir_stereo_scalar(frames, offsets, kernels, taps, out, count); return;
+    }
+}
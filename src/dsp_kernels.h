@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vector kernels of the spectrum and output paths. Every kernel has a plain C, an SSE2 and an
+// AVX2 variant; the fastest one the CPU supports is picked on first use.
+typedef enum dsp_isa
+{
+    DSP_ISA_SCALAR,
+    DSP_ISA_SSE2,
+    DSP_ISA_AVX2,
+} dsp_isa;
+
+// Variant in use
+dsp_isa dsp_kernels_isa(void);
+
+// Forces a variant, for benchmarks. One the CPU lacks falls back to the best it has.
+void dsp_kernels_select(dsp_isa isa);
+
+const char *dsp_isa_name(dsp_isa isa);
+
+// Sums re^2 + im^2 over the bins [edges[band], edges[band + 1]) of every band,
+// band b is written to out[b * stride]
+void dsp_band_power(const float *re, const float *im, const int *edges, int bands, float *out, int stride);
+
+// out[i] = max(10 * log10(values[i] * scale + 1e-10) + offset, 0), within 0.001 dB.
+// values and out may be the same array.
+void dsp_to_db(const float *values, float scale, float offset, float *out, int count);
+
+// values[i] *= factor, values that fall below threshold snap to zero
+void dsp_decay(float *values, int count, float factor, float threshold);
+
+// samples[i] *= gain, clamped to full scale
+void dsp_gain_f32(float *samples, int count, float gain);
+void dsp_gain_s16(int16_t *samples, int count, float gain);
+
+// dst[i] = dst[i] * dst_gain[i] + src[i] * src_gain[i], gains per sample
+void dsp_mix_f32(float *dst, const float *dst_gain, const float *src, const float *src_gain, int count);
+
+// Level sums of interleaved stereo frames for the meters
+typedef struct dsp_stereo_sums
+{
+    float peak[2];   // largest magnitude per channel
+    float square[2]; // sum of squares per channel
+    float product;   // sum of left * right
+} dsp_stereo_sums;
+
+void dsp_stereo_measure(const float *samples, int frames, dsp_stereo_sums *sums);
+
+// FIR over interleaved stereo frames with a kernel per output: out frame i is the sum over
+// t < taps of frames[offsets[i] + t] * kernels[i][t], per channel. taps is a multiple of 4.
+void dsp_fir_stereo(const float *frames, const int *offsets, const float *const *kernels, int taps, float *out, int count);
+
+#ifdef __cplusplus
+}
+#endif
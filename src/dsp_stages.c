@@ -0,0 +1,299 @@
+#include "dsp_stages.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* ============================================================
+   Gain
+   ============================================================ */
+typedef struct gain_state
+{
+    float target;
+    float current;
+    float step;    // per frame while ramping
+    int remaining; // frames left in the ramp
+    int ramp_frames;
+    int primed;    // the first update starts at its target, no fade in
+} gain_state;
+
+static void gain_configure(void *data, int hz, int channels)
+{
+    gain_state *state = (gain_state *)data;
+    (void)channels;
+    state->ramp_frames = SDL_max(hz * DSP_GAIN_RAMP_MS / 1000, 1);
+}
+
+static void gain_update(void *data, const float *params)
+{
+    gain_state *state = (gain_state *)data;
+    state->target = SDL_max(params[DSP_GAIN_VOLUME], 0.0f);
+
+    if (!state->primed)
+    {
+        state->current = state->target;
+        state->primed = 1;
+    }
+
+    // Restarts from wherever a running ramp got to
+    state->remaining = state->current != state->target ? state->ramp_frames : 0;
+    state->step = (state->target - state->current) / state->ramp_frames;
+}
+
+static void gain_reset(void *data)
+{
+    gain_state *state = (gain_state *)data;
+    state->current = state->target;
+    state->remaining = 0;
+}
+
+static void gain_process(void *data, float *samples, int frames, int channels)
+{
+    gain_state *state = (gain_state *)data;
+
+    int i = 0;
+    for (; i < frames && state->remaining > 0; i++, state->remaining--)
+    {
+        state->current += state->step;
+        for (int c = 0; c < channels; c++)
+        {
+            samples[i * channels + c] *= state->current;
+        }
+    }
+    if (state->remaining == 0)
+    {
+        state->current = state->target;
+    }
+
+    if (state->current != 1.0f)
+    {
+        float gain = state->current;
+        for (int s = i * channels; s < frames * channels; s++)
+        {
+            samples[s] *= gain;
+        }
+    }
+}
+
+const dsp_stage_type dsp_stage_gain = {
+    "Volume",
+    1,
+    {1.0f},
+    sizeof(gain_state),
+    gain_configure,
+    gain_update,
+    gain_reset,
+    gain_process,
+};
+
+
+/* ============================================================
+   Equalizer
+   ============================================================ */
+#define EQ_BANDS 3
+
+typedef struct biquad
+{
+    float b0, b1, b2, a1, a2; // normalized by a0
+} biquad;
+
+typedef struct eq_state
+{
+    int hz;
+    int active[EQ_BANDS];                         // bands at 0 dB are skipped
+    biquad filters[EQ_BANDS];
+    float z[EQ_BANDS][DSP_STAGE_MAX_CHANNELS][2]; // transposed direct form II state
+} eq_state;
+
+typedef enum eq_shape
+{
+    EQ_LOW_SHELF,
+    EQ_PEAK,
+    EQ_HIGH_SHELF,
+} eq_shape;
+
+static const double eq_frequencies[EQ_BANDS] = {DSP_EQ_LOW_HZ, DSP_EQ_MID_HZ, DSP_EQ_HIGH_HZ};
+
+// Audio EQ cookbook (R. Bristow-Johnson), shelves with slope 1, the peak with Q 0.7
+static biquad eq_design(eq_shape shape, double frequency, double gain_db, int hz)
+{
+    double a = pow(10.0, gain_db / 40.0);
+    double w0 = 2.0 * M_PI * SDL_min(frequency, hz * 0.45) / hz;
+    double cs = cos(w0);
+    double sn = sin(w0);
+    double b0, b1, b2, a0, a1, a2;
+
+    if (shape == EQ_PEAK)
+    {
+        double alpha = sn / (2.0 * 0.7);
+        b0 = 1.0 + alpha * a;
+        b1 = -2.0 * cs;
+        b2 = 1.0 - alpha * a;
+        a0 = 1.0 + alpha / a;
+        a1 = -2.0 * cs;
+        a2 = 1.0 - alpha / a;
+    }
+    else
+    {
+        double beta = 2.0 * sqrt(a) * sn / 2.0 * sqrt(2.0);
+        double sign = shape == EQ_LOW_SHELF ? 1.0 : -1.0;
+        b0 = a * ((a + 1.0) - sign * (a - 1.0) * cs + beta);
+        b1 = sign * 2.0 * a * ((a - 1.0) - sign * (a + 1.0) * cs);
+        b2 = a * ((a + 1.0) - sign * (a - 1.0) * cs - beta);
+        a0 = (a + 1.0) + sign * (a - 1.0) * cs + beta;
+        a1 = -sign * 2.0 * ((a - 1.0) + sign * (a + 1.0) * cs);
+        a2 = (a + 1.0) + sign * (a - 1.0) * cs - beta;
+    }
+
+    biquad filter = {(float)(b0 / a0), (float)(b1 / a0), (float)(b2 / a0), (float)(a1 / a0), (float)(a2 / a0)};
+    return filter;
+}
+
+static void eq_configure(void *data, int hz, int channels)
+{
+    eq_state *state = (eq_state *)data;
+    (void)channels;
+    state->hz = hz;
+}
+
+static void eq_update(void *data, const float *params)
+{
+    eq_state *state = (eq_state *)data;
+
+    for (int band = 0; band < EQ_BANDS; band++)
+    {
+        float gain_db = SDL_clamp(params[DSP_EQ_LOW_DB + band], -DSP_EQ_MAX_DB, DSP_EQ_MAX_DB);
+        state->active[band] = gain_db != 0.0f;
+        if (state->active[band] && state->hz > 0)
+        {
+            // Filter state carries over, a moving slider doesn't restart the filters
+            state->filters[band] = eq_design((eq_shape)band, eq_frequencies[band], gain_db, state->hz);
+        }
+    }
+}
+
+static void eq_reset(void *data)
+{
+    eq_state *state = (eq_state *)data;
+    SDL_zeroa(state->z);
+}
+
+static void eq_process(void *data, float *samples, int frames, int channels)
+{
+    eq_state *state = (eq_state *)data;
+
+    for (int band = 0; band < EQ_BANDS; band++)
+    {
+        if (!state->active[band])
+        {
+            continue;
+        }
+
+        const biquad f = state->filters[band];
+        for (int c = 0; c < channels && c < DSP_STAGE_MAX_CHANNELS; c++)
+        {
+            float z1 = state->z[band][c][0];
+            float z2 = state->z[band][c][1];
+            for (int i = 0; i < frames; i++)
+            {
+                float x = samples[i * channels + c];
+                float y = f.b0 * x + z1;
+                z1 = f.b1 * x - f.a1 * y + z2;
+                z2 = f.b2 * x - f.a2 * y;
+                samples[i * channels + c] = y;
+            }
+
+            // Denormals would slow the filters down to a crawl in silence
+            state->z[band][c][0] = fabsf(z1) < 1e-20f ? 0.0f : z1;
+            state->z[band][c][1] = fabsf(z2) < 1e-20f ? 0.0f : z2;
+        }
+    }
+}
+
+const dsp_stage_type dsp_stage_eq = {
+    "Equalizer",
+    EQ_BANDS,
+    {0.0f, 0.0f, 0.0f},
+    sizeof(eq_state),
+    eq_configure,
+    eq_update,
+    eq_reset,
+    eq_process,
+};
+
+
+/* ============================================================
+   Limiter
+   ============================================================ */
+typedef struct limiter_state
+{
+    int hz;
+    float threshold; // linear
+    float release;   // per frame coefficient
+    float gain;
+} limiter_state;
+
+static void limiter_configure(void *data, int hz, int channels)
+{
+    limiter_state *state = (limiter_state *)data;
+    (void)channels;
+    if (!state->hz)
+    {
+        state->gain = 1.0f;
+    }
+    state->hz = hz;
+}
+
+static void limiter_update(void *data, const float *params)
+{
+    limiter_state *state = (limiter_state *)data;
+    float release_frames = SDL_max(params[DSP_LIMITER_RELEASE_MS], 1.0f) * state->hz / 1000.0f;
+
+    state->threshold = powf(10.0f, SDL_min(params[DSP_LIMITER_THRESHOLD_DB], 0.0f) / 20.0f);
+    state->release = expf(-1.0f / SDL_max(release_frames, 1.0f));
+}
+
+static void limiter_reset(void *data)
+{
+    limiter_state *state = (limiter_state *)data;
+    state->gain = 1.0f;
+}
+
+static void limiter_process(void *data, float *samples, int frames, int channels)
+{
+    limiter_state *state = (limiter_state *)data;
+    float gain = state->gain;
+
+    for (int i = 0; i < frames; i++)
+    {
+        float *frame = samples + i * channels;
+        float peak = 0.0f;
+        for (int c = 0; c < channels; c++)
+        {
+            peak = fmaxf(peak, fabsf(frame[c]));
+        }
+
+        // Down at once, back up slowly; gain never exceeds what the peak allows
+        float target = peak > state->threshold ? state->threshold / peak : 1.0f;
+        gain = target < gain ? target : target + (gain - target) * state->release;
+        for (int c = 0; c < channels; c++)
+        {
+            frame[c] *= gain;
+        }
+    }
+
+    state->gain = gain;
+}
+
+const dsp_stage_type dsp_stage_limiter = {
+    "Limiter",
+    2,
+    {0.0f, 100.0f},
+    sizeof(limiter_state),
+    limiter_configure,
+    limiter_update,
+    limiter_reset,
+    limiter_process,
+};
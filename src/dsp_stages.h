@@ -0,0 +1,44 @@
+#pragma once
+
+#include "dsp_chain.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stages of the output chain, see dsp_chain.h
+
+// Volume, linear. Changes ramp over DSP_GAIN_RAMP_MS so they don't click.
+#define DSP_GAIN_RAMP_MS 20
+typedef enum dsp_gain_param
+{
+    DSP_GAIN_VOLUME,
+} dsp_gain_param;
+
+// Three band tone control: low shelf, peaking mid and high shelf (RBJ biquads), gains in dB
+#define DSP_EQ_MAX_DB 12.0f
+#define DSP_EQ_LOW_HZ 100.0
+#define DSP_EQ_MID_HZ 1000.0
+#define DSP_EQ_HIGH_HZ 10000.0
+typedef enum dsp_eq_param
+{
+    DSP_EQ_LOW_DB,
+    DSP_EQ_MID_DB,
+    DSP_EQ_HIGH_DB,
+} dsp_eq_param;
+
+// Peak limiter: instant attack, exponential release, both channels linked. Keeps samples
+// at or below the threshold in dBFS.
+typedef enum dsp_limiter_param
+{
+    DSP_LIMITER_THRESHOLD_DB,
+    DSP_LIMITER_RELEASE_MS,
+} dsp_limiter_param;
+
+extern const dsp_stage_type dsp_stage_gain;
+extern const dsp_stage_type dsp_stage_eq;
+extern const dsp_stage_type dsp_stage_limiter;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,205 @@
+#include "fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FFT_SSE 1
+#include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct fft_real
+{
+    int n;                    // real input size
+    int m;                    // complex transform size, n/2
+    int *bitrev;              // input permutation of the complex transform
+    float *tw_re, *tw_im;     // pass with half size h uses entries [h, 2h)
+    float *post_re, *post_im; // exp(-2*pi*i*k/n) for k in [0, m]
+    float *re, *im;           // work buffers, m each
+};
+
+fft_real *fft_real_create(int n)
+{
+    if (n < 16 || (n & (n - 1)))
+    {
+        return NULL;
+    }
+
+    fft_real *fft = (fft_real *)calloc(1, sizeof(fft_real));
+    if (!fft)
+    {
+        return NULL;
+    }
+
+    int m = n / 2;
+    fft->n = n;
+    fft->m = m;
+    fft->bitrev = (int *)malloc(m * sizeof(int));
+    fft->tw_re = (float *)malloc(m * sizeof(float));
+    fft->tw_im = (float *)malloc(m * sizeof(float));
+    fft->post_re = (float *)malloc((m + 1) * sizeof(float));
+    fft->post_im = (float *)malloc((m + 1) * sizeof(float));
+    fft->re = (float *)malloc(m * sizeof(float));
+    fft->im = (float *)malloc(m * sizeof(float));
+
+    if (!fft->bitrev || !fft->tw_re || !fft->tw_im || !fft->post_re || !fft->post_im || !fft->re || !fft->im)
+    {
+        fft_real_destroy(fft);
+        return NULL;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < m) bits++;
+
+    for (int i = 0; i < m; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        fft->bitrev[i] = r;
+    }
+
+    for (int h = 1; h < m; h *= 2)
+    {
+        for (int k = 0; k < h; k++)
+        {
+            double angle = -M_PI * k / h;
+            fft->tw_re[h + k] = (float)cos(angle);
+            fft->tw_im[h + k] = (float)sin(angle);
+        }
+    }
+
+    for (int k = 0; k <= m; k++)
+    {
+        double angle = -2.0 * M_PI * k / n;
+        fft->post_re[k] = (float)cos(angle);
+        fft->post_im[k] = (float)sin(angle);
+    }
+
+    return fft;
+}
+
+void fft_real_destroy(fft_real *fft)
+{
+    if (!fft)
+    {
+        return;
+    }
+
+    free(fft->bitrev);
+    free(fft->tw_re);
+    free(fft->tw_im);
+    free(fft->post_re);
+    free(fft->post_im);
+    free(fft->re);
+    free(fft->im);
+    free(fft);
+}
+
+int fft_real_size(const fft_real *fft)
+{
+    return fft->n;
+}
+
+// One radix-2 pass: butterflies of half size h over the whole buffer
+static void fft_pass(float *re, float *im, int m, int h, const float *tw_re, const float *tw_im)
+{
+    for (int j = 0; j < m; j += 2 * h)
+    {
+        float *a_re = re + j, *a_im = im + j;
+        float *b_re = a_re + h, *b_im = a_im + h;
+        int k = 0;
+
+#ifdef FFT_SSE
+        for (; k + 4 <= h; k += 4)
+        {
+            __m128 wr = _mm_loadu_ps(tw_re + k);
+            __m128 wi = _mm_loadu_ps(tw_im + k);
+            __m128 br = _mm_loadu_ps(b_re + k);
+            __m128 bi = _mm_loadu_ps(b_im + k);
+            __m128 ar = _mm_loadu_ps(a_re + k);
+            __m128 ai = _mm_loadu_ps(a_im + k);
+
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, br), _mm_mul_ps(wi, bi));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(wr, bi), _mm_mul_ps(wi, br));
+
+            _mm_storeu_ps(b_re + k, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(b_im + k, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(a_re + k, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(a_im + k, _mm_add_ps(ai, ti));
+        }
+#endif
+
+        for (; k < h; k++)
+        {
+            float tr = tw_re[k] * b_re[k] - tw_im[k] * b_im[k];
+            float ti = tw_re[k] * b_im[k] + tw_im[k] * b_re[k];
+
+            b_re[k] = a_re[k] - tr;
+            b_im[k] = a_im[k] - ti;
+            a_re[k] += tr;
+            a_im[k] += ti;
+        }
+    }
+}
+
+void fft_real_forward(fft_real *fft, const float *input, float *out_re, float *out_im)
+{
+    const int m = fft->m;
+    float *re = fft->re;
+    float *im = fft->im;
+
+    // Even samples go to the real part, odd ones to the imaginary part
+    for (int i = 0; i < m; i++)
+    {
+        int r = fft->bitrev[i];
+        re[r] = input[2 * i];
+        im[r] = input[2 * i + 1];
+    }
+
+    // First two passes as one radix-4 butterfly, the twiddles are 1 and -i
+    for (int j = 0; j < m; j += 4)
+    {
+        float r0 = re[j] + re[j + 1], i0 = im[j] + im[j + 1];
+        float r1 = re[j] - re[j + 1], i1 = im[j] - im[j + 1];
+        float r2 = re[j + 2] + re[j + 3], i2 = im[j + 2] + im[j + 3];
+        float r3 = re[j + 2] - re[j + 3], i3 = im[j + 2] - im[j + 3];
+
+        re[j] = r0 + r2;
+        im[j] = i0 + i2;
+        re[j + 2] = r0 - r2;
+        im[j + 2] = i0 - i2;
+        re[j + 1] = r1 + i3;
+        im[j + 1] = i1 - r3;
+        re[j + 3] = r1 - i3;
+        im[j + 3] = i1 + r3;
+    }
+
+    for (int h = 4; h < m; h *= 2)
+    {
+        fft_pass(re, im, m, h, fft->tw_re + h, fft->tw_im + h);
+    }
+
+    // Separate the spectra of the even and odd samples and combine them into bins 0..m
+    for (int k = 0; k <= m; k++)
+    {
+        int a = k & (m - 1);
+        int b = (m - k) & (m - 1);
+
+        float a_re = re[a], a_im = im[a];
+        float b_re = re[b], b_im = -im[b];
+
+        float e_re = 0.5f * (a_re + b_re), e_im = 0.5f * (a_im + b_im);
+        float o_re = 0.5f * (a_im - b_im), o_im = -0.5f * (a_re - b_re);
+
+        float w_re = fft->post_re[k], w_im = fft->post_im[k];
+        out_re[k] = e_re + w_re * o_re - w_im * o_im;
+        out_im[k] = e_im + w_re * o_im + w_im * o_re;
+    }
+}
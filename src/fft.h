@@ -0,0 +1,23 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Real-input FFT. The n real samples are packed into an n/2 point complex
+// transform (radix-4 first pass, radix-2 passes vectorized with SSE where
+// available) and the two interleaved halves are separated afterwards.
+typedef struct fft_real fft_real;
+
+// n must be a power of two, at least 16. Returns NULL when out of memory.
+fft_real *fft_real_create(int n);
+void fft_real_destroy(fft_real *fft);
+
+int fft_real_size(const fft_real *fft);
+
+// Transforms n real samples into bins 0..n/2, n/2 + 1 values each in out_re and out_im
+void fft_real_forward(fft_real *fft, const float *input, float *out_re, float *out_im);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,221 @@
+#include "index_cache.h"
+#include "cache.h"
+
+#include <SDL3/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_CACHE_KIND "index"
+#define INDEX_CACHE_MAGIC 0x58444950u /* "PIDX" */
+#define INDEX_CACHE_VERSION 1
+
+// Entries are little more than a varint pair per frame (~4 bytes), so this holds a lot of tracks
+#define INDEX_CACHE_DEFAULT_LIMIT_KB (64 * 1024)
+
+typedef struct index_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t samples;
+    uint32_t num_frames;
+    uint32_t path_len;     // the track path follows the header, guards against hash collisions
+    uint32_t payload_size; // varint encoded frame deltas follow the path
+    uint32_t reserved;
+} index_cache_header;
+
+static SDL_AtomicInt cache_hits;
+static SDL_AtomicInt cache_misses;
+static SDL_AtomicInt cache_stores;
+static SDL_AtomicInt cache_evictions;
+static SDL_AtomicU32 cache_kbytes;
+static SDL_AtomicU32 cache_limit_kb;
+
+static uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+    uint64_t result = 0;
+    int shift = 0;
+
+    while (p < end && shift < 64)
+    {
+        uint8_t b = *p++;
+        result |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+        {
+            *v = result;
+            return p;
+        }
+        shift += 7;
+    }
+
+    return NULL;
+}
+
+static int index_cache_miss(void)
+{
+    SDL_AddAtomicInt(&cache_misses, 1);
+    return 0;
+}
+
+int index_cache_load(const char *file_name, mp3dec_index_t *index, uint64_t *samples)
+{
+    char path[1200];
+    uint64_t file_size;
+    int64_t file_mtime;
+    size_t size = 0;
+
+    if (!cache_entry_path(path, sizeof(path), INDEX_CACHE_KIND, file_name, ".idx") || !cache_file_stamp(file_name, &file_size, &file_mtime))
+    {
+        return index_cache_miss();
+    }
+
+    uint8_t *data = (uint8_t *)SDL_LoadFile(path, &size);
+    if (!data)
+    {
+        return index_cache_miss();
+    }
+
+    index_cache_header header;
+    size_t path_len = strlen(file_name);
+    int ok = 0;
+
+    if (size >= sizeof(header))
+    {
+        memcpy(&header, data, sizeof(header));
+
+        ok = header.magic == INDEX_CACHE_MAGIC && header.version == INDEX_CACHE_VERSION && header.file_size == file_size && header.file_mtime == file_mtime && header.path_len == path_len && header.num_frames > 0 && sizeof(header) + path_len + header.payload_size == size && memcmp(data + sizeof(header), file_name, path_len) == 0;
+    }
+
+    mp3dec_frame_t *frames = NULL;
+    if (ok)
+    {
+        frames = (mp3dec_frame_t *)malloc(header.num_frames * sizeof(mp3dec_frame_t));
+        ok = frames != NULL;
+    }
+
+    if (ok)
+    {
+        const uint8_t *p = data + sizeof(header) + path_len;
+        const uint8_t *end = data + size;
+        uint64_t sample = 0, offset = 0;
+
+        for (uint32_t i = 0; i < header.num_frames && p; i++)
+        {
+            uint64_t sample_delta = 0, offset_delta = 0;
+
+            p = get_varint(p, end, &sample_delta);
+            if (p) p = get_varint(p, end, &offset_delta);
+
+            sample += sample_delta;
+            offset += offset_delta;
+            frames[i].sample = sample;
+            frames[i].offset = offset;
+        }
+
+        ok = p == end;
+    }
+
+    SDL_free(data);
+
+    if (!ok)
+    {
+        free(frames);
+        return index_cache_miss();
+    }
+
+    index->frames = frames;
+    index->num_frames = index->capacity = header.num_frames;
+    *samples = header.samples;
+
+    SDL_AddAtomicInt(&cache_hits, 1);
+
+    return 1;
+}
+
+int index_cache_store(const char *file_name, const mp3dec_index_t *index, uint64_t samples)
+{
+    char path[1200];
+    index_cache_header header;
+    size_t path_len = strlen(file_name);
+
+    if (!index->num_frames || !cache_entry_path(path, sizeof(path), INDEX_CACHE_KIND, file_name, ".idx"))
+    {
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    if (!cache_file_stamp(file_name, &header.file_size, &header.file_mtime))
+    {
+        return 0;
+    }
+
+    // Worst case is two 10 byte varints per frame
+    size_t capacity = sizeof(header) + path_len + index->num_frames * 20;
+    uint8_t *data = (uint8_t *)malloc(capacity);
+    if (!data)
+    {
+        return 0;
+    }
+
+    uint8_t *p = data + sizeof(header) + path_len;
+    uint64_t sample = 0, offset = 0;
+
+    for (size_t i = 0; i < index->num_frames; i++)
+    {
+        p = put_varint(p, index->frames[i].sample - sample);
+        p = put_varint(p, index->frames[i].offset - offset);
+        sample = index->frames[i].sample;
+        offset = index->frames[i].offset;
+    }
+
+    header.magic = INDEX_CACHE_MAGIC;
+    header.version = INDEX_CACHE_VERSION;
+    header.samples = samples;
+    header.num_frames = (uint32_t)index->num_frames;
+    header.path_len = (uint32_t)path_len;
+    header.payload_size = (uint32_t)(p - (data + sizeof(header) + path_len));
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), file_name, path_len);
+
+    int stored = cache_write_file(path, data, (size_t)(p - data));
+    free(data);
+
+    if (stored)
+    {
+        uint32_t limit_kb = SDL_GetAtomicU32(&cache_limit_kb);
+        uint64_t total = 0;
+
+        SDL_AddAtomicInt(&cache_stores, 1);
+        SDL_AddAtomicInt(&cache_evictions, cache_evict(INDEX_CACHE_KIND, (uint64_t)(limit_kb ? limit_kb : INDEX_CACHE_DEFAULT_LIMIT_KB) * 1024, &total));
+        SDL_SetAtomicU32(&cache_kbytes, (uint32_t)(total / 1024));
+    }
+
+    return stored;
+}
+
+void index_cache_set_limit(uint64_t max_bytes)
+{
+    SDL_SetAtomicU32(&cache_limit_kb, (uint32_t)SDL_max(max_bytes / 1024, 1));
+}
+
+void index_cache_get_stats(index_cache_stats *stats)
+{
+    stats->hits = SDL_GetAtomicInt(&cache_hits);
+    stats->misses = SDL_GetAtomicInt(&cache_misses);
+    stats->stores = SDL_GetAtomicInt(&cache_stores);
+    stats->evictions = SDL_GetAtomicInt(&cache_evictions);
+    stats->bytes = (uint64_t)SDL_GetAtomicU32(&cache_kbytes) * 1024;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <minimp3_ex.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct index_cache_stats
+{
+    int hits;
+    int misses;
+    int stores;
+    int evictions;
+    uint64_t bytes; // size of the cache after the last store
+} index_cache_stats;
+
+// Loads the cached frame index of file_name straight into index (which must be empty),
+// validated against the current size and mtime of the file. Returns 1 on a hit.
+int index_cache_load(const char *file_name, mp3dec_index_t *index, uint64_t *samples);
+
+// Stores a complete frame index (absolute offsets) and the scanned sample count,
+// then evicts old entries until the cache fits its size limit
+int index_cache_store(const char *file_name, const mp3dec_index_t *index, uint64_t samples);
+
+// Applies from the next store on
+void index_cache_set_limit(uint64_t max_bytes);
+void index_cache_get_stats(index_cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
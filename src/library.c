@@ -0,0 +1,1490 @@
+#include "library.h"
+#include "cache.h"
+#include "decode.h"
+#include "dir_watch.h"
+#include "stream_io.h"
+#include "tags.h"
+
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LIBRARY_CACHE_KIND "library"
+#define LIBRARY_MAGIC 0x42494c50u /* "PLIB" */
+#define LIBRARY_VERSION 3
+
+// Walking a network share waits on the server far more than on the CPU
+#define LIBRARY_MAX_THREADS 32
+#define LIBRARY_THREADS_PER_CORE 2
+
+#define LIBRARY_MAX_DEPTH 32              // symlinked folders may loop
+#define LIBRARY_PROBE_WINDOW (256 * 1024) // a probe reads the first frames and no further
+#define LIBRARY_TAG_WINDOW (256 * 1024)   // of a tag, bigger ones are read frame by frame
+#define LIBRARY_MAX_TAG_TEXT 512
+#define LIBRARY_MAX_PATH 4096
+
+#define LIBRARY_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+// The file starts with the header, the root path padded to 8 bytes, the tracks and then
+// the strings they point into, which begin with the empty string
+typedef struct library_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t strings_size;
+    uint32_t root_len; // guards against hash collisions of the file name
+    uint32_t reserved;
+    int64_t scanned_at; // wall clock time of the last scan of everything, in nanoseconds
+} library_header;
+
+// A library file image, used in place
+typedef struct library_db
+{
+    uint8_t *data;
+    const library_track *tracks;
+    const char *strings;
+    uint32_t count;
+    uint32_t strings_size;
+    size_t size;        // of data
+    int64_t scanned_at; // 0 for a library that was never scanned
+} library_db;
+
+typedef struct library_file
+{
+    char *path; // relative to the root, NULL for tracks an update kept as they were
+    library_track track;
+    const library_track *known; // the same file in the library the scan started from, unchanged
+    char *title;                // from the tags of a probed file, NULL if none
+    char *artist;
+    char *album;
+} library_file;
+
+typedef struct library_job library_job;
+
+// Per thread state of a scan
+typedef struct library_worker
+{
+    library_job *scan;
+    const char *dir; // folder being listed
+    library_file *found;
+    int found_count;
+    int found_capacity;
+    uint8_t *tag_buffer; // LIBRARY_TAG_WINDOW bytes while probing
+} library_worker;
+
+struct library_job
+{
+    const char *root;
+    const library_db *known; // what the library held when the scan started, read only
+    SDL_Thread *thread;
+    SDL_AtomicInt cancel;
+    SDL_AtomicInt done;
+    SDL_AtomicInt found;
+    SDL_AtomicInt probed;
+    SDL_AtomicInt reused;
+    SDL_AtomicInt failed;
+    Uint64 start_ns;
+    SDL_AtomicU32 elapsed_ms; // set when the scan is done
+
+    // Paths an update covers, sorted, NULL for a scan of everything
+    char **changes;
+    int change_count;
+    int index_only; // builds the search index of known without looking at the folder
+
+    // Folders waiting to be listed, busy counts the ones being listed
+    SDL_Mutex *lock;
+    SDL_Condition *wake;
+    char **dirs;
+    int dir_count;
+    int dir_capacity;
+    int busy;
+
+    // Everything the walk found sorted by path, and the ones that need probing
+    library_file *files;
+    int file_count;
+    int *pending;
+    int pending_count;
+    SDL_AtomicInt next;
+
+    library_worker workers[LIBRARY_MAX_THREADS];
+    library_db *result; // NULL when nothing changed
+
+    // The search index of known, read only, and the one made for the result
+    const search_index *known_search;
+    search_index *search_result;
+};
+
+struct library
+{
+    char *root;
+    library_db *db;
+    search_index *search; // of db, NULL until a scan has built it
+    library_job *scan;  // kept after it is done for its stats
+    int changed;        // a result was installed since the last library_poll
+    int watching;
+    dir_watch *watch;   // NULL when changes are found by rescanning
+    Uint64 scanned_ns;  // end of the last full scan
+};
+
+/* ============================================================
+   Library file
+   ============================================================ */
+static const char library_no_strings[1] = "";
+
+static void library_db_free(library_db *db)
+{
+    if (db)
+    {
+        SDL_free(db->data);
+        free(db);
+    }
+}
+
+static library_db *library_db_empty(void)
+{
+    library_db *db = (library_db *)calloc(1, sizeof(library_db));
+    if (db)
+    {
+        db->strings = library_no_strings;
+        db->strings_size = 1;
+    }
+    return db;
+}
+
+// Takes over data if it holds a valid library of root
+static int library_db_attach(library_db *db, uint8_t *data, size_t size, const char *root)
+{
+    library_header header;
+    size_t root_len = strlen(root);
+
+    if (size < sizeof(header))
+    {
+        return 0;
+    }
+
+    // The root has to be there before it is compared, the file could be cut short
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != LIBRARY_MAGIC || header.version != LIBRARY_VERSION || header.root_len != root_len ||
+        size < sizeof(header) + LIBRARY_ALIGN(root_len) || memcmp(data + sizeof(header), root, root_len) != 0)
+    {
+        return 0;
+    }
+
+    uint64_t tracks_offset = sizeof(header) + LIBRARY_ALIGN(root_len);
+    uint64_t strings_offset = tracks_offset + (uint64_t)header.count * sizeof(library_track);
+    if (header.strings_size == 0 || strings_offset + header.strings_size != size || data[size - 1] != '\0')
+    {
+        return 0;
+    }
+
+    // Every offset has to land in the strings, the file could be damaged
+    const library_track *tracks = (const library_track *)(data + tracks_offset);
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+        const library_track *track = &tracks[i];
+        if (track->path >= header.strings_size || track->title >= header.strings_size ||
+            track->artist >= header.strings_size || track->album >= header.strings_size)
+        {
+            return 0;
+        }
+    }
+
+    db->data = data;
+    db->tracks = tracks;
+    db->strings = (const char *)(data + strings_offset);
+    db->count = header.count;
+    db->strings_size = header.strings_size;
+    db->size = size;
+    db->scanned_at = header.scanned_at;
+    return 1;
+}
+
+// First track whose path doesn't sort before key
+static int library_lower_bound(const library_db *db, const char *key)
+{
+    int lo = 0, hi = (int)db->count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(db->strings + db->tracks[mid].path, key) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static const char *library_file_path(const library_db *known, const library_file *file)
+{
+    return file->path ? file->path : known->strings + file->known->path;
+}
+
+static library_db *library_db_load(const char *root)
+{
+    char path[1200];
+    size_t size = 0;
+
+    if (!cache_entry_path(path, sizeof(path), LIBRARY_CACHE_KIND, root, ".db"))
+    {
+        return NULL;
+    }
+
+    uint8_t *data = (uint8_t *)SDL_LoadFile(path, &size);
+    if (!data)
+    {
+        return NULL;
+    }
+
+    library_db *db = (library_db *)calloc(1, sizeof(library_db));
+    if (!db || !library_db_attach(db, data, size, root))
+    {
+        SDL_free(data);
+        free(db);
+        return NULL;
+    }
+
+    return db;
+}
+
+// Room a string takes in the strings, the empty one is shared
+static size_t library_string_size(const char *s)
+{
+    return s && *s ? strlen(s) + 1 : 0;
+}
+
+static uint32_t library_put_string(char *strings, uint32_t *used, const char *s)
+{
+    if (!s || !*s)
+    {
+        return 0;
+    }
+
+    uint32_t offset = *used;
+    size_t len = strlen(s) + 1;
+    memcpy(strings + offset, s, len);
+    *used += (uint32_t)len;
+    return offset;
+}
+
+static void library_db_save(const library_db *db, const char *root)
+{
+    char path[1200];
+    if (!cache_entry_path(path, sizeof(path), LIBRARY_CACHE_KIND, root, ".db") || !cache_write_file(path, db->data, db->size))
+    {
+        printf("warning: couldn't save the library of %s\n", root);
+    }
+}
+
+// Lays out the sorted files as a library file, returns NULL when out of memory
+static library_db *library_db_build(const char *root, const library_file *files, int count, const library_db *known, int64_t scanned_at)
+{
+    uint64_t strings_size = 1;
+    for (int i = 0; i < count; i++)
+    {
+        const library_file *file = &files[i];
+        strings_size += strlen(library_file_path(known, file)) + 1;
+        if (file->known)
+        {
+            const library_track *track = file->known;
+            strings_size += library_string_size(known->strings + track->title);
+            strings_size += library_string_size(known->strings + track->artist);
+            strings_size += library_string_size(known->strings + track->album);
+        }
+        else
+        {
+            strings_size += library_string_size(file->title);
+            strings_size += library_string_size(file->artist);
+            strings_size += library_string_size(file->album);
+        }
+    }
+
+    size_t root_len = strlen(root);
+    size_t tracks_offset = sizeof(library_header) + LIBRARY_ALIGN(root_len);
+    uint64_t size = tracks_offset + (uint64_t)count * sizeof(library_track) + strings_size;
+    if (strings_size > UINT32_MAX || size > SIZE_MAX)
+    {
+        return NULL;
+    }
+
+    library_db *db = (library_db *)calloc(1, sizeof(library_db));
+    uint8_t *data = (uint8_t *)SDL_calloc(1, (size_t)size);
+    if (!db || !data)
+    {
+        free(db);
+        SDL_free(data);
+        return NULL;
+    }
+
+    library_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LIBRARY_MAGIC;
+    header.version = LIBRARY_VERSION;
+    header.count = (uint32_t)count;
+    header.strings_size = (uint32_t)strings_size;
+    header.root_len = (uint32_t)root_len;
+    header.scanned_at = scanned_at;
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), root, root_len);
+
+    library_track *tracks = (library_track *)(data + tracks_offset);
+    char *strings = (char *)(tracks + count);
+    uint32_t used = 1;
+    for (int i = 0; i < count; i++)
+    {
+        const library_file *file = &files[i];
+        library_track *track = &tracks[i];
+
+        *track = file->known ? *file->known : file->track;
+        track->path = library_put_string(strings, &used, library_file_path(known, file));
+        if (file->known)
+        {
+            track->title = library_put_string(strings, &used, known->strings + file->known->title);
+            track->artist = library_put_string(strings, &used, known->strings + file->known->artist);
+            track->album = library_put_string(strings, &used, known->strings + file->known->album);
+        }
+        else
+        {
+            track->title = library_put_string(strings, &used, file->title);
+            track->artist = library_put_string(strings, &used, file->artist);
+            track->album = library_put_string(strings, &used, file->album);
+        }
+    }
+
+    db->data = data;
+    db->tracks = tracks;
+    db->strings = strings;
+    db->count = (uint32_t)count;
+    db->strings_size = (uint32_t)strings_size;
+    db->size = (size_t)size;
+    db->scanned_at = scanned_at;
+    library_db_save(db, root);
+    return db;
+}
+
+/* ============================================================
+   Scan
+   ============================================================ */
+static int library_full_path(char *out, size_t out_size, const char *root, const char *path)
+{
+    size_t len = strlen(root);
+    const char *sep = !*path || (len > 0 && (root[len - 1] == '/' || root[len - 1] == '\\')) ? "" : "/";
+
+    return SDL_snprintf(out, out_size, "%s%s%s", root, sep, path) < (int)out_size;
+}
+
+static int library_is_track(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && SDL_strcasecmp(name + len - 4, ".mp3") == 0;
+}
+
+static int library_depth(const char *dir)
+{
+    int depth = *dir ? 1 : 0;
+    for (; *dir; dir++)
+    {
+        depth += *dir == '/';
+    }
+    return depth;
+}
+
+// Called with the lock held
+static void library_push_dir(library_job *scan, char *dir)
+{
+    if (scan->dir_count == scan->dir_capacity)
+    {
+        int capacity = scan->dir_capacity ? scan->dir_capacity * 2 : 256;
+        char **dirs = (char **)realloc(scan->dirs, capacity * sizeof(char *));
+        if (!dirs)
+        {
+            SDL_free(dir);
+            return;
+        }
+        scan->dirs = dirs;
+        scan->dir_capacity = capacity;
+    }
+
+    scan->dirs[scan->dir_count++] = dir;
+    SDL_SignalCondition(scan->wake);
+}
+
+static void library_add_file(library_worker *worker, char *path, const SDL_PathInfo *info)
+{
+    if (worker->found_count == worker->found_capacity)
+    {
+        int capacity = worker->found_capacity ? worker->found_capacity * 2 : 1024;
+        library_file *found = (library_file *)realloc(worker->found, capacity * sizeof(library_file));
+        if (!found)
+        {
+            SDL_free(path);
+            return;
+        }
+        worker->found = found;
+        worker->found_capacity = capacity;
+    }
+
+    library_file *file = &worker->found[worker->found_count++];
+    memset(file, 0, sizeof(*file));
+    file->path = path;
+    file->track.size = info->size;
+    file->track.mtime = info->modify_time;
+    SDL_AddAtomicInt(&worker->scan->found, 1);
+}
+
+static SDL_EnumerationResult SDLCALL library_walk_entry(void *userdata, const char *dirname, const char *fname)
+{
+    library_worker *worker = (library_worker *)userdata;
+    library_job *scan = worker->scan;
+    char full[LIBRARY_MAX_PATH];
+    char path[LIBRARY_MAX_PATH];
+    SDL_PathInfo info;
+
+    if (SDL_GetAtomicInt(&scan->cancel))
+    {
+        return SDL_ENUM_SUCCESS;
+    }
+
+    // Hidden entries, and the . and .. some platforms list
+    if (fname[0] == '.')
+    {
+        return SDL_ENUM_CONTINUE;
+    }
+
+    if (!library_full_path(full, sizeof(full), dirname, fname) ||
+        SDL_snprintf(path, sizeof(path), "%s%s%s", worker->dir, *worker->dir ? "/" : "", fname) >= (int)sizeof(path) ||
+        !SDL_GetPathInfo(full, &info))
+    {
+        return SDL_ENUM_CONTINUE;
+    }
+
+    if (info.type == SDL_PATHTYPE_DIRECTORY && library_depth(path) < LIBRARY_MAX_DEPTH)
+    {
+        char *dir = SDL_strdup(path);
+        if (dir)
+        {
+            SDL_LockMutex(scan->lock);
+            library_push_dir(scan, dir);
+            SDL_UnlockMutex(scan->lock);
+        }
+    }
+    else if (info.type == SDL_PATHTYPE_FILE && library_is_track(fname))
+    {
+        char *file = SDL_strdup(path);
+        if (file)
+        {
+            library_add_file(worker, file, &info);
+        }
+    }
+
+    return SDL_ENUM_CONTINUE;
+}
+
+// Lists folders until none are left and no other worker can add more
+static int SDLCALL library_walk_thread(void *data)
+{
+    library_worker *worker = (library_worker *)data;
+    library_job *scan = worker->scan;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    SDL_LockMutex(scan->lock);
+    for (;;)
+    {
+        if (scan->dir_count > 0 && !SDL_GetAtomicInt(&scan->cancel))
+        {
+            char *dir = scan->dirs[--scan->dir_count];
+            scan->busy++;
+            SDL_UnlockMutex(scan->lock);
+
+            char full[LIBRARY_MAX_PATH];
+            if (library_full_path(full, sizeof(full), scan->root, dir))
+            {
+                worker->dir = dir;
+                SDL_EnumerateDirectory(full, library_walk_entry, worker);
+            }
+            SDL_free(dir);
+
+            SDL_LockMutex(scan->lock);
+            scan->busy--;
+        }
+        else if (scan->busy == 0 || SDL_GetAtomicInt(&scan->cancel))
+        {
+            break;
+        }
+        else
+        {
+            SDL_WaitCondition(scan->wake, scan->lock);
+        }
+    }
+
+    // The walk is over for the others as well
+    SDL_BroadcastCondition(scan->wake);
+    SDL_UnlockMutex(scan->lock);
+
+    return 0;
+}
+
+// Reads what the first frames tell about a track
+static char *library_tag_text(const tags_field *field)
+{
+    char text[LIBRARY_MAX_TAG_TEXT];
+    return tags_text(field, text, sizeof(text)) > 0 ? SDL_strdup(text) : NULL;
+}
+
+// Keeps what the tags hold that file has no value for yet, the buffer they point into is reused
+static void library_take_tags(library_file *file, const tags *t)
+{
+    if (!file->title)
+    {
+        file->title = library_tag_text(&t->title);
+    }
+    if (!file->artist)
+    {
+        file->artist = library_tag_text(&t->artist);
+    }
+    if (!file->album)
+    {
+        file->album = library_tag_text(&t->album);
+    }
+    if (!file->track.track)
+    {
+        file->track.track = (uint16_t)SDL_min(t->track, UINT16_MAX);
+    }
+}
+
+// Reads an ID3v2 tag bigger than LIBRARY_TAG_WINDOW frame by frame, seeking past the ones
+// that aren't needed, which is where the size comes from: cover art. The frames kept follow
+// each other in buffer. Returns how much of it they take, header included.
+static size_t library_read_large_id3v2(stream_io *stream, uint8_t *buffer, size_t size)
+{
+    mp3dec_io_t *io = &stream->io;
+    size_t got = TAGS_HEADER_SIZE + io->read(buffer + TAGS_HEADER_SIZE, 4, io->read_data);
+    size_t first = tags_id3v2_first_frame(buffer, got);
+    if (!first || first > LIBRARY_TAG_WINDOW / 2)
+    {
+        // The frames that fit then
+        return got + io->read(buffer + got, LIBRARY_TAG_WINDOW - got, io->read_data);
+    }
+    if (first > got && io->read(buffer + got, first - got, io->read_data) != first - got)
+    {
+        return 0;
+    }
+
+    // Frames kept follow each other from where the first one starts
+    size_t end = SDL_min(size, (size_t)stream->size);
+    size_t used = first;
+    for (size_t at = first; at < end && used + TAGS_FRAME_HEADER_SIZE <= LIBRARY_TAG_WINDOW;)
+    {
+        // The audio after the tag pads the header of a short last frame
+        uint8_t *frame = buffer + used;
+        if (io->seek(at, io->seek_data) != 0 || io->read(frame, TAGS_FRAME_HEADER_SIZE, io->read_data) != TAGS_FRAME_HEADER_SIZE)
+        {
+            break;
+        }
+
+        int text;
+        size_t frame_size = tags_id3v2_frame_size(buffer, frame, &text);
+        if (!frame_size || frame_size > end - at)
+        {
+            break;
+        }
+
+        if (text && frame_size <= LIBRARY_TAG_WINDOW - used)
+        {
+            size_t have = SDL_min(frame_size, (size_t)TAGS_FRAME_HEADER_SIZE);
+            if (frame_size > have && io->read(frame + have, frame_size - have, io->read_data) != frame_size - have)
+            {
+                break;
+            }
+            used += frame_size;
+        }
+        at += frame_size;
+    }
+    return used;
+}
+
+// Reads the ID3v2 tag at the start and the APE and ID3v1 tags at the end into buffer, one after
+// the other. Returns the TLEN of the ID3v2 tag, 0 if it has none.
+static uint32_t library_read_tags(stream_io *stream, uint8_t *buffer, library_file *file)
+{
+    mp3dec_io_t *io = &stream->io;
+    uint32_t length_ms = 0;
+    tags t;
+
+    size_t got = io->read(buffer, TAGS_HEADER_SIZE, io->read_data);
+    size_t size = tags_id3v2_size(buffer, got);
+    if (size > LIBRARY_TAG_WINDOW)
+    {
+        got = library_read_large_id3v2(stream, buffer, size);
+    }
+    else if (size > TAGS_HEADER_SIZE)
+    {
+        got += io->read(buffer + got, size - got, io->read_data);
+    }
+
+    if (size > TAGS_HEADER_SIZE)
+    {
+        memset(&t, 0, sizeof(t));
+        tags_parse_id3v2(buffer, got, &t);
+        library_take_tags(file, &t);
+        length_ms = t.length_ms;
+    }
+
+    // The last bytes tell how far the tags at the end reach
+    size = (size_t)SDL_min(stream->size, TAGS_TAIL_SIZE);
+    if (size == 0 || io->seek(stream->size - size, io->seek_data) != 0)
+    {
+        return length_ms;
+    }
+    got = io->read(buffer, size, io->read_data);
+
+    size_t tail = tags_tail_size(buffer, got);
+    if (tail > got && tail <= LIBRARY_TAG_WINDOW && tail <= stream->size && io->seek(stream->size - tail, io->seek_data) == 0)
+    {
+        got = io->read(buffer, tail, io->read_data);
+    }
+
+    memset(&t, 0, sizeof(t));
+    if (tags_parse_tail(buffer, got, &t))
+    {
+        library_take_tags(file, &t);
+    }
+    return length_ms;
+}
+
+static int library_probe(const char *file_name, library_file *file, uint8_t *tag_buffer)
+{
+    library_track *track = &file->track;
+    stream_io *stream = stream_io_open(file_name, LIBRARY_PROBE_WINDOW);
+    uint32_t length_ms = stream && tag_buffer ? library_read_tags(stream, tag_buffer, file) : 0;
+
+    // minimp3 starts over from the beginning and skips the ID3v2 tag itself
+    mp3dec_ex_t *dec = (mp3dec_ex_t *)calloc(1, sizeof(mp3dec_ex_t));
+    int ok = stream && dec && !mp3dec_ex_open_cb(dec, &stream->io, MP3D_SEEK_TO_SAMPLE | MP3D_DO_NOT_SCAN) &&
+        dec->info.hz > 0 && dec->info.channels > 0;
+
+    if (ok)
+    {
+        // Without a Xing frame the length the tagger wrote beats an estimate from the first frame
+        uint64_t samples = dec->vbr_tag_found ? dec->samples : decoder_estimate_samples(dec, stream->size);
+        uint64_t duration_ms = samples * 1000 / ((uint64_t)dec->info.hz * dec->info.channels);
+        track->duration_ms = (uint32_t)SDL_min(!dec->vbr_tag_found && length_ms ? length_ms : duration_ms, UINT32_MAX);
+        track->hz = (uint32_t)dec->info.hz;
+        track->channels = (uint16_t)dec->info.channels;
+        track->bitrate_kbps = (uint16_t)dec->info.bitrate_kbps;
+        track->flags = dec->vbr_tag_found ? LIBRARY_TRACK_EXACT_DURATION : 0;
+    }
+    else
+    {
+        track->flags = LIBRARY_TRACK_FAILED;
+    }
+
+    if (dec)
+    {
+        mp3dec_ex_close(dec);
+    }
+    free(dec);
+    stream_io_close(stream);
+
+    return ok;
+}
+
+static int SDLCALL library_probe_thread(void *data)
+{
+    library_worker *worker = (library_worker *)data;
+    library_job *scan = worker->scan;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    worker->tag_buffer = (uint8_t *)malloc(LIBRARY_TAG_WINDOW);
+
+    for (;;)
+    {
+        int index = SDL_AddAtomicInt(&scan->next, 1);
+        if (index >= scan->pending_count || SDL_GetAtomicInt(&scan->cancel))
+        {
+            break;
+        }
+
+        library_file *file = &scan->files[scan->pending[index]];
+        char full[LIBRARY_MAX_PATH];
+        if (library_full_path(full, sizeof(full), scan->root, file->path) && library_probe(full, file, worker->tag_buffer))
+        {
+            SDL_AddAtomicInt(&scan->probed, 1);
+        }
+        else
+        {
+            file->track.flags = LIBRARY_TRACK_FAILED;
+            SDL_AddAtomicInt(&scan->failed, 1);
+        }
+    }
+
+    free(worker->tag_buffer);
+    worker->tag_buffer = NULL;
+    return 0;
+}
+
+// Runs fn on every worker at once and waits for them, or on the calling thread if none starts
+static void library_run_workers(library_job *scan, SDL_ThreadFunction fn, const char *name)
+{
+    SDL_Thread *threads[LIBRARY_MAX_THREADS];
+    int count = SDL_clamp(SDL_GetNumLogicalCPUCores() * LIBRARY_THREADS_PER_CORE, 1, LIBRARY_MAX_THREADS);
+    int started = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        threads[started] = SDL_CreateThread(fn, name, &scan->workers[i]);
+        if (threads[started])
+        {
+            started++;
+        }
+    }
+
+    if (!started)
+    {
+        fn(&scan->workers[0]);
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        SDL_WaitThread(threads[i], NULL);
+    }
+}
+
+static int library_compare_files(const void *a, const void *b)
+{
+    return strcmp(((const library_file *)a)->path, ((const library_file *)b)->path);
+}
+
+// Marks the tracks at path and inside it
+static void library_touch(const library_db *known, uint8_t *touched, const char *path)
+{
+    int i = library_lower_bound(known, path);
+    if (i < (int)known->count && strcmp(known->strings + known->tracks[i].path, path) == 0)
+    {
+        touched[i] = 1;
+    }
+
+    // A folder holds what sorts from its name and a slash up to its name and a '0'
+    char *key = NULL;
+    if (SDL_asprintf(&key, "%s/", path) < 0)
+    {
+        return;
+    }
+    int first = library_lower_bound(known, key);
+    key[strlen(key) - 1] = '0';
+    int last = library_lower_bound(known, key);
+    SDL_free(key);
+
+    if (last > first)
+    {
+        memset(touched + first, 1, last - first);
+    }
+}
+
+// Merges the tracks outside the paths an update covers into the sorted files it found
+static int library_keep_unchanged(library_job *scan)
+{
+    const library_db *known = scan->known;
+    uint8_t *touched = (uint8_t *)calloc(SDL_max(known->count, 1), 1);
+    if (!touched)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < scan->change_count; i++)
+    {
+        library_touch(known, touched, scan->changes[i]);
+    }
+
+    int kept = 0;
+    for (uint32_t i = 0; i < known->count; i++)
+    {
+        kept += !touched[i];
+    }
+
+    int count = scan->file_count + kept;
+    library_file *files = (library_file *)malloc(SDL_max(count, 1) * sizeof(library_file));
+    int *pending = (int *)realloc(scan->pending, SDL_max(count, 1) * sizeof(int));
+    if (pending)
+    {
+        scan->pending = pending;
+    }
+    if (!files || !pending)
+    {
+        free(files);
+        free(touched);
+        return 0;
+    }
+
+    int found = 0, out = 0;
+    uint32_t k = 0;
+    while (found < scan->file_count || k < known->count)
+    {
+        if (k < known->count && touched[k])
+        {
+            k++;
+            continue;
+        }
+
+        if (k < known->count && (found == scan->file_count || strcmp(known->strings + known->tracks[k].path, scan->files[found].path) < 0))
+        {
+            library_file *file = &files[out++];
+            memset(file, 0, sizeof(*file));
+            file->known = &known->tracks[k++];
+        }
+        else
+        {
+            files[out++] = scan->files[found++];
+        }
+    }
+
+    free(scan->files);
+    free(touched);
+    scan->files = files;
+    scan->file_count = out;
+    return 1;
+}
+
+// Gathers the files of all workers sorted by path and picks out the ones that changed
+static int library_collect(library_job *scan)
+{
+    int total = 0;
+    for (int i = 0; i < LIBRARY_MAX_THREADS; i++)
+    {
+        total += scan->workers[i].found_count;
+    }
+
+    scan->files = (library_file *)malloc(SDL_max(total, 1) * sizeof(library_file));
+    if (!scan->files)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < LIBRARY_MAX_THREADS; i++)
+    {
+        library_worker *worker = &scan->workers[i];
+        if (!worker->found_count)
+        {
+            continue;
+        }
+        memcpy(scan->files + scan->file_count, worker->found, worker->found_count * sizeof(library_file));
+        scan->file_count += worker->found_count;
+        free(worker->found);
+        worker->found = NULL;
+        worker->found_count = 0;
+    }
+    qsort(scan->files, scan->file_count, sizeof(library_file), library_compare_files);
+
+    scan->pending = (int *)malloc(SDL_max(scan->file_count, 1) * sizeof(int));
+    if (!scan->pending || (scan->changes && !library_keep_unchanged(scan)))
+    {
+        return 0;
+    }
+
+    // Both lists are sorted, a single pass pairs them up
+    const library_db *known = scan->known;
+    uint32_t k = 0;
+    for (int i = 0; i < scan->file_count; i++)
+    {
+        library_file *file = &scan->files[i];
+        if (!file->path)
+        {
+            continue;
+        }
+
+        while (k < known->count && strcmp(known->strings + known->tracks[k].path, file->path) < 0)
+        {
+            k++;
+        }
+
+        const library_track *track = k < known->count ? &known->tracks[k] : NULL;
+        if (track && strcmp(known->strings + track->path, file->path) == 0 && track->size == file->track.size && track->mtime == file->track.mtime)
+        {
+            file->known = track;
+            SDL_AddAtomicInt(&scan->reused, 1);
+        }
+        else
+        {
+            scan->pending[scan->pending_count++] = i;
+        }
+    }
+
+    return 1;
+}
+
+// Queues the root for a full scan, or what is at the paths of an update: folders are walked
+// again, files probed, and paths that are gone drop out of the library
+static void library_seed(library_job *scan)
+{
+    if (!scan->changes)
+    {
+        char *top = SDL_strdup("");
+        if (top)
+        {
+            SDL_LockMutex(scan->lock);
+            library_push_dir(scan, top);
+            SDL_UnlockMutex(scan->lock);
+        }
+        return;
+    }
+
+    for (int i = 0; i < scan->change_count; i++)
+    {
+        const char *path = scan->changes[i];
+        char full[LIBRARY_MAX_PATH];
+        SDL_PathInfo info;
+        if (!library_full_path(full, sizeof(full), scan->root, path) || !SDL_GetPathInfo(full, &info))
+        {
+            continue;
+        }
+
+        if (info.type == SDL_PATHTYPE_DIRECTORY)
+        {
+            char *dir = SDL_strdup(path);
+            if (dir)
+            {
+                SDL_LockMutex(scan->lock);
+                library_push_dir(scan, dir);
+                SDL_UnlockMutex(scan->lock);
+            }
+        }
+        else if (info.type == SDL_PATHTYPE_FILE && library_is_track(path))
+        {
+            char *file = SDL_strdup(path);
+            if (file)
+            {
+                library_add_file(&scan->workers[0], file, &info);
+            }
+        }
+    }
+}
+
+/* ============================================================
+   Search
+   ============================================================ */
+static const char *library_search_text(void *user, uint32_t doc, int field)
+{
+    const library_db *db = (const library_db *)user;
+    const library_track *track = &db->tracks[doc];
+
+    // Files that aren't playable are never found
+    if (track->flags & LIBRARY_TRACK_FAILED)
+    {
+        return NULL;
+    }
+
+    switch (field)
+    {
+    case SEARCH_FIELD_TITLE:
+        return db->strings + track->title;
+    case SEARCH_FIELD_ARTIST:
+        return db->strings + track->artist;
+    case SEARCH_FIELD_ALBUM:
+        return db->strings + track->album;
+    case SEARCH_FIELD_PATH:
+        return db->strings + track->path;
+    }
+    return NULL;
+}
+
+// Brings the search index up to date with the result: tracks taken over from the library keep
+// their entries, only the ones probed now are read
+static search_index *library_search_index(library_job *scan)
+{
+    const library_db *known = scan->known;
+    const library_db *db = scan->result;
+    if (!scan->known_search)
+    {
+        return search_build(db->count, library_search_text, (void *)db);
+    }
+
+    search_index *index = NULL;
+    int32_t *new_of_old = (int32_t *)malloc(SDL_max(known->count, 1) * sizeof(int32_t));
+    uint32_t *added = (uint32_t *)malloc(SDL_max(scan->file_count, 1) * sizeof(uint32_t));
+    if (new_of_old && added)
+    {
+        uint32_t added_count = 0;
+        memset(new_of_old, 0xFF, known->count * sizeof(int32_t));
+        for (int i = 0; i < scan->file_count; i++)
+        {
+            const library_file *file = &scan->files[i];
+            if (file->known)
+            {
+                new_of_old[file->known - known->tracks] = i;
+            }
+            else
+            {
+                added[added_count++] = (uint32_t)i;
+            }
+        }
+        index = search_update(scan->known_search, new_of_old, added, added_count, db->count, library_search_text, (void *)db);
+    }
+
+    free(new_of_old);
+    free(added);
+    return index;
+}
+
+search_query *library_search(const library *lib, const char *text)
+{
+    return lib->search ? search_start(lib->search, text) : NULL;
+}
+
+int library_search_step(const library *lib, search_query *query)
+{
+    // Steps of a few hundred tracks keep reading the clock cheap next to the work
+    Uint64 until = SDL_GetTicksNS() + LIBRARY_SEARCH_STEP_US * SDL_NS_PER_US;
+    while (search_step(query, library_search_text, lib->db, 256))
+    {
+        if (SDL_GetTicksNS() >= until)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int SDLCALL library_scan_thread(void *data)
+{
+    library_job *scan = (library_job *)data;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    if (!scan->index_only)
+    {
+        library_seed(scan);
+        library_run_workers(scan, library_walk_thread, "plyr library walk");
+    }
+
+    if (!scan->index_only && !SDL_GetAtomicInt(&scan->cancel) && library_collect(scan))
+    {
+        library_run_workers(scan, library_probe_thread, "plyr library probe");
+
+        // Updates don't make the library any fresher where nothing was looked at
+        SDL_Time now = 0;
+        SDL_GetCurrentTime(&now);
+        int64_t scanned_at = scan->changes ? scan->known->scanned_at : now;
+
+        // An unchanged library stays as it is, on disk as well, apart from the time of the scan
+        if (!SDL_GetAtomicInt(&scan->cancel) && (scan->pending_count > 0 || scan->file_count != (int)scan->known->count))
+        {
+            scan->result = library_db_build(scan->root, scan->files, scan->file_count, scan->known, scanned_at);
+        }
+        else if (!SDL_GetAtomicInt(&scan->cancel) && !scan->changes && scan->known->data)
+        {
+            // Only the header changes, which nothing reads while the library is in use
+            library_header header;
+            memcpy(&header, scan->known->data, sizeof(header));
+            header.scanned_at = scanned_at;
+            memcpy(scan->known->data, &header, sizeof(header));
+            library_db_save(scan->known, scan->root);
+        }
+    }
+
+    // The first scan indexes what the library holds even when nothing changed
+    if (!SDL_GetAtomicInt(&scan->cancel))
+    {
+        if (scan->result)
+        {
+            scan->search_result = library_search_index(scan);
+        }
+        else if (!scan->known_search)
+        {
+            scan->search_result = search_build(scan->known->count, library_search_text, (void *)scan->known);
+        }
+    }
+
+    SDL_SetAtomicU32(&scan->elapsed_ms, (Uint32)SDL_max((SDL_GetTicksNS() - scan->start_ns) / 1000000, 1));
+    SDL_SetAtomicInt(&scan->done, 1);
+
+    return 0;
+}
+
+static void library_scan_free(library_job *scan)
+{
+    if (!scan)
+    {
+        return;
+    }
+
+    SDL_SetAtomicInt(&scan->cancel, 1);
+    if (scan->thread)
+    {
+        SDL_WaitThread(scan->thread, NULL);
+    }
+
+    for (int i = 0; i < scan->dir_count; i++)
+    {
+        SDL_free(scan->dirs[i]);
+    }
+    for (int i = 0; i < LIBRARY_MAX_THREADS; i++)
+    {
+        for (int j = 0; j < scan->workers[i].found_count; j++)
+        {
+            SDL_free(scan->workers[i].found[j].path);
+        }
+        free(scan->workers[i].found);
+    }
+    for (int i = 0; i < scan->file_count; i++)
+    {
+        SDL_free(scan->files[i].path);
+        SDL_free(scan->files[i].title);
+        SDL_free(scan->files[i].artist);
+        SDL_free(scan->files[i].album);
+    }
+
+    for (int i = 0; i < scan->change_count; i++)
+    {
+        SDL_free(scan->changes[i]);
+    }
+    SDL_free(scan->changes);
+
+    library_db_free(scan->result);
+    search_free(scan->search_result);
+    free(scan->dirs);
+    free(scan->files);
+    free(scan->pending);
+    SDL_DestroyCondition(scan->wake);
+    SDL_DestroyMutex(scan->lock);
+    free(scan);
+}
+
+/* ============================================================
+   Library
+   ============================================================ */
+library *library_open(const char *root)
+{
+    library *lib = (library *)calloc(1, sizeof(library));
+    if (!lib)
+    {
+        return NULL;
+    }
+
+    lib->root = SDL_strdup(root);
+    lib->db = library_db_load(root);
+    if (!lib->db)
+    {
+        lib->db = library_db_empty();
+    }
+
+    if (!lib->root || !lib->db)
+    {
+        library_close(lib);
+        return NULL;
+    }
+
+    return lib;
+}
+
+void library_close(library *lib)
+{
+    if (!lib)
+    {
+        return;
+    }
+
+    dir_watch_stop(lib->watch);
+    library_scan_free(lib->scan);
+    search_free(lib->search);
+    library_db_free(lib->db);
+    SDL_free(lib->root);
+    free(lib);
+}
+
+static int library_busy(const library *lib)
+{
+    return lib->scan && !SDL_GetAtomicInt(&lib->scan->done);
+}
+
+// Takes over the result of a finished scan
+static void library_install(library *lib)
+{
+    library_job *scan = lib->scan;
+    if (!scan || !scan->thread || !SDL_GetAtomicInt(&scan->done))
+    {
+        return;
+    }
+
+    SDL_WaitThread(scan->thread, NULL);
+    scan->thread = NULL;
+    if (!scan->changes && !scan->index_only)
+    {
+        lib->scanned_ns = SDL_GetTicksNS();
+    }
+
+    if (scan->result)
+    {
+        library_db_free(lib->db);
+        lib->db = scan->result;
+        scan->result = NULL;
+        scan->known = lib->db;
+        lib->changed = 1;
+
+        // An index of the tracks before is no use, the next scan builds one from scratch
+        search_free(lib->search);
+        lib->search = NULL;
+    }
+
+    if (scan->search_result)
+    {
+        search_free(lib->search);
+        lib->search = scan->search_result;
+        scan->search_result = NULL;
+        lib->changed = 1; // queries of the one before are gone with it
+    }
+    scan->known_search = lib->search;
+}
+
+// Starts a scan of everything, or an update of the sorted paths in changes, which it takes
+// over, or only indexes the tracks for search
+static int library_start(library *lib, char **changes, int change_count, int index_only)
+{
+    // A finished scan nobody has polled yet is the library the next one starts from
+    library_install(lib);
+    library_scan_free(lib->scan);
+
+    library_job *scan = (library_job *)calloc(1, sizeof(library_job));
+    lib->scan = scan;
+    if (!scan)
+    {
+        for (int i = 0; i < change_count; i++)
+        {
+            SDL_free(changes[i]);
+        }
+        SDL_free(changes);
+        return 0;
+    }
+
+    scan->root = lib->root;
+    scan->known = lib->db;
+    scan->known_search = lib->search;
+    scan->changes = changes;
+    scan->change_count = change_count;
+    scan->index_only = index_only;
+    scan->start_ns = SDL_GetTicksNS();
+    for (int i = 0; i < LIBRARY_MAX_THREADS; i++)
+    {
+        scan->workers[i].scan = scan;
+    }
+
+    scan->lock = SDL_CreateMutex();
+    scan->wake = SDL_CreateCondition();
+    if (scan->lock && scan->wake)
+    {
+        scan->thread = SDL_CreateThread(library_scan_thread, "plyr library", scan);
+    }
+
+    if (!scan->thread)
+    {
+        library_scan_free(scan);
+        lib->scan = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+int library_scan(library *lib)
+{
+    // Indexing is cancelled, the scan indexes what it finds anyway
+    return library_busy(lib) && !lib->scan->index_only ? 1 : library_start(lib, NULL, 0, 0);
+}
+
+int library_refresh(library *lib)
+{
+    SDL_Time now = 0;
+    SDL_GetCurrentTime(&now);
+    if (lib->db->count == 0 || now - lib->db->scanned_at >= (int64_t)SDL_MS_TO_NS(LIBRARY_RESCAN_INTERVAL_MS))
+    {
+        return library_scan(lib);
+    }
+    return library_busy(lib) ? 1 : library_start(lib, NULL, 0, 1);
+}
+
+void library_watch(library *lib, int enabled)
+{
+    if (enabled && !lib->watching)
+    {
+        lib->watch = dir_watch_start(lib->root);
+        if (!lib->scanned_ns)
+        {
+            lib->scanned_ns = SDL_GetTicksNS();
+        }
+    }
+    else if (!enabled)
+    {
+        dir_watch_stop(lib->watch);
+        lib->watch = NULL;
+    }
+    lib->watching = enabled;
+}
+
+int library_poll(library *lib)
+{
+    library_install(lib);
+
+    // Changes wait while a scan runs, the watch keeps collecting them meanwhile
+    if (lib->watching && !library_busy(lib))
+    {
+        if (lib->watch && !dir_watch_active(lib->watch))
+        {
+            // More folders than the system allows watches for
+            dir_watch_stop(lib->watch);
+            lib->watch = NULL;
+        }
+
+        if (lib->watch)
+        {
+            char **paths;
+            int count = dir_watch_take(lib->watch, &paths);
+            if (count == DIR_WATCH_RESCAN)
+            {
+                library_start(lib, NULL, 0, 0);
+            }
+            else if (count > 0)
+            {
+                library_start(lib, paths, count, 0);
+            }
+        }
+        else if (SDL_GetTicksNS() - lib->scanned_ns >= SDL_MS_TO_NS(LIBRARY_RESCAN_INTERVAL_MS))
+        {
+            library_start(lib, NULL, 0, 0);
+        }
+    }
+
+    int changed = lib->changed;
+    lib->changed = 0;
+    return changed;
+}
+
+int library_count(const library *lib)
+{
+    return (int)lib->db->count;
+}
+
+const library_track *library_track_at(const library *lib, int index)
+{
+    return index >= 0 && (uint32_t)index < lib->db->count ? &lib->db->tracks[index] : NULL;
+}
+
+const char *library_text(const library *lib, uint32_t offset)
+{
+    return offset < lib->db->strings_size ? lib->db->strings + offset : "";
+}
+
+int library_find(const library *lib, const char *path)
+{
+    int index = library_lower_bound(lib->db, path);
+    return index < (int)lib->db->count && strcmp(lib->db->strings + lib->db->tracks[index].path, path) == 0 ? index : -1;
+}
+
+int library_path(const library *lib, int index, char *out, size_t out_size)
+{
+    const library_track *track = library_track_at(lib, index);
+    return track && library_full_path(out, out_size, lib->root, lib->db->strings + track->path);
+}
+
+void library_list_dir(const library *lib, const char *dir, library_list_cb cb, void *user)
+{
+    const library_db *db = lib->db;
+    size_t dir_len = strlen(dir);
+    while (dir_len > 0 && dir[dir_len - 1] == '/')
+    {
+        dir_len--;
+    }
+
+    // Keys are the folder with a slash, then the name of a subfolder and the character after the slash
+    size_t capacity = dir_len + 64;
+    char *key = (char *)malloc(capacity);
+    if (!key)
+    {
+        return;
+    }
+
+    size_t prefix_len = dir_len ? dir_len + 1 : 0;
+    memcpy(key, dir, dir_len);
+    key[dir_len] = '/';
+    key[prefix_len] = '\0';
+
+    int i = library_lower_bound(db, key);
+    while (i < (int)db->count)
+    {
+        const char *path = db->strings + db->tracks[i].path;
+        if (strncmp(path, key, prefix_len) != 0)
+        {
+            break;
+        }
+
+        const char *name = path + prefix_len;
+        const char *slash = strchr(name, '/');
+        if (!slash)
+        {
+            cb(user, name, strlen(name), i);
+            i++;
+            continue;
+        }
+
+        size_t name_len = (size_t)(slash - name);
+        cb(user, name, name_len, -1);
+
+        // Everything in the subfolder sorts before its name followed by '0', which follows '/'
+        if (prefix_len + name_len + 2 > capacity)
+        {
+            capacity = prefix_len + name_len + 64;
+            char *grown = (char *)realloc(key, capacity);
+            if (!grown)
+            {
+                break;
+            }
+            key = grown;
+        }
+        memcpy(key + prefix_len, name, name_len);
+        key[prefix_len + name_len] = '0';
+        key[prefix_len + name_len + 1] = '\0';
+        i = library_lower_bound(db, key);
+        key[prefix_len] = '\0';
+    }
+
+    free(key);
+}
+
+void library_get_stats(library *lib, library_stats *stats)
+{
+    library_job *scan = lib->scan;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->tracks = (int)lib->db->count;
+    stats->search_bytes = search_memory(lib->search);
+    stats->watch = !lib->watching ? LIBRARY_WATCH_OFF : lib->watch ? LIBRARY_WATCH_NOTIFY : LIBRARY_WATCH_RESCAN;
+    if (!scan)
+    {
+        return;
+    }
+
+    if (scan->index_only)
+    {
+        stats->indexing = !SDL_GetAtomicInt(&scan->done);
+        return;
+    }
+
+    stats->scanned = 1;
+    stats->scanning = !SDL_GetAtomicInt(&scan->done);
+    stats->updating = scan->changes != NULL;
+    stats->found = SDL_GetAtomicInt(&scan->found);
+    stats->probed = SDL_GetAtomicInt(&scan->probed);
+    stats->reused = SDL_GetAtomicInt(&scan->reused);
+    stats->failed = SDL_GetAtomicInt(&scan->failed);
+
+    Uint32 elapsed_ms = SDL_GetAtomicU32(&scan->elapsed_ms);
+    if (!elapsed_ms)
+    {
+        elapsed_ms = (Uint32)SDL_max((SDL_GetTicksNS() - scan->start_ns) / 1000000, 1);
+    }
+    stats->tracks_per_second = (stats->probed + stats->reused + stats->failed) * 1000.0f / elapsed_ms;
+}
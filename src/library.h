@@ -0,0 +1,119 @@
+#pragma once
+
+#include "search.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The tracks under a music folder, kept in one file of the cache directory. Opening a
+// library only loads that file; a scan walks the folder on a pool of threads, opens the
+// files that are new or changed since the last scan and saves the result for next time,
+// with the time it finished.
+// A watched library updates itself as files come and go.
+typedef struct library library;
+
+#define LIBRARY_RESCAN_INTERVAL_MS (15 * 60 * 1000) // where changes can't be watched
+#define LIBRARY_SEARCH_STEP_US 500                  // time a library_search_step may take
+
+#define LIBRARY_TRACK_FAILED 0x1         // not a playable MP3, kept so it isn't probed again
+#define LIBRARY_TRACK_EXACT_DURATION 0x2 // from the Xing frame count, estimated from the bitrate otherwise
+
+// Offsets are into the strings of the library, see library_text
+typedef struct library_track
+{
+    uint32_t path; // relative to the root, '/' separated
+    uint32_t title;
+    uint32_t artist;
+    uint32_t album;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t duration_ms;
+    uint32_t hz;
+    uint16_t channels;
+    uint16_t bitrate_kbps; // of the first frame
+    uint16_t track;        // number on the album, 0 if unknown
+    uint16_t flags;        // LIBRARY_TRACK_*
+} library_track;
+
+typedef enum library_watch_mode
+{
+    LIBRARY_WATCH_OFF,
+    LIBRARY_WATCH_NOTIFY, // told about changes by the system
+    LIBRARY_WATCH_RESCAN, // scanned every LIBRARY_RESCAN_INTERVAL_MS: network shares, other platforms
+} library_watch_mode;
+
+typedef struct library_stats
+{
+    int tracks;   // in the library now
+    int scanning;
+    int updating; // the running scan only covers paths that changed
+    int indexing; // the search index of the loaded tracks is being built, nothing is scanned
+    int scanned;  // a scan or update ran since the library was opened, the counts below are its
+    library_watch_mode watch;
+    int found;    // files the running scan has come across so far
+    int probed;   // opened and read
+    int reused;   // unchanged, taken over from the library
+    int failed;
+    float tracks_per_second;
+    size_t search_bytes; // of the search index, 0 until the tracks are indexed
+} library_stats;
+
+// Called for every entry of a folder, track is -1 for a subfolder. name isn't terminated.
+typedef void (*library_list_cb)(void *user, const char *name, size_t name_len, int track);
+
+// Loads what the last scan of root found, without touching the folder itself.
+// Returns NULL when out of memory.
+library *library_open(const char *root);
+
+// Cancels a running scan
+void library_close(library *lib);
+
+// Starts a scan in the background unless one is running, returns 0 if it couldn't start
+int library_scan(library *lib);
+
+// What to do after opening: scans when the library is empty or its last scan of everything
+// is older than LIBRARY_RESCAN_INTERVAL_MS, otherwise only indexes the loaded tracks for
+// search without touching the folder. Returns 0 if it couldn't start.
+int library_refresh(library *lib);
+
+// Keeps the library up to date from library_poll: changed paths are scanned on their own
+// once they settle, everything else is taken over as it was
+void library_watch(library *lib, int enabled);
+
+// Installs the result of a finished scan and starts updates of a watched library. Returns 1
+// when the tracks or their search index changed, which invalidates every track index,
+// library_track pointer and search handed out before.
+int library_poll(library *lib);
+
+// Tracks are sorted by path
+int library_count(const library *lib);
+const library_track *library_track_at(const library *lib, int index);
+const char *library_text(const library *lib, uint32_t offset);
+
+// Index of the track at path, relative to the root, -1 if there is none
+int library_find(const library *lib, const char *path);
+
+// Full path of a track, returns 0 if it doesn't fit
+int library_path(const library *lib, int index, char *out, size_t out_size);
+
+// Lists the tracks and subfolders of dir, a path relative to the root ("" for the root
+// itself). Costs a binary search per entry, however many tracks lie below.
+void library_list_dir(const library *lib, const char *dir, library_list_cb cb, void *user);
+
+// Starts a search of the titles, artists, albums and paths of the tracks, whose hits are track
+// indices. NULL for an empty query and until the first scan has indexed the library. A change
+// of the tracks invalidates it like any track index, see library_poll.
+search_query *library_search(const library *lib, const char *text);
+
+// Searches on for about LIBRARY_SEARCH_STEP_US, returns 0 once the search is done
+int library_search_step(const library *lib, search_query *query);
+
+void library_get_stats(library *lib, library_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,393 @@
+#include "loudness.h"
+#include "cache.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define LOUDNESS_MAX_CHANNELS 2
+
+// True peak: 4x oversampling through a 48 tap windowed sinc split into 4 phases
+#define LOUDNESS_OVERSAMPLING 4
+#define LOUDNESS_PHASE_TAPS 12
+
+#define LOUDNESS_CACHE_KIND "loudness"
+#define LOUDNESS_CACHE_MAGIC 0x44554C50u /* "PLUD" */
+#define LOUDNESS_CACHE_VERSION 1
+
+// A few KB per track
+#define LOUDNESS_CACHE_DEFAULT_LIMIT_KB (16 * 1024)
+
+typedef struct loudness_biquad
+{
+    double b0, b1, b2, a1, a2;
+} loudness_biquad;
+
+struct loudness_meter
+{
+    int channels;
+    loudness_biquad shelf; // K-weighting stage 1, head effects
+    loudness_biquad highpass;
+    double state[LOUDNESS_MAX_CHANNELS][4]; // transposed direct form II, two per stage
+
+    int step_frames;    // 100 ms, a quarter of a gating block
+    int step_filled;
+    double step_energy;
+    double steps[4];    // mean square of the last four steps, one gating block together
+    int steps_seen;
+    loudness_histogram histogram;
+
+    float taps[LOUDNESS_OVERSAMPLING][LOUDNESS_PHASE_TAPS];
+    float history[LOUDNESS_MAX_CHANNELS][2 * LOUDNESS_PHASE_TAPS]; // written twice, read as one window
+    int history_pos;
+    float peak;
+};
+
+typedef struct loudness_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint32_t path_len; // the track path follows the header, guards against hash collisions
+    uint32_t bins;     // nonzero histogram bins, index/count pairs after the path
+    float integrated;
+    float peak;
+    float gain;
+    int32_t has_album;
+    float album_gain;
+    float album_peak;
+} loudness_cache_header;
+
+
+/* ============================================================
+   Meter
+   ============================================================ */
+loudness_meter *loudness_meter_create(int hz, int channels)
+{
+    if (hz <= 0 || channels < 1 || channels > LOUDNESS_MAX_CHANNELS)
+    {
+        return NULL;
+    }
+
+    loudness_meter *meter = (loudness_meter *)calloc(1, sizeof(loudness_meter));
+    if (!meter)
+    {
+        return NULL;
+    }
+
+    meter->channels = channels;
+    meter->step_frames = hz / 10;
+
+    // BS.1770 filters for any rate, from the analog prototypes of the 48 kHz coefficients
+    double f0 = 1681.974450955533;
+    double gain_db = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / hz);
+    double vh = pow(10.0, gain_db / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+
+    meter->shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    meter->shelf.b1 = 2.0 * (k * k - vh) / a0;
+    meter->shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    meter->shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    meter->shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / hz);
+    a0 = 1.0 + k / q + k * k;
+
+    meter->highpass.b0 = 1.0;
+    meter->highpass.b1 = -2.0;
+    meter->highpass.b2 = 1.0;
+    meter->highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    meter->highpass.a2 = (1.0 - k / q + k * k) / a0;
+
+    // Hann windowed sinc, every phase normalized to unity gain
+    const int length = LOUDNESS_OVERSAMPLING * LOUDNESS_PHASE_TAPS;
+    for (int phase = 0; phase < LOUDNESS_OVERSAMPLING; phase++)
+    {
+        double sum = 0.0;
+        for (int tap = 0; tap < LOUDNESS_PHASE_TAPS; tap++)
+        {
+            int n = tap * LOUDNESS_OVERSAMPLING + phase;
+            double t = (n - (length - 1) / 2.0) / LOUDNESS_OVERSAMPLING;
+            double sinc = t == 0.0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            double window = 0.5 - 0.5 * cos(2.0 * M_PI * (n + 0.5) / length);
+
+            meter->taps[phase][tap] = (float)(sinc * window);
+            sum += sinc * window;
+        }
+        for (int tap = 0; tap < LOUDNESS_PHASE_TAPS; tap++)
+        {
+            meter->taps[phase][tap] = (float)(meter->taps[phase][tap] / sum);
+        }
+    }
+
+    return meter;
+}
+
+void loudness_meter_destroy(loudness_meter *meter)
+{
+    free(meter);
+}
+
+static double biquad_run(const loudness_biquad *f, double *state, double x)
+{
+    double y = f->b0 * x + state[0];
+    state[0] = f->b1 * x - f->a1 * y + state[1];
+    state[1] = f->b2 * x - f->a2 * y;
+    return y;
+}
+
+static void loudness_add_block(loudness_meter *meter, double energy)
+{
+    double loudness = -0.691 + 10.0 * log10(energy + 1e-30);
+    if (loudness < LOUDNESS_HISTOGRAM_MIN_LUFS)
+    {
+        return; // absolute gate
+    }
+
+    int bin = (int)((loudness - LOUDNESS_HISTOGRAM_MIN_LUFS) * 10.0);
+    meter->histogram.bins[bin < LOUDNESS_HISTOGRAM_BINS ? bin : LOUDNESS_HISTOGRAM_BINS - 1]++;
+}
+
+void loudness_meter_add(loudness_meter *meter, const mp3d_sample_t *samples, size_t count)
+{
+    const int channels = meter->channels;
+    size_t frames = count / channels;
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        int pos = meter->history_pos;
+        meter->history_pos = (pos + 1) % LOUDNESS_PHASE_TAPS;
+
+        for (int ch = 0; ch < channels; ch++)
+        {
+#ifdef MINIMP3_FLOAT_OUTPUT
+            float x = samples[i * channels + ch];
+#else
+            float x = samples[i * channels + ch] * (1.0f / 32768.0f);
+#endif
+            double *state = meter->state[ch];
+            double y = biquad_run(&meter->highpass, state + 2, biquad_run(&meter->shelf, state, x));
+            meter->step_energy += y * y; // all mono/stereo channels weigh 1.0
+
+            // Window of the latest LOUDNESS_PHASE_TAPS samples at history + pos + 1, oldest first
+            float *history = meter->history[ch];
+            history[pos] = history[pos + LOUDNESS_PHASE_TAPS] = x;
+            const float *window = history + pos + 1;
+
+            float peak = fabsf(x);
+            for (int phase = 0; phase < LOUDNESS_OVERSAMPLING; phase++)
+            {
+                const float *taps = meter->taps[phase];
+                float v = 0.0f;
+                for (int tap = 0; tap < LOUDNESS_PHASE_TAPS; tap++)
+                {
+                    v += window[tap] * taps[tap];
+                }
+                peak = fmaxf(peak, fabsf(v));
+            }
+            meter->peak = fmaxf(meter->peak, peak);
+        }
+
+        if (++meter->step_filled == meter->step_frames)
+        {
+            meter->steps[meter->steps_seen++ & 3] = meter->step_energy / meter->step_frames;
+            meter->step_energy = 0.0;
+            meter->step_filled = 0;
+
+            if (meter->steps_seen >= 4)
+            {
+                loudness_add_block(meter, (meter->steps[0] + meter->steps[1] + meter->steps[2] + meter->steps[3]) * 0.25);
+            }
+        }
+    }
+}
+
+const loudness_histogram *loudness_meter_histogram(const loudness_meter *meter)
+{
+    return &meter->histogram;
+}
+
+float loudness_meter_peak(const loudness_meter *meter)
+{
+    return meter->peak;
+}
+
+static double bin_energy(int bin)
+{
+    double loudness = LOUDNESS_HISTOGRAM_MIN_LUFS + (bin + 0.5) * 0.1;
+    return pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+float loudness_integrated(const loudness_histogram *histogram)
+{
+    double energy = 0.0;
+    uint64_t blocks = 0;
+
+    for (int bin = 0; bin < LOUDNESS_HISTOGRAM_BINS; bin++)
+    {
+        energy += histogram->bins[bin] * bin_energy(bin);
+        blocks += histogram->bins[bin];
+    }
+
+    if (!blocks)
+    {
+        return -HUGE_VALF;
+    }
+
+    // Relative gate, 10 LU below the loudness of everything above the absolute gate
+    double threshold = -0.691 + 10.0 * log10(energy / blocks) - 10.0;
+    int first = (int)ceil((threshold - LOUDNESS_HISTOGRAM_MIN_LUFS) * 10.0 - 0.5);
+
+    energy = 0.0;
+    blocks = 0;
+    for (int bin = first < 0 ? 0 : first; bin < LOUDNESS_HISTOGRAM_BINS; bin++)
+    {
+        energy += histogram->bins[bin] * bin_energy(bin);
+        blocks += histogram->bins[bin];
+    }
+
+    return blocks ? (float)(-0.691 + 10.0 * log10(energy / blocks)) : -HUGE_VALF;
+}
+
+float loudness_linear_gain(float gain_db, float peak)
+{
+    float gain = powf(10.0f, gain_db / 20.0f);
+    float ceiling = powf(10.0f, LOUDNESS_PEAK_CEILING_DBTP / 20.0f);
+
+    return peak > 0.0f && gain * peak > ceiling ? ceiling / peak : gain;
+}
+
+
+/* ============================================================
+   Cache
+   ============================================================ */
+int loudness_cache_load(const char *file_name, loudness_info *info, loudness_histogram *histogram)
+{
+    char path[1200];
+    uint64_t file_size;
+    int64_t file_mtime;
+    size_t size = 0;
+
+    if (!cache_entry_path(path, sizeof(path), LOUDNESS_CACHE_KIND, file_name, ".r128") || !cache_file_stamp(file_name, &file_size, &file_mtime))
+    {
+        return 0;
+    }
+
+    uint8_t *data = (uint8_t *)SDL_LoadFile(path, &size);
+    if (!data)
+    {
+        return 0;
+    }
+
+    loudness_cache_header header;
+    size_t path_len = strlen(file_name);
+    int ok = 0;
+
+    if (size >= sizeof(header))
+    {
+        memcpy(&header, data, sizeof(header));
+
+        ok = header.magic == LOUDNESS_CACHE_MAGIC && header.version == LOUDNESS_CACHE_VERSION && header.file_size == file_size && header.file_mtime == file_mtime && header.path_len == path_len && header.bins <= LOUDNESS_HISTOGRAM_BINS && sizeof(header) + path_len + header.bins * 2 * sizeof(uint32_t) == size && memcmp(data + sizeof(header), file_name, path_len) == 0;
+    }
+
+    if (ok && histogram)
+    {
+        const uint8_t *p = data + sizeof(header) + path_len;
+
+        memset(histogram, 0, sizeof(*histogram));
+        for (uint32_t i = 0; i < header.bins && ok; i++)
+        {
+            uint32_t pair[2];
+            memcpy(pair, p + i * sizeof(pair), sizeof(pair));
+            ok = pair[0] < LOUDNESS_HISTOGRAM_BINS;
+            if (ok)
+            {
+                histogram->bins[pair[0]] = pair[1];
+            }
+        }
+    }
+
+    if (ok)
+    {
+        info->integrated = header.integrated;
+        info->peak = header.peak;
+        info->gain = header.gain;
+        info->has_album = header.has_album;
+        info->album_gain = header.album_gain;
+        info->album_peak = header.album_peak;
+    }
+
+    SDL_free(data);
+
+    return ok;
+}
+
+int loudness_cache_store(const char *file_name, const loudness_info *info, const loudness_histogram *histogram)
+{
+    char path[1200];
+    loudness_cache_header header;
+    size_t path_len = strlen(file_name);
+
+    if (!cache_entry_path(path, sizeof(path), LOUDNESS_CACHE_KIND, file_name, ".r128"))
+    {
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    if (!cache_file_stamp(file_name, &header.file_size, &header.file_mtime))
+    {
+        return 0;
+    }
+
+    uint8_t *data = (uint8_t *)malloc(sizeof(header) + path_len + LOUDNESS_HISTOGRAM_BINS * 2 * sizeof(uint32_t));
+    if (!data)
+    {
+        return 0;
+    }
+
+    uint8_t *p = data + sizeof(header) + path_len;
+    for (uint32_t bin = 0; bin < LOUDNESS_HISTOGRAM_BINS; bin++)
+    {
+        if (histogram->bins[bin])
+        {
+            uint32_t pair[2] = {bin, histogram->bins[bin]};
+            memcpy(p, pair, sizeof(pair));
+            p += sizeof(pair);
+            header.bins++;
+        }
+    }
+
+    header.magic = LOUDNESS_CACHE_MAGIC;
+    header.version = LOUDNESS_CACHE_VERSION;
+    header.path_len = (uint32_t)path_len;
+    header.integrated = info->integrated;
+    header.peak = info->peak;
+    header.gain = info->gain;
+    header.has_album = info->has_album;
+    header.album_gain = info->album_gain;
+    header.album_peak = info->album_peak;
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), file_name, path_len);
+
+    int stored = cache_write_file(path, data, (size_t)(p - data));
+    free(data);
+
+    if (stored)
+    {
+        uint64_t total = 0;
+        cache_evict(LOUDNESS_CACHE_KIND, (uint64_t)LOUDNESS_CACHE_DEFAULT_LIMIT_KB * 1024, &total);
+    }
+
+    return stored;
+}
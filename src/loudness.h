@@ -0,0 +1,63 @@
+#pragma once
+
+#include <minimp3_ex.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// EBU R128 loudness of a track: K-weighted 400 ms blocks with 75% overlap, gated at
+// -70 LUFS and 10 LU below the ungated mean, and the true peak from 4x oversampling.
+// Block loudness is kept as a histogram, so album loudness is the merge of its tracks.
+
+// ReplayGain 2.0 reference level, gains bring tracks to this loudness
+#define LOUDNESS_REFERENCE_LUFS -18.0f
+
+// Gain is capped so the true peak stays below this
+#define LOUDNESS_PEAK_CEILING_DBTP -1.0f
+
+// Block loudness from -70 LUFS up in 0.1 LU steps
+#define LOUDNESS_HISTOGRAM_MIN_LUFS -70.0
+#define LOUDNESS_HISTOGRAM_BINS 800
+
+typedef struct loudness_histogram
+{
+    uint32_t bins[LOUDNESS_HISTOGRAM_BINS];
+} loudness_histogram;
+
+typedef struct loudness_info
+{
+    float integrated; // LUFS, -HUGE_VALF when nothing passed the gates
+    float peak;       // true peak, linear
+    float gain;       // dB to LOUDNESS_REFERENCE_LUFS
+    int has_album;
+    float album_gain;
+    float album_peak;
+} loudness_info;
+
+typedef struct loudness_meter loudness_meter;
+
+loudness_meter *loudness_meter_create(int hz, int channels);
+void loudness_meter_destroy(loudness_meter *meter);
+
+// Interleaved samples, any count
+void loudness_meter_add(loudness_meter *meter, const mp3d_sample_t *samples, size_t count);
+
+const loudness_histogram *loudness_meter_histogram(const loudness_meter *meter);
+float loudness_meter_peak(const loudness_meter *meter);
+
+// Gated loudness of the blocks in a histogram, -HUGE_VALF when none passes the gates
+float loudness_integrated(const loudness_histogram *histogram);
+
+// Linear gain for playback: gain_db, lowered where needed to keep peak below the ceiling
+float loudness_linear_gain(float gain_db, float peak);
+
+// Cached result and block histogram of file_name, validated against its size and mtime.
+// histogram may be NULL. Returns 1 on a hit.
+int loudness_cache_load(const char *file_name, loudness_info *info, loudness_histogram *histogram);
+int loudness_cache_store(const char *file_name, const loudness_info *info, const loudness_histogram *histogram);
+
+#ifdef __cplusplus
+}
+#endif
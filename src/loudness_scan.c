@@ -0,0 +1,307 @@
+#include "loudness_scan.h"
+#include "loudness.h"
+#include "stream_io.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOUDNESS_SCAN_MAX_THREADS 64
+#define LOUDNESS_SCAN_DECODE_SAMPLES 4096
+
+typedef struct loudness_album loudness_album;
+
+typedef struct loudness_task
+{
+    char *file_name;
+    char *album_key;
+    loudness_album *album;
+    loudness_info info;
+    loudness_histogram *histogram; // kept until the album gain is known
+    int ok;
+    int stale;                     // the cache entry lacks the album gain
+} loudness_task;
+
+struct loudness_album
+{
+    loudness_task **tasks;
+    int count;
+    SDL_AtomicInt remaining;
+};
+
+struct loudness_scan
+{
+    loudness_task *tasks;
+    loudness_task **by_album; // tasks sorted by album key, albums point into it
+    loudness_album *albums;
+    int count;
+    int album_count;
+
+    SDL_Thread *threads[LOUDNESS_SCAN_MAX_THREADS];
+    int thread_count;
+    SDL_AtomicInt next;      // index of the next task to take
+    SDL_AtomicInt cancel;
+    SDL_AtomicInt done;
+    SDL_AtomicInt scanned;
+    SDL_AtomicInt failed;
+    Uint64 start_ns;
+    SDL_AtomicU32 elapsed_ms; // set when the last task is done
+};
+
+static int loudness_measure(loudness_scan *scan, loudness_task *task)
+{
+    stream_io *stream = stream_io_open(task->file_name, 0);
+    mp3dec_ex_t *dec = (mp3dec_ex_t *)calloc(1, sizeof(mp3dec_ex_t));
+    mp3d_sample_t *buf = (mp3d_sample_t *)malloc(LOUDNESS_SCAN_DECODE_SAMPLES * sizeof(mp3d_sample_t));
+    loudness_meter *meter = NULL;
+    int ok = 0;
+
+    if (stream && dec && buf && !mp3dec_ex_open_cb(dec, &stream->io, MP3D_SEEK_TO_SAMPLE | MP3D_DO_NOT_SCAN))
+    {
+        meter = loudness_meter_create(dec->info.hz, dec->info.channels);
+    }
+
+    if (meter)
+    {
+        size_t decoded;
+        do
+        {
+            decoded = mp3dec_ex_read(dec, buf, LOUDNESS_SCAN_DECODE_SAMPLES);
+            loudness_meter_add(meter, buf, decoded);
+        } while (decoded == LOUDNESS_SCAN_DECODE_SAMPLES && !SDL_GetAtomicInt(&scan->cancel));
+
+        // A measurement cut short by an error would be cached for good
+        ok = !SDL_GetAtomicInt(&scan->cancel) && dec->last_error == 0 && !stream->error;
+    }
+
+    if (ok)
+    {
+        memcpy(task->histogram, loudness_meter_histogram(meter), sizeof(loudness_histogram));
+        task->info.integrated = loudness_integrated(task->histogram);
+        task->info.peak = loudness_meter_peak(meter);
+        task->info.gain = isfinite(task->info.integrated) ? LOUDNESS_REFERENCE_LUFS - task->info.integrated : 0.0f;
+        task->info.has_album = 0;
+        task->stale = task->album != NULL;
+
+        loudness_cache_store(task->file_name, &task->info, task->histogram);
+    }
+
+    loudness_meter_destroy(meter);
+    if (dec)
+    {
+        mp3dec_ex_close(dec);
+    }
+    free(dec);
+    free(buf);
+    stream_io_close(stream);
+
+    return ok;
+}
+
+// Run by the worker that finishes the last track of an album
+static void loudness_finish_album(loudness_album *album)
+{
+    loudness_histogram *merged = (loudness_histogram *)calloc(1, sizeof(loudness_histogram));
+    float peak = 0.0f;
+    int stale = 0;
+
+    for (int i = 0; i < album->count && merged; i++)
+    {
+        const loudness_task *task = album->tasks[i];
+        if (task->ok)
+        {
+            for (int bin = 0; bin < LOUDNESS_HISTOGRAM_BINS; bin++)
+            {
+                merged->bins[bin] += task->histogram->bins[bin];
+            }
+            peak = fmaxf(peak, task->info.peak);
+            stale |= task->stale;
+        }
+    }
+
+    // Cached albums that were complete before are left alone
+    if (merged && stale)
+    {
+        float integrated = loudness_integrated(merged);
+        float gain = isfinite(integrated) ? LOUDNESS_REFERENCE_LUFS - integrated : 0.0f;
+
+        for (int i = 0; i < album->count; i++)
+        {
+            loudness_task *task = album->tasks[i];
+            if (task->ok)
+            {
+                task->info.has_album = 1;
+                task->info.album_gain = gain;
+                task->info.album_peak = peak;
+                loudness_cache_store(task->file_name, &task->info, task->histogram);
+            }
+        }
+    }
+
+    for (int i = 0; i < album->count; i++)
+    {
+        free(album->tasks[i]->histogram);
+        album->tasks[i]->histogram = NULL;
+    }
+    free(merged);
+}
+
+static int SDLCALL loudness_scan_thread(void *data)
+{
+    loudness_scan *scan = (loudness_scan *)data;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    for (;;)
+    {
+        int index = SDL_AddAtomicInt(&scan->next, 1);
+        if (index >= scan->count || SDL_GetAtomicInt(&scan->cancel))
+        {
+            break;
+        }
+
+        loudness_task *task = &scan->tasks[index];
+        task->histogram = (loudness_histogram *)malloc(sizeof(loudness_histogram));
+
+        if (task->histogram && loudness_cache_load(task->file_name, &task->info, task->histogram))
+        {
+            task->ok = 1;
+            task->stale = task->album && !task->info.has_album;
+        }
+        else if (task->histogram && loudness_measure(scan, task))
+        {
+            task->ok = 1;
+            SDL_AddAtomicInt(&scan->scanned, 1);
+        }
+        else
+        {
+            SDL_AddAtomicInt(&scan->failed, 1);
+        }
+
+        if (!task->album)
+        {
+            free(task->histogram);
+            task->histogram = NULL;
+        }
+        else if (SDL_AddAtomicInt(&task->album->remaining, -1) == 1 && !SDL_GetAtomicInt(&scan->cancel))
+        {
+            loudness_finish_album(task->album);
+        }
+
+        if (SDL_AddAtomicInt(&scan->done, 1) + 1 == scan->count)
+        {
+            SDL_SetAtomicU32(&scan->elapsed_ms, (Uint32)SDL_max((SDL_GetTicksNS() - scan->start_ns) / 1000000, 1));
+        }
+    }
+
+    return 0;
+}
+
+static int compare_album_keys(const void *a, const void *b)
+{
+    const loudness_task *ta = *(const loudness_task *const *)a;
+    const loudness_task *tb = *(const loudness_task *const *)b;
+
+    return strcmp(ta->album_key, tb->album_key);
+}
+
+loudness_scan *loudness_scan_start(const char *const *file_names, const char *const *albums, int count)
+{
+    loudness_scan *scan = (loudness_scan *)calloc(1, sizeof(loudness_scan));
+    if (!scan)
+    {
+        return NULL;
+    }
+
+    scan->count = count;
+    scan->tasks = (loudness_task *)calloc(SDL_max(count, 1), sizeof(loudness_task));
+    scan->by_album = (loudness_task **)calloc(SDL_max(count, 1), sizeof(loudness_task *));
+    scan->albums = (loudness_album *)calloc(SDL_max(count, 1), sizeof(loudness_album));
+    if (!scan->tasks || !scan->by_album || !scan->albums)
+    {
+        loudness_scan_free(scan);
+        return NULL;
+    }
+
+    // Tracks of an album sit next to each other once sorted by key
+    int grouped = 0;
+    for (int i = 0; i < count; i++)
+    {
+        loudness_task *task = &scan->tasks[i];
+        task->file_name = SDL_strdup(file_names[i]);
+        task->album_key = albums && albums[i] ? SDL_strdup(albums[i]) : NULL;
+        if (task->album_key)
+        {
+            scan->by_album[grouped++] = task;
+        }
+    }
+    qsort(scan->by_album, grouped, sizeof(loudness_task *), compare_album_keys);
+
+    for (int i = 0; i < grouped;)
+    {
+        loudness_album *album = &scan->albums[scan->album_count++];
+        album->tasks = &scan->by_album[i];
+        while (i + album->count < grouped && strcmp(album->tasks[0]->album_key, album->tasks[album->count]->album_key) == 0)
+        {
+            album->tasks[album->count++]->album = album;
+        }
+        SDL_SetAtomicInt(&album->remaining, album->count);
+        i += album->count;
+    }
+
+    scan->start_ns = SDL_GetTicksNS();
+
+    int threads = SDL_min(SDL_min(SDL_GetNumLogicalCPUCores(), count), LOUDNESS_SCAN_MAX_THREADS);
+    for (int i = 0; i < threads; i++)
+    {
+        scan->threads[scan->thread_count] = SDL_CreateThread(loudness_scan_thread, "plyr loudness", scan);
+        if (scan->threads[scan->thread_count])
+        {
+            scan->thread_count++;
+        }
+    }
+
+    return scan;
+}
+
+void loudness_scan_free(loudness_scan *scan)
+{
+    if (!scan)
+    {
+        return;
+    }
+
+    SDL_SetAtomicInt(&scan->cancel, 1);
+    for (int i = 0; i < scan->thread_count; i++)
+    {
+        SDL_WaitThread(scan->threads[i], NULL);
+    }
+
+    for (int i = 0; scan->tasks && i < scan->count; i++)
+    {
+        SDL_free(scan->tasks[i].file_name);
+        SDL_free(scan->tasks[i].album_key);
+        free(scan->tasks[i].histogram);
+    }
+
+    free(scan->tasks);
+    free(scan->by_album);
+    free(scan->albums);
+    free(scan);
+}
+
+void loudness_scan_get_stats(loudness_scan *scan, loudness_scan_stats *stats)
+{
+    stats->total = scan->count;
+    stats->done = SDL_GetAtomicInt(&scan->done);
+    stats->scanned = SDL_GetAtomicInt(&scan->scanned);
+    stats->failed = SDL_GetAtomicInt(&scan->failed);
+
+    Uint32 elapsed_ms = SDL_GetAtomicU32(&scan->elapsed_ms);
+    if (!elapsed_ms)
+    {
+        elapsed_ms = (Uint32)SDL_max((SDL_GetTicksNS() - scan->start_ns) / 1000000, 1);
+    }
+    stats->tracks_per_second = stats->done * 1000.0f / elapsed_ms;
+}
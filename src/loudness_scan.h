@@ -0,0 +1,33 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Loudness analysis of a list of tracks on every core. Each worker takes the next
+// track, loads it from the loudness cache or decodes and measures it, and stores the
+// result. Tracks that share an album key also get the album gain once the last of
+// them is done.
+typedef struct loudness_scan loudness_scan;
+
+typedef struct loudness_scan_stats
+{
+    int total;
+    int done;               // cached, scanned or failed
+    int scanned;            // decoded and measured
+    int failed;
+    float tracks_per_second; // done tracks over the time the scan has been running
+} loudness_scan_stats;
+
+// albums may be NULL, as may any of its entries for tracks that belong to no album.
+// Returns NULL when out of memory.
+loudness_scan *loudness_scan_start(const char *const *file_names, const char *const *albums, int count);
+
+// Cancels what is still running and waits for the workers
+void loudness_scan_free(loudness_scan *scan);
+
+void loudness_scan_get_stats(loudness_scan *scan, loudness_scan_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+#include "meters.h"
+#include "dsp_kernels.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+
+#define METERS_SQRT_HALF 0.70710678118f
+
+static float meters_db(float amplitude)
+{
+    return amplitude > 0.0f ? SDL_max(20.0f * log10f(amplitude), METERS_FLOOR_DB) : METERS_FLOOR_DB;
+}
+
+void meters_reset(meters *m)
+{
+    SDL_zerop(m);
+    m->hold_db[0] = m->hold_db[1] = METERS_FLOOR_DB;
+}
+
+void meters_process(meters *m, const float *samples, int frames, int channels, int hz, meter_levels *out)
+{
+    if (frames <= 0 || hz <= 0)
+    {
+        return;
+    }
+
+    dsp_stereo_sums sums;
+    if (channels == 2)
+    {
+        dsp_stereo_measure(samples, frames, &sums);
+    }
+    else
+    {
+        // Mono samples measured two at a time, then both halves merged into either channel
+        dsp_stereo_measure(samples, frames / 2, &sums);
+        float last = frames % 2 ? samples[frames - 1] : 0.0f;
+        float peak = SDL_max(SDL_max(sums.peak[0], sums.peak[1]), fabsf(last));
+        float square = sums.square[0] + sums.square[1] + last * last;
+        sums.peak[0] = sums.peak[1] = peak;
+        sums.square[0] = sums.square[1] = sums.product = square;
+    }
+
+    float block_ms = 1000.0f * frames / hz;
+    float keep = expf(-block_ms / METERS_RMS_MS);
+
+    for (int c = 0; c < 2; c++)
+    {
+        m->square[c] = keep * m->square[c] + (1.0f - keep) * sums.square[c] / frames;
+
+        float peak_db = meters_db(sums.peak[c]);
+        if (peak_db >= m->hold_db[c])
+        {
+            m->hold_db[c] = peak_db;
+            m->hold_ms[c] = METERS_HOLD_MS;
+        }
+        else if ((m->hold_ms[c] -= block_ms) < 0.0f)
+        {
+            m->hold_db[c] = SDL_max(m->hold_db[c] - METERS_FALL_DB_PER_S * block_ms / 1000.0f, peak_db);
+        }
+
+        out->peak_db[c] = peak_db;
+        out->hold_db[c] = m->hold_db[c];
+        out->rms_db[c] = m->square[c] > 0.0f ? SDL_max(10.0f * log10f(m->square[c]), METERS_FLOOR_DB) : METERS_FLOOR_DB;
+    }
+
+    m->product = keep * m->product + (1.0f - keep) * sums.product / frames;
+    float power = sqrtf(m->square[0] * m->square[1]);
+    out->correlation = power > 1e-10f ? SDL_clamp(m->product / power, -1.0f, 1.0f) : 0.0f;
+
+    // Frames picked evenly over the block
+    out->scope_points = SDL_min(frames, METERS_SCOPE_POINTS);
+    for (int i = 0; i < out->scope_points; i++)
+    {
+        const float *frame = samples + (int)((int64_t)i * frames / out->scope_points) * channels;
+        float left = frame[0];
+        float right = channels == 2 ? frame[1] : left;
+        out->scope[i][0] = (right - left) * METERS_SQRT_HALF;
+        out->scope[i][1] = (left + right) * METERS_SQRT_HALF;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stereo level meters and vectorscope for the visualizer. Measured on the decode thread over
+// the processed blocks, the results travel with the block's spectrum frame, so the UI shows
+// them as the block is heard and never reads samples itself.
+#define METERS_SCOPE_POINTS 256
+#define METERS_FLOOR_DB -90.0f
+#define METERS_RMS_MS 300      // integration time of RMS and correlation
+#define METERS_HOLD_MS 1500    // peak hold stays this long before it falls
+#define METERS_FALL_DB_PER_S 20.0f
+
+typedef struct meter_levels
+{
+    float peak_db[2];   // largest sample of the block, dBFS
+    float hold_db[2];   // highest recent peak
+    float rms_db[2];    // a full scale sine reads -3 dBFS
+    float correlation;  // 1 mono, 0 unrelated or silent, -1 out of phase
+    int scope_points;
+    float scope[METERS_SCOPE_POINTS][2]; // side and mid, right of center is the right channel
+} meter_levels;
+
+// Running state between blocks
+typedef struct meters
+{
+    float square[2]; // mean squares, integrated
+    float product;
+    float hold_db[2];
+    float hold_ms[2]; // left before the hold falls
+} meters;
+
+// Forgets the levels so far, after a seek or a new track
+void meters_reset(meters *m);
+
+// Measures a block of frames interleaved mono or stereo float at hz
+void meters_process(meters *m, const float *samples, int frames, int channels, int hz, meter_levels *out);
+
+#ifdef __cplusplus
+}
+#endif
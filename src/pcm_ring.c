@@ -0,0 +1,59 @@
+#include "pcm_ring.h"
+
+#define PCM_RING_MASK (PCM_RING_BLOCKS - 1)
+
+// Only safe while neither side is running (see audio_flush)
+void pcm_ring_reset(pcm_ring *ring)
+{
+    SDL_SetAtomicInt(&ring->head, 0);
+    SDL_SetAtomicInt(&ring->tail, 0);
+}
+
+int pcm_ring_count(pcm_ring *ring)
+{
+    unsigned int head = (unsigned int)SDL_GetAtomicInt(&ring->head);
+    unsigned int tail = (unsigned int)SDL_GetAtomicInt(&ring->tail);
+
+    return (int)(head - tail);
+}
+
+pcm_block *pcm_ring_write_begin(pcm_ring *ring)
+{
+    unsigned int head = (unsigned int)SDL_GetAtomicInt(&ring->head);
+    unsigned int tail = (unsigned int)SDL_GetAtomicInt(&ring->tail);
+
+    if (head - tail >= PCM_RING_BLOCKS)
+    {
+        return NULL;
+    }
+
+    return &ring->blocks[head & PCM_RING_MASK];
+}
+
+void pcm_ring_write_commit(pcm_ring *ring)
+{
+    // Publish the block contents before the new head becomes visible
+    SDL_MemoryBarrierRelease();
+    SDL_AddAtomicInt(&ring->head, 1);
+}
+
+pcm_block *pcm_ring_read_begin(pcm_ring *ring)
+{
+    unsigned int tail = (unsigned int)SDL_GetAtomicInt(&ring->tail);
+    unsigned int head = (unsigned int)SDL_GetAtomicInt(&ring->head);
+
+    if (head == tail)
+    {
+        return NULL;
+    }
+
+    SDL_MemoryBarrierAcquire();
+
+    return &ring->blocks[tail & PCM_RING_MASK];
+}
+
+void pcm_ring_read_commit(pcm_ring *ring)
+{
+    SDL_MemoryBarrierRelease();
+    SDL_AddAtomicInt(&ring->tail, 1);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "decode.h"
+
+#include <SDL3/SDL.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of blocks in the ring, must be a power of two. Bounds the largest
+// buffer target the audio layer can adapt to (~1.5s of 44.1kHz stereo)
+#define PCM_RING_BLOCKS 32
+
+// Interleaved samples per block (2048 stereo frames, ~46ms at 44.1kHz)
+#define PCM_BLOCK_SAMPLES 4096
+
+typedef struct pcm_block
+{
+    int samples;  // valid interleaved samples in data
+    int hz;       // format of the samples, so format changes travel in-band
+    int channels;
+    int serial;        // track the block belongs to, see play_clock
+    uint64_t position; // first sample of the block within that track
+    mp3d_sample_t data[PCM_BLOCK_SAMPLES];
+} pcm_block;
+
+// Single-producer/single-consumer ring of preallocated PCM blocks.
+// The decode thread is the only writer and the SDL stream callback the only
+// reader; head and tail are free-running counters so no slot is wasted.
+typedef struct pcm_ring
+{
+    pcm_block blocks[PCM_RING_BLOCKS];
+    SDL_AtomicInt head; // blocks committed by the producer
+    SDL_AtomicInt tail; // blocks released by the consumer
+} pcm_ring;
+
+void pcm_ring_reset(pcm_ring *ring);
+int pcm_ring_count(pcm_ring *ring);
+
+// Producer side: returns NULL when the ring is full
+pcm_block *pcm_ring_write_begin(pcm_ring *ring);
+void pcm_ring_write_commit(pcm_ring *ring);
+
+// Consumer side: returns NULL when the ring is empty
+pcm_block *pcm_ring_read_begin(pcm_ring *ring);
+void pcm_ring_read_commit(pcm_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
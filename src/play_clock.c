@@ -0,0 +1,133 @@
+#include "play_clock.h"
+
+static void publish(play_clock *clock, int serial, uint64_t position, uint64_t limit, int rate)
+{
+    SDL_AddAtomicInt(&clock->seq, 1);
+    SDL_MemoryBarrierRelease();
+
+    clock->state.serial = serial;
+    clock->state.position = position;
+    clock->state.limit = limit;
+    clock->state.rate = rate;
+    clock->state.stamp_ns = SDL_GetTicksNS();
+
+    SDL_MemoryBarrierRelease();
+    SDL_AddAtomicInt(&clock->seq, 1);
+}
+
+void play_clock_init(play_clock *clock, int device_hz, int device_frames)
+{
+    SDL_zerop(clock);
+    clock->device_hz = device_hz;
+    clock->device_frames = device_frames;
+    clock->prev_serial = -1;
+}
+
+void play_clock_reset(play_clock *clock, int serial, uint64_t position, int rate)
+{
+    clock->serial = serial;
+    clock->start = clock->end = position;
+    clock->rate = rate;
+    clock->prev_serial = -1;
+
+    // Frozen at the new position until the first block is handed over
+    publish(clock, serial, position, position, 0);
+}
+
+void play_clock_put(play_clock *clock, int serial, uint64_t position, int samples, int rate)
+{
+    if (serial != clock->serial)
+    {
+        // Gapless splice, the end of the previous track is still queued
+        clock->prev_serial = clock->serial;
+        clock->prev_end = clock->end;
+        clock->prev_rate = clock->rate;
+        clock->serial = serial;
+        clock->start = clock->end = position;
+    }
+    else if (position != clock->end)
+    {
+        clock->start = clock->end = position;
+    }
+
+    clock->end += samples;
+    clock->rate = rate;
+    clock->fed = 1;
+}
+
+void play_clock_update(play_clock *clock, int queued_frames)
+{
+    // Once the stream has run dry the device buffer plays out, the interpolation covers that
+    int fed = clock->fed;
+    clock->fed = 0;
+    if (!clock->rate || !clock->device_hz || (!fed && !queued_frames))
+    {
+        return;
+    }
+
+    // Stream and device buffer run at the device rate, converted to samples of the source
+    uint64_t behind = (uint64_t)(queued_frames + clock->device_frames) * clock->rate / clock->device_hz;
+    uint64_t queued = clock->end - clock->start;
+
+    if (behind <= queued)
+    {
+        publish(clock, clock->serial, clock->end - behind, clock->end, clock->rate);
+    }
+    else if (clock->prev_serial >= 0)
+    {
+        uint64_t prev_behind = behind - queued;
+        publish(clock, clock->prev_serial, clock->prev_end > prev_behind ? clock->prev_end - prev_behind : 0, clock->prev_end, clock->prev_rate);
+    }
+    else
+    {
+        publish(clock, clock->serial, clock->start, clock->end, clock->rate);
+    }
+}
+
+void play_clock_pause(play_clock *clock, int paused)
+{
+    play_clock_state state = clock->state;
+
+    if (paused)
+    {
+        publish(clock, state.serial, play_clock_position(&state, SDL_GetTicksNS()), state.limit, 0);
+    }
+    else
+    {
+        // Runs from where it stopped, the next update corrects it
+        publish(clock, state.serial, state.position, state.limit, clock->serial == state.serial ? clock->rate : clock->prev_rate);
+    }
+}
+
+void play_clock_get(play_clock *clock, play_clock_state *state)
+{
+    for (;;)
+    {
+        int seq = SDL_GetAtomicInt(&clock->seq);
+        if (seq & 1)
+        {
+            SDL_CPUPauseInstruction();
+            continue;
+        }
+
+        SDL_MemoryBarrierAcquire();
+        *state = clock->state;
+        SDL_MemoryBarrierAcquire();
+
+        if (SDL_GetAtomicInt(&clock->seq) == seq)
+        {
+            return;
+        }
+    }
+}
+
+uint64_t play_clock_position(const play_clock_state *state, Uint64 now_ns)
+{
+    if (!state->rate || now_ns <= state->stamp_ns)
+    {
+        return state->position;
+    }
+
+    uint64_t position = state->position + (now_ns - state->stamp_ns) * (uint64_t)state->rate / 1000000000u;
+    return position < state->limit ? position : state->limit;
+}
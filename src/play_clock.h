@@ -0,0 +1,65 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Audible playback position. The stream callback reports every block it hands to
+// SDL together with what is still queued in the stream and the device buffer; the
+// position heard right now is interpolated from the latest of those reports.
+//
+// Writers are the stream callback and the decode thread holding the stream lock,
+// readers on any thread get a consistent copy of the published state.
+
+typedef struct play_clock_state
+{
+    int serial;       // track the audible samples belong to
+    uint64_t position; // audible sample (channels included) at stamp_ns
+    uint64_t limit;    // last sample of that track handed to SDL, the clock stops there
+    int rate;          // samples per second (channels included), 0 while paused
+    Uint64 stamp_ns;
+} play_clock_state;
+
+typedef struct play_clock
+{
+    // Segment bookkeeping, owned by the writer
+    int serial;
+    uint64_t start;    // first sample of the current segment handed to SDL
+    uint64_t end;      // one past the last sample handed to SDL
+    int rate;
+    int prev_serial;   // track before a gapless splice, -1 when nothing of it is queued
+    uint64_t prev_end;
+    int prev_rate;
+    int device_frames; // device buffer, played out after the stream
+    int device_hz;
+    int fed;           // blocks were put since the last update
+
+    SDL_AtomicInt seq; // seqlock, odd while state is being written
+    play_clock_state state;
+} play_clock;
+
+void play_clock_init(play_clock *clock, int device_hz, int device_frames);
+
+// Playback restarts at position, as after opening or seeking: nothing queued before counts
+void play_clock_reset(play_clock *clock, int serial, uint64_t position, int rate);
+
+// A block of samples starting at position was handed to SDL
+void play_clock_put(play_clock *clock, int serial, uint64_t position, int samples, int rate);
+
+// Publishes the audible position given what is still queued in the stream, in device frames
+void play_clock_update(play_clock *clock, int queued_frames);
+
+// Freezes the clock while the device is paused and lets it run again on resume
+void play_clock_pause(play_clock *clock, int paused);
+
+void play_clock_get(play_clock *clock, play_clock_state *state);
+
+// Position heard at now_ns, interpolated from the state
+uint64_t play_clock_position(const play_clock_state *state, Uint64 now_ns);
+
+#ifdef __cplusplus
+}
+#endif
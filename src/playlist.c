@@ -0,0 +1,596 @@
+#include "playlist.h"
+
+#include "cache.h"
+
+#include <SDL3/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLAYLIST_MIN_BITS 8                // of the path table
+#define PLAYLIST_COMPACT_BYTES (1 << 20)   // of unused strings before they are worth reclaiming
+
+// A path and its label, shared by the entries that list it
+typedef struct playlist_record
+{
+    uint32_t text;  // offsets into the strings
+    uint32_t label; // PLAYLIST_NONE until set, may point into text
+    uint32_t hash;  // of text, the next free record once refs is 0
+    uint32_t refs;  // entries listing it
+} playlist_record;
+
+struct playlist
+{
+    uint32_t *order; // entry ids by position
+    int count;
+    size_t order_capacity;
+
+    uint32_t *record_of; // record of every id, PLAYLIST_NONE once removed
+    uint32_t id_count;
+    size_t id_capacity;
+
+    playlist_record *records;
+    uint32_t record_count;
+    size_t record_capacity;
+    uint32_t free_record; // PLAYLIST_NONE when there is none
+
+    uint32_t *slots; // record + 1 by hash, 0 for a free slot
+    uint32_t bits;
+    uint32_t used;
+
+    char *strings;
+    size_t string_size;
+    size_t string_capacity;
+    size_t unused; // bytes of released paths and replaced labels
+
+    uint32_t serial;
+};
+
+/* ============================================================
+   Storage
+   ============================================================ */
+
+// Returns the array with room for needed items, or NULL when out of memory
+static void *playlist_grow(void *data, size_t *capacity, size_t needed, size_t item_size)
+{
+    if (needed <= *capacity)
+    {
+        return data;
+    }
+
+    size_t grown = SDL_max(SDL_max(*capacity * 2, needed), 256);
+    void *moved = realloc(data, grown * item_size);
+    if (moved)
+    {
+        *capacity = grown;
+    }
+    return moved;
+}
+
+static int playlist_rehash(playlist *pl, uint32_t bits)
+{
+    uint32_t *slots = (uint32_t *)calloc((size_t)1 << bits, sizeof(uint32_t));
+    if (!slots)
+    {
+        return 0;
+    }
+
+    uint32_t mask = (1u << bits) - 1;
+    for (uint32_t i = 0; pl->slots && i < (1u << pl->bits); i++)
+    {
+        if (pl->slots[i])
+        {
+            uint32_t at = pl->records[pl->slots[i] - 1].hash & mask;
+            while (slots[at])
+            {
+                at = (at + 1) & mask;
+            }
+            slots[at] = pl->slots[i];
+        }
+    }
+    free(pl->slots);
+    pl->slots = slots;
+    pl->bits = bits;
+    return 1;
+}
+
+// Makes room for count more entries
+static int playlist_reserve(playlist *pl, size_t count)
+{
+    if (pl->count + count > INT32_MAX || pl->id_count + count >= PLAYLIST_NONE)
+    {
+        return 0;
+    }
+
+    uint32_t *order = (uint32_t *)playlist_grow(pl->order, &pl->order_capacity, pl->count + count, sizeof(uint32_t));
+    if (!order)
+    {
+        return 0;
+    }
+    pl->order = order;
+
+    uint32_t *record_of = (uint32_t *)playlist_grow(pl->record_of, &pl->id_capacity, pl->id_count + count, sizeof(uint32_t));
+    if (!record_of)
+    {
+        return 0;
+    }
+    pl->record_of = record_of;
+    return 1;
+}
+
+static int playlist_reserve_bytes(playlist *pl, size_t bytes)
+{
+    if (pl->string_size + bytes > UINT32_MAX)
+    {
+        return 0;
+    }
+
+    char *strings = (char *)playlist_grow(pl->strings, &pl->string_capacity, pl->string_size + bytes, 1);
+    if (!strings)
+    {
+        return 0;
+    }
+    pl->strings = strings;
+    return 1;
+}
+
+static size_t playlist_text_length(const playlist *pl, const playlist_record *record)
+{
+    return strlen(pl->strings + record->text);
+}
+
+// Labels that are the file name point into the path instead of taking bytes of their own
+static int playlist_label_apart(const playlist_record *record, size_t text_length)
+{
+    return record->label != PLAYLIST_NONE && (record->label < record->text || record->label > record->text + text_length);
+}
+
+// Rewrites the strings without the unused ones once they take a good part of them
+static void playlist_compact(playlist *pl)
+{
+    if (pl->unused < PLAYLIST_COMPACT_BYTES || pl->unused < pl->string_size / 2)
+    {
+        return;
+    }
+
+    size_t capacity = pl->string_size - pl->unused;
+    char *strings = (char *)malloc(SDL_max(capacity, 1));
+    if (!strings)
+    {
+        return;
+    }
+
+    size_t size = 0;
+    for (uint32_t i = 0; i < pl->record_count; i++)
+    {
+        playlist_record *record = &pl->records[i];
+        if (record->refs == 0)
+        {
+            continue;
+        }
+
+        size_t length = playlist_text_length(pl, record);
+        int apart = playlist_label_apart(record, length);
+        memcpy(strings + size, pl->strings + record->text, length + 1);
+        if (record->label != PLAYLIST_NONE && !apart)
+        {
+            record->label = (uint32_t)size + (record->label - record->text);
+        }
+        record->text = (uint32_t)size;
+        size += length + 1;
+
+        if (apart)
+        {
+            size_t label_length = strlen(pl->strings + record->label) + 1;
+            memcpy(strings + size, pl->strings + record->label, label_length);
+            record->label = (uint32_t)size;
+            size += label_length;
+        }
+    }
+
+    free(pl->strings);
+    pl->strings = strings;
+    pl->string_size = size;
+    pl->string_capacity = capacity;
+    pl->unused = 0;
+}
+
+/* ============================================================
+   Paths
+   ============================================================ */
+
+static uint32_t playlist_hash(const char *path)
+{
+    uint64_t hash = cache_hash(path);
+    return (uint32_t)(hash ^ hash >> 32);
+}
+
+static uint32_t *playlist_slot_of(const playlist *pl, const char *path, uint32_t hash)
+{
+    uint32_t mask = (1u << pl->bits) - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        uint32_t record = pl->slots[i];
+        if (record == 0 || (pl->records[record - 1].hash == hash && strcmp(pl->strings + pl->records[record - 1].text, path) == 0))
+        {
+            return &pl->slots[i];
+        }
+    }
+}
+
+// Record of path with a reference more, PLAYLIST_NONE when out of memory
+static uint32_t playlist_intern(playlist *pl, const char *path)
+{
+    if (!pl->slots && !playlist_rehash(pl, PLAYLIST_MIN_BITS))
+    {
+        return PLAYLIST_NONE;
+    }
+
+    uint32_t hash = playlist_hash(path);
+    uint32_t *slot = playlist_slot_of(pl, path, hash);
+    if (*slot)
+    {
+        pl->records[*slot - 1].refs++;
+        return *slot - 1;
+    }
+
+    // Kept at most half full
+    if ((pl->used + 1) * 2 > (1u << pl->bits))
+    {
+        if (pl->bits == 31 || !playlist_rehash(pl, pl->bits + 1))
+        {
+            return PLAYLIST_NONE;
+        }
+        slot = playlist_slot_of(pl, path, hash);
+    }
+
+    uint32_t index = pl->free_record;
+    if (index == PLAYLIST_NONE)
+    {
+        playlist_record *records = (playlist_record *)playlist_grow(pl->records, &pl->record_capacity, pl->record_count + 1, sizeof(playlist_record));
+        if (!records)
+        {
+            return PLAYLIST_NONE;
+        }
+        pl->records = records;
+    }
+
+    size_t length = strlen(path) + 1;
+    if (!playlist_reserve_bytes(pl, length))
+    {
+        return PLAYLIST_NONE;
+    }
+
+    if (index != PLAYLIST_NONE)
+    {
+        pl->free_record = pl->records[index].hash;
+    }
+    else
+    {
+        index = pl->record_count++;
+    }
+    memcpy(pl->strings + pl->string_size, path, length);
+
+    playlist_record *record = &pl->records[index];
+    record->text = (uint32_t)pl->string_size;
+    record->label = PLAYLIST_NONE;
+    record->hash = hash;
+    record->refs = 1;
+    pl->string_size += length;
+
+    *slot = index + 1;
+    pl->used++;
+    return index;
+}
+
+static void playlist_release(playlist *pl, uint32_t index)
+{
+    playlist_record *record = &pl->records[index];
+    if (--record->refs > 0)
+    {
+        return;
+    }
+
+    size_t length = playlist_text_length(pl, record);
+    pl->unused += length + 1;
+    if (playlist_label_apart(record, length))
+    {
+        pl->unused += strlen(pl->strings + record->label) + 1;
+    }
+
+    // Later slots of the same run move up into the gap, so lookups never stop early
+    uint32_t mask = (1u << pl->bits) - 1;
+    uint32_t gap = record->hash & mask;
+    while (pl->slots[gap] != index + 1)
+    {
+        gap = (gap + 1) & mask;
+    }
+    for (uint32_t i = (gap + 1) & mask; pl->slots[i]; i = (i + 1) & mask)
+    {
+        uint32_t home = pl->records[pl->slots[i] - 1].hash & mask;
+        if (((i - home) & mask) >= ((i - gap) & mask))
+        {
+            pl->slots[gap] = pl->slots[i];
+            gap = i;
+        }
+    }
+    pl->slots[gap] = 0;
+    pl->used--;
+
+    record->hash = pl->free_record;
+    pl->free_record = index;
+}
+
+static const playlist_record *playlist_record_of(const playlist *pl, uint32_t id)
+{
+    if (id >= pl->id_count || pl->record_of[id] == PLAYLIST_NONE)
+    {
+        return NULL;
+    }
+    return &pl->records[pl->record_of[id]];
+}
+
+/* ============================================================
+   Entries
+   ============================================================ */
+
+playlist *playlist_create(void)
+{
+    playlist *pl = (playlist *)calloc(1, sizeof(playlist));
+    if (pl)
+    {
+        pl->free_record = PLAYLIST_NONE;
+    }
+    return pl;
+}
+
+void playlist_free(playlist *pl)
+{
+    if (!pl)
+    {
+        return;
+    }
+
+    free(pl->order);
+    free(pl->record_of);
+    free(pl->records);
+    free(pl->slots);
+    free(pl->strings);
+    free(pl);
+}
+
+int playlist_count(const playlist *pl)
+{
+    return pl->count;
+}
+
+uint32_t playlist_id_at(const playlist *pl, int index)
+{
+    return index >= 0 && index < pl->count ? pl->order[index] : PLAYLIST_NONE;
+}
+
+int playlist_index_of(const playlist *pl, uint32_t id)
+{
+    if (!playlist_record_of(pl, id))
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < pl->count; i++)
+    {
+        if (pl->order[i] == id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *playlist_path(const playlist *pl, uint32_t id)
+{
+    const playlist_record *record = playlist_record_of(pl, id);
+    return record ? pl->strings + record->text : NULL;
+}
+
+const char *playlist_label(const playlist *pl, uint32_t id)
+{
+    const playlist_record *record = playlist_record_of(pl, id);
+    return record && record->label != PLAYLIST_NONE ? pl->strings + record->label : NULL;
+}
+
+int playlist_set_label(playlist *pl, uint32_t id, const char *label)
+{
+    if (!playlist_record_of(pl, id))
+    {
+        return 0;
+    }
+
+    playlist_record *record = &pl->records[pl->record_of[id]];
+    const char *text = pl->strings + record->text;
+    size_t length = strlen(text);
+    size_t label_length = strlen(label);
+    int apart = playlist_label_apart(record, length);
+
+    // The file name, or any other tail after a separator
+    if (label_length <= length && strcmp(text + length - label_length, label) == 0 &&
+        (label_length == length || text[length - label_length - 1] == '/' || text[length - label_length - 1] == '\\'))
+    {
+        if (apart)
+        {
+            pl->unused += strlen(pl->strings + record->label) + 1;
+        }
+        record->label = record->text + (uint32_t)(length - label_length);
+        playlist_compact(pl);
+        return 1;
+    }
+
+    if (apart && strcmp(pl->strings + record->label, label) == 0)
+    {
+        return 1;
+    }
+
+    if (!playlist_reserve_bytes(pl, label_length + 1))
+    {
+        return 0;
+    }
+    if (apart)
+    {
+        pl->unused += strlen(pl->strings + record->label) + 1;
+    }
+    memcpy(pl->strings + pl->string_size, label, label_length + 1);
+    record->label = (uint32_t)pl->string_size;
+    pl->string_size += label_length + 1;
+    playlist_compact(pl);
+    return 1;
+}
+
+void playlist_forget_labels(playlist *pl)
+{
+    for (uint32_t i = 0; i < pl->record_count; i++)
+    {
+        playlist_record *record = &pl->records[i];
+        if (record->refs == 0)
+        {
+            continue;
+        }
+
+        if (playlist_label_apart(record, playlist_text_length(pl, record)))
+        {
+            pl->unused += strlen(pl->strings + record->label) + 1;
+        }
+        record->label = PLAYLIST_NONE;
+    }
+    playlist_compact(pl);
+}
+
+int playlist_insert(playlist *pl, int index, const char *const *paths, int count)
+{
+    if (count <= 0)
+    {
+        return 1;
+    }
+    if (!playlist_reserve(pl, count))
+    {
+        return 0;
+    }
+
+    index = SDL_clamp(index, 0, pl->count);
+    memmove(pl->order + index + count, pl->order + index, (size_t)(pl->count - index) * sizeof(uint32_t));
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t record = playlist_intern(pl, paths[i]);
+        if (record == PLAYLIST_NONE)
+        {
+            // The ids of the paths taken so far were never handed out
+            while (i-- > 0)
+            {
+                playlist_release(pl, pl->record_of[--pl->id_count]);
+            }
+            memmove(pl->order + index, pl->order + index + count, (size_t)(pl->count - index) * sizeof(uint32_t));
+            return 0;
+        }
+        pl->record_of[pl->id_count] = record;
+        pl->order[index + i] = pl->id_count++;
+    }
+    pl->count += count;
+    pl->serial++;
+    return 1;
+}
+
+int playlist_copy(playlist *pl, int from, int count, int index)
+{
+    from = SDL_clamp(from, 0, pl->count);
+    count = SDL_min(count, pl->count - from);
+    if (count <= 0)
+    {
+        return 1;
+    }
+    if (!playlist_reserve(pl, count))
+    {
+        return 0;
+    }
+
+    index = SDL_clamp(index, 0, pl->count);
+    memmove(pl->order + index + count, pl->order + index, (size_t)(pl->count - index) * sizeof(uint32_t));
+    for (int i = 0; i < count; i++)
+    {
+        // Entries behind the gap moved along with it
+        int source = from + i >= index ? from + i + count : from + i;
+        uint32_t record = pl->record_of[pl->order[source]];
+        pl->records[record].refs++;
+        pl->record_of[pl->id_count] = record;
+        pl->order[index + i] = pl->id_count++;
+    }
+    pl->count += count;
+    pl->serial++;
+    return 1;
+}
+
+void playlist_remove(playlist *pl, int index, int count)
+{
+    index = SDL_clamp(index, 0, pl->count);
+    count = SDL_min(count, pl->count - index);
+    if (count <= 0)
+    {
+        return;
+    }
+
+    for (int i = index; i < index + count; i++)
+    {
+        uint32_t id = pl->order[i];
+        playlist_release(pl, pl->record_of[id]);
+        pl->record_of[id] = PLAYLIST_NONE;
+    }
+    memmove(pl->order + index, pl->order + index + count, (size_t)(pl->count - index - count) * sizeof(uint32_t));
+    pl->count -= count;
+    pl->serial++;
+    playlist_compact(pl);
+}
+
+static void playlist_reverse(uint32_t *ids, int count)
+{
+    for (int i = 0, j = count - 1; i < j; i++, j--)
+    {
+        uint32_t id = ids[i];
+        ids[i] = ids[j];
+        ids[j] = id;
+    }
+}
+
+// Turns ids so that the one at first comes first, in place
+static void playlist_rotate(uint32_t *ids, int count, int first)
+{
+    playlist_reverse(ids, first);
+    playlist_reverse(ids + first, count - first);
+    playlist_reverse(ids, count);
+}
+
+void playlist_move(playlist *pl, int from, int count, int to)
+{
+    from = SDL_clamp(from, 0, pl->count);
+    count = SDL_min(count, pl->count - from);
+    to = SDL_clamp(to, 0, pl->count - count);
+    if (count <= 0 || to == from)
+    {
+        return;
+    }
+
+    if (to < from)
+    {
+        playlist_rotate(pl->order + to, from + count - to, from - to);
+    }
+    else
+    {
+        playlist_rotate(pl->order + from, to + count - from, count);
+    }
+}
+
+uint32_t playlist_serial(const playlist *pl)
+{
+    return pl->serial;
+}
+
+size_t playlist_memory(const playlist *pl)
+{
+    return sizeof(playlist) + pl->order_capacity * sizeof(uint32_t) + pl->id_capacity * sizeof(uint32_t) +
+           pl->record_capacity * sizeof(playlist_record) + (pl->slots ? ((size_t)1 << pl->bits) * sizeof(uint32_t) : 0) + pl->string_capacity;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Ordered list of tracks. Every entry has an id that stays with it while it is moved around and
+// isn't handed out again once it is removed. A UTF-8 path is stored once however often it is
+// listed, next to the label drawn for it. An entry takes 8 bytes besides its path, so inserting,
+// removing or moving entries shifts 4 bytes for every entry behind them.
+typedef struct playlist playlist;
+
+#define PLAYLIST_NONE UINT32_MAX // not an entry
+
+// Returns NULL when out of memory
+playlist *playlist_create(void);
+void playlist_free(playlist *pl);
+
+int playlist_count(const playlist *pl);
+uint32_t playlist_id_at(const playlist *pl, int index);
+
+// Position of an entry, -1 once it is removed. Goes through the list.
+int playlist_index_of(const playlist *pl, uint32_t id);
+
+// NULL once the entry is removed. Paths and labels stay put until the playlist changes.
+const char *playlist_path(const playlist *pl, uint32_t id);
+
+// Label of the path of an entry, NULL until one is set. Entries with the same path share it.
+const char *playlist_label(const playlist *pl, uint32_t id);
+
+// Returns 0 when out of memory. A label that is the file name of the path takes no memory.
+int playlist_set_label(playlist *pl, uint32_t id, const char *label);
+
+// Drops every label, for when what they were made from changed
+void playlist_forget_labels(playlist *pl);
+
+// Inserts count paths before index, which may be the count to append them. Returns 0 when out
+// of memory, with nothing inserted.
+int playlist_insert(playlist *pl, int index, const char *const *paths, int count);
+
+// Inserts new entries for the count entries from from on before index, returns 0 when out of
+// memory
+int playlist_copy(playlist *pl, int from, int count, int index);
+
+void playlist_remove(playlist *pl, int index, int count);
+
+// Moves the count entries from from on so that the first of them ends up at to
+void playlist_move(playlist *pl, int from, int count, int to);
+
+// Changes whenever entries are inserted or removed, not when they move or get labels
+uint32_t playlist_serial(const playlist *pl);
+
+size_t playlist_memory(const playlist *pl);
+
+#ifdef __cplusplus
+}
+#endif
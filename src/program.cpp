@@ -6,18 +6,31 @@
 #include <vector>
 
 #include "audio_sdl.h"
+#include "playlist.h"
 
 int main(int argc, char *argv[])
 {
+    App::_playlist = playlist_create();
+    if (!App::_playlist)
+    {
+        std::cout << "Out of memory" << std::endl;
+
+        return 1;
+    }
+
     for (int i = 1; i < argc; i++)
     {
         if (std::filesystem::is_regular_file(argv[i]))
         {
-            App::_playlist.push_back(argv[i]);
+            // The playlist keeps UTF-8, like SDL expects file names
+            auto path = std::filesystem::path(argv[i]).u8string();
+            const char *file = reinterpret_cast<const char *>(path.c_str());
+            playlist_insert(App::_playlist, playlist_count(App::_playlist), &file, 1);
         }
     }
 
-    sdl_audio_init(&App::_render, 44100, 2, 0, 0);
+    // Native device rate, every track is resampled to it by the player
+    sdl_audio_init(&App::_render, 0);
 
     const std::vector<std::string> args(argv, argv + argc);
     App app(args);
@@ -33,6 +46,7 @@ int main(int argc, char *argv[])
 
     auto result = app.Run();
     sdl_audio_release(App::_render);
+    playlist_free(App::_playlist);
 
     return result;
 }
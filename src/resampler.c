@@ -0,0 +1,319 @@
+#include "resampler.h"
+#include "dsp_kernels.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RESAMPLER_HISTORY_FRAMES (RESAMPLER_TAPS + RESAMPLER_CHUNK_FRAMES)
+#define RESAMPLER_RATES 9
+
+// Kaiser window and cutoff: ~85 dB stopband, passband up to ~0.83 of the lower Nyquist
+#define RESAMPLER_KAISER_BETA 8.6
+#define RESAMPLER_CUTOFF 0.91
+
+static const int resampler_rates[RESAMPLER_RATES] = {8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000};
+
+typedef struct resampler_filter
+{
+    int in_hz;
+    int phases;
+    float *coeffs; // RESAMPLER_TAPS per phase, NULL when in_hz is the output rate
+} resampler_filter;
+
+struct resampler
+{
+    int out_hz;
+    resampler_filter filters[RESAMPLER_RATES];
+    const resampler_filter *filter; // of in_hz, NULL until the first block
+    int in_hz;
+
+    // Stereo frames waiting to be filtered. Output is due at history frame pos plus
+    // frac / out_hz, centered RESAMPLER_TAPS / 2 - 1 frames further in.
+    float history[RESAMPLER_HISTORY_FRAMES * 2];
+    int frames;
+    int pos;
+    int frac;
+
+    // Per pass: where each output starts in the history and the phase it uses
+    int max_outputs;
+    int *offsets;
+    const float **kernels;
+};
+
+static int gcd(int a, int b)
+{
+    while (b)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static int resampler_build_filter(resampler_filter *filter, int in_hz, int out_hz)
+{
+    filter->in_hz = in_hz;
+    if (in_hz == out_hz)
+    {
+        return 1;
+    }
+
+    filter->phases = SDL_min(out_hz / gcd(in_hz, out_hz), RESAMPLER_MAX_PHASES);
+    filter->coeffs = (float *)malloc((size_t)filter->phases * RESAMPLER_TAPS * sizeof(float));
+    if (!filter->coeffs)
+    {
+        return 0;
+    }
+
+    // Low pass below the lower of the two Nyquist frequencies, in input samples
+    double cutoff = RESAMPLER_CUTOFF * SDL_min(1.0, (double)out_hz / in_hz);
+    double half = RESAMPLER_TAPS / 2;
+    double window_scale = 1.0 / bessel_i0(RESAMPLER_KAISER_BETA);
+
+    for (int phase = 0; phase < filter->phases; phase++)
+    {
+        float *k = filter->coeffs + (size_t)phase * RESAMPLER_TAPS;
+        double offset = (double)phase / filter->phases;
+        double sum = 0.0;
+
+        for (int t = 0; t < RESAMPLER_TAPS; t++)
+        {
+            double d = t - (half - 1.0) - offset; // distance to the output in input samples
+            double x = d / half;
+            double window = bessel_i0(RESAMPLER_KAISER_BETA * sqrt(SDL_max(0.0, 1.0 - x * x))) * window_scale;
+            double sinc = d == 0.0 ? 1.0 : sin(M_PI * cutoff * d) / (M_PI * cutoff * d);
+            k[t] = (float)(cutoff * sinc * window);
+            sum += k[t];
+        }
+
+        // Unity gain at DC for every phase, so no phase ripples
+        for (int t = 0; t < RESAMPLER_TAPS; t++)
+        {
+            k[t] = (float)(k[t] / sum);
+        }
+    }
+
+    return 1;
+}
+
+resampler *resampler_create(int out_hz)
+{
+    if (out_hz <= 0)
+    {
+        return NULL;
+    }
+
+    resampler *r = (resampler *)calloc(1, sizeof(resampler));
+    if (!r)
+    {
+        return NULL;
+    }
+
+    r->out_hz = out_hz;
+    r->max_outputs = (int)((int64_t)(RESAMPLER_CHUNK_FRAMES + 1) * out_hz / RESAMPLER_MIN_HZ) + 2;
+    r->offsets = (int *)malloc(r->max_outputs * sizeof(int));
+    r->kernels = (const float **)malloc(r->max_outputs * sizeof(const float *));
+
+    int ok = r->offsets && r->kernels;
+    for (int i = 0; i < RESAMPLER_RATES && ok; i++)
+    {
+        ok = resampler_build_filter(&r->filters[i], resampler_rates[i], out_hz);
+    }
+
+    if (!ok)
+    {
+        resampler_destroy(r);
+        return NULL;
+    }
+
+    resampler_reset(r);
+    return r;
+}
+
+void resampler_destroy(resampler *r)
+{
+    if (!r)
+    {
+        return;
+    }
+
+    for (int i = 0; i < RESAMPLER_RATES; i++)
+    {
+        free(r->filters[i].coeffs);
+    }
+    free(r->offsets);
+    free(r->kernels);
+    free(r);
+}
+
+int resampler_out_hz(const resampler *r)
+{
+    return r->out_hz;
+}
+
+int resampler_in_hz(const resampler *r)
+{
+    return r->in_hz;
+}
+
+int resampler_max_output(const resampler *r, int frames)
+{
+    return (int)((int64_t)(frames + RESAMPLER_TAPS) * r->out_hz / RESAMPLER_MIN_HZ) + 2;
+}
+
+void resampler_reset(resampler *r)
+{
+    r->filter = NULL;
+    r->in_hz = 0;
+
+    // Silence before the first frame, so the first output is centered on it
+    r->frames = RESAMPLER_TAPS / 2 - 1;
+    r->pos = 0;
+    r->frac = 0;
+    memset(r->history, 0, r->frames * 2 * sizeof(float));
+}
+
+// Interleaved mono or stereo decoder output to stereo float
+static void resampler_load(float *out, const mp3d_sample_t *samples, int frames, int channels)
+{
+#ifdef MINIMP3_FLOAT_OUTPUT
+    const float scale = 1.0f;
+#else
+    const float scale = 1.0f / 32768.0f;
+#endif
+
+    for (int i = 0; i < frames; i++)
+    {
+        float left = samples[i * channels] * scale;
+        out[i * 2] = left;
+        out[i * 2 + 1] = channels > 1 ? samples[i * channels + 1] * scale : left;
+    }
+}
+
+// Filters every output the history has enough frames for and drops the frames no later
+// output needs
+static int resampler_run(resampler *r, float *out)
+{
+    const resampler_filter *filter = r->filter;
+    int count = 0;
+
+    while (r->pos + RESAMPLER_TAPS <= r->frames && count < r->max_outputs)
+    {
+        int phase = (int)((int64_t)r->frac * filter->phases / r->out_hz);
+        r->offsets[count] = r->pos;
+        r->kernels[count] = filter->coeffs + (size_t)phase * RESAMPLER_TAPS;
+        count++;
+
+        r->frac += r->in_hz;
+        while (r->frac >= r->out_hz)
+        {
+            r->frac -= r->out_hz;
+            r->pos++;
+        }
+    }
+
+    dsp_fir_stereo(r->history, r->offsets, r->kernels, RESAMPLER_TAPS, out, count);
+
+    int kept = SDL_max(r->frames - r->pos, 0);
+    memmove(r->history, r->history + (r->frames - kept) * 2, kept * 2 * sizeof(float));
+    r->pos -= r->frames - kept;
+    r->frames = kept;
+
+    return count;
+}
+
+int resampler_process(
+    resampler *r,
+    const mp3d_sample_t *samples,
+    int frames,
+    int hz,
+    int channels,
+    float *out)
+{
+    if (hz != r->in_hz)
+    {
+        resampler_reset(r);
+        r->in_hz = hz;
+        for (int i = 0; i < RESAMPLER_RATES; i++)
+        {
+            if (r->filters[i].in_hz == hz)
+            {
+                r->filter = &r->filters[i];
+            }
+        }
+    }
+
+    if (!r->filter || channels < 1)
+    {
+        return 0;
+    }
+
+    if (!r->filter->coeffs)
+    {
+        // Native rate already, only the layout changes
+        resampler_load(out, samples, frames, channels);
+        return frames;
+    }
+
+    int written = 0;
+    while (frames > 0)
+    {
+        int n = SDL_min(frames, RESAMPLER_HISTORY_FRAMES - r->frames);
+        resampler_load(r->history + r->frames * 2, samples, n, channels);
+        r->frames += n;
+        samples += n * channels;
+        frames -= n;
+
+        written += resampler_run(r, out + written * 2);
+    }
+
+    return written;
+}
+
+int resampler_drain(resampler *r, float *out)
+{
+    int written = 0;
+
+    if (r->filter && r->filter->coeffs)
+    {
+        // Silence after the last frame lets the filter reach it
+        int pad = SDL_min(RESAMPLER_TAPS / 2, RESAMPLER_HISTORY_FRAMES - r->frames);
+        memset(r->history + r->frames * 2, 0, pad * 2 * sizeof(float));
+        r->frames += pad;
+        written = resampler_run(r, out);
+    }
+
+    resampler_reset(r);
+    return written;
+}
+
+int resampler_delay(const resampler *r)
+{
+    if (!r->filter || !r->filter->coeffs)
+    {
+        return 0;
+    }
+
+    // Input frames past the center of the next output, in steps of one output
+    int64_t held = (int64_t)(r->frames - r->pos - (RESAMPLER_TAPS / 2 - 1)) * r->out_hz - r->frac;
+    return held > 0 ? (int)(held / r->in_hz) : 0;
+}
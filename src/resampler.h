@@ -0,0 +1,54 @@
+#pragma once
+
+#include <minimp3_ex.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sample rate converter from the decoded tracks to the rate the device runs at natively.
+// Polyphase windowed sinc (Kaiser), RESAMPLER_TAPS taps per phase and one phase per
+// distinct fractional position between the two rates, so common ratios such as
+// 44100 -> 48000 are exact. Filters for every MPEG rate are built up front, switching
+// rates between tracks never allocates; the stream callback runs it.
+#define RESAMPLER_TAPS 64
+#define RESAMPLER_MAX_PHASES 1024
+#define RESAMPLER_CHUNK_FRAMES 256 // input frames filtered per pass
+#define RESAMPLER_MIN_HZ 8000      // lowest MPEG rate
+
+typedef struct resampler resampler;
+
+resampler *resampler_create(int out_hz);
+void resampler_destroy(resampler *resampler);
+
+int resampler_out_hz(const resampler *resampler);
+
+// Rate of the input seen last, 0 after a reset
+int resampler_in_hz(const resampler *resampler);
+
+// Most output frames process or drain write for frames input frames
+int resampler_max_output(const resampler *resampler, int frames);
+
+// Converts frames interleaved mono or stereo frames at hz, one of the MPEG rates, to
+// interleaved stereo float at the output rate. When hz changes the history of the old rate
+// is dropped, drain it first. Returns the frames written to out.
+int resampler_process(
+    resampler *resampler,
+    const mp3d_sample_t *samples,
+    int frames,
+    int hz,
+    int channels,
+    float *out);
+
+// Plays out the input the filter still holds, as at the end of a track, and resets
+int resampler_drain(resampler *resampler, float *out);
+
+// Forgets the history, after a seek or a flush
+void resampler_reset(resampler *resampler);
+
+// Input handed in but not output yet, in output frames
+int resampler_delay(const resampler *resampler);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1038 @@
+#include "search.h"
+
+#include <SDL3/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_BLOCK 128          // documents per block of a list
+#define SEARCH_CHUNK_DOCS 16384   // indexed at a time, bounds the uncompressed lists
+#define SEARCH_MAX_TEXT 1024      // of a field, the rest isn't indexed
+#define SEARCH_MAX_QUERY 256
+#define SEARCH_MAX_TOKENS 16
+#define SEARCH_KEYS_PER_TOKEN 2   // rarest keys of a word that narrow a query down
+
+// Length in the top byte keeps prefixes and trigrams apart
+#define SEARCH_KEY(n, a, b, c) ((uint32_t)(n) << 24 | (uint32_t)(a) << 16 | (uint32_t)(b) << 8 | (uint32_t)(c))
+
+// A match at the start of a word counts double, a whole field three times
+static const uint32_t search_field_weight[SEARCH_FIELD_COUNT] = {4, 3, 2, 1};
+
+struct search_index
+{
+    uint32_t doc_count;
+    uint32_t key_count;
+    uint32_t *keys;        // sorted
+    uint32_t *key_docs;    // documents per key
+    uint32_t *key_blocks;  // first block of every key, key_count + 1 entries
+    uint32_t *block_docs;  // first document of every block
+    uint32_t *block_bytes; // where the deltas of the other documents of a block start
+    uint8_t *bytes;
+    size_t byte_count;
+    size_t block_count;
+};
+
+/* ============================================================
+   Text
+   ============================================================ */
+
+static int search_is_separator(uint8_t c)
+{
+    return c < 0x80 && !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'));
+}
+
+// ASCII and Latin-1 capitals to lower case, everything else byte for byte
+static size_t search_fold(const char *text, size_t length, char *out, size_t out_size)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < length && n + 1 < out_size; i++)
+    {
+        uint8_t c = (uint8_t)text[i];
+        if (c >= 'A' && c <= 'Z')
+        {
+            c += 'a' - 'A';
+        }
+        else if (n > 0 && (uint8_t)out[n - 1] == 0xC3 && c >= 0x80 && c <= 0x9E && c != 0x97)
+        {
+            c += 0x20; // U+00C0 to U+00DE but the multiplication sign
+        }
+        out[n++] = (char)c;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+// Folded field of a document, the path without its extension
+static size_t search_field_text(search_text_cb text, void *user, uint32_t doc, int field, char *out, size_t out_size)
+{
+    const char *s = text(user, doc, field);
+    size_t length = s ? strlen(s) : 0;
+    if (field == SEARCH_FIELD_PATH)
+    {
+        const char *dot = s ? strrchr(s, '.') : NULL;
+        if (dot && !strchr(dot, '/'))
+        {
+            length = (size_t)(dot - s);
+        }
+    }
+    return search_fold(s, length, out, out_size);
+}
+
+typedef void (*search_key_cb)(void *ctx, uint32_t key);
+
+static void search_field_keys(const uint8_t *s, size_t n, search_key_cb emit, void *ctx)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!search_is_separator(s[i]) && (i == 0 || search_is_separator(s[i - 1])))
+        {
+            emit(ctx, SEARCH_KEY(1, s[i], 0, 0));
+            if (i + 1 < n && !search_is_separator(s[i + 1]))
+            {
+                emit(ctx, SEARCH_KEY(2, s[i], s[i + 1], 0));
+            }
+        }
+        if (i + 2 < n)
+        {
+            emit(ctx, SEARCH_KEY(3, s[i], s[i + 1], s[i + 2]));
+        }
+    }
+}
+
+static void search_doc_keys(search_text_cb text, void *user, uint32_t doc, search_key_cb emit, void *ctx)
+{
+    char folded[SEARCH_MAX_TEXT];
+    for (int field = 0; field < SEARCH_FIELD_COUNT; field++)
+    {
+        size_t n = search_field_text(text, user, doc, field, folded, sizeof(folded));
+        search_field_keys((const uint8_t *)folded, n, emit, ctx);
+    }
+}
+
+/* ============================================================
+   Writing lists
+   ============================================================ */
+
+typedef struct search_buffer
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} search_buffer;
+
+typedef struct search_writer
+{
+    search_buffer keys;
+    search_buffer key_docs;
+    search_buffer key_blocks;
+    search_buffer block_docs;
+    search_buffer block_bytes;
+    search_buffer bytes;
+    uint32_t docs;     // of the current key so far
+    uint32_t last_doc;
+    int ok;
+} search_writer;
+
+static int search_reserve(search_writer *w, search_buffer *b, size_t more)
+{
+    if (w->ok && b->size + more > b->capacity)
+    {
+        size_t capacity = SDL_max(SDL_max(b->capacity * 2, b->size + more), (size_t)4096);
+        uint8_t *data = (uint8_t *)realloc(b->data, capacity);
+        if (!data)
+        {
+            w->ok = 0;
+            return 0;
+        }
+        b->data = data;
+        b->capacity = capacity;
+    }
+    return w->ok;
+}
+
+static void search_put32(search_writer *w, search_buffer *b, uint32_t value)
+{
+    if (search_reserve(w, b, sizeof(value)))
+    {
+        memcpy(b->data + b->size, &value, sizeof(value));
+        b->size += sizeof(value);
+    }
+}
+
+static uint32_t search_block_count(const search_writer *w)
+{
+    return (uint32_t)(w->block_docs.size / sizeof(uint32_t));
+}
+
+static void search_begin_key(search_writer *w, uint32_t key)
+{
+    search_put32(w, &w->keys, key);
+    search_put32(w, &w->key_blocks, search_block_count(w));
+    w->docs = 0;
+}
+
+static void search_add_doc(search_writer *w, uint32_t doc)
+{
+    if (w->docs % SEARCH_BLOCK == 0)
+    {
+        search_put32(w, &w->block_docs, doc);
+        search_put32(w, &w->block_bytes, (uint32_t)w->bytes.size);
+    }
+    else if (search_reserve(w, &w->bytes, 5))
+    {
+        // Documents are ascending, runs of neighbours take a byte each
+        uint32_t delta = doc - w->last_doc - 1;
+        while (delta >= 0x80)
+        {
+            w->bytes.data[w->bytes.size++] = (uint8_t)(delta | 0x80);
+            delta >>= 7;
+        }
+        w->bytes.data[w->bytes.size++] = (uint8_t)delta;
+    }
+    w->last_doc = doc;
+    w->docs++;
+}
+
+static void search_end_key(search_writer *w)
+{
+    if (!w->ok)
+    {
+        return;
+    }
+
+    // Keys whose documents are all gone are dropped
+    if (w->docs == 0)
+    {
+        w->keys.size -= sizeof(uint32_t);
+        w->key_blocks.size -= sizeof(uint32_t);
+        return;
+    }
+    search_put32(w, &w->key_docs, w->docs);
+}
+
+static void search_writer_free(search_writer *w)
+{
+    free(w->keys.data);
+    free(w->key_docs.data);
+    free(w->key_blocks.data);
+    free(w->block_docs.data);
+    free(w->block_bytes.data);
+    free(w->bytes.data);
+}
+
+static search_index *search_finish(search_writer *w, uint32_t doc_count)
+{
+    search_put32(w, &w->key_blocks, search_block_count(w));
+    search_put32(w, &w->block_bytes, (uint32_t)w->bytes.size);
+    search_reserve(w, &w->bytes, 1); // never empty, so never NULL
+
+    search_index *index = w->ok ? (search_index *)calloc(1, sizeof(search_index)) : NULL;
+    if (!index || w->bytes.size > UINT32_MAX)
+    {
+        free(index);
+        search_writer_free(w);
+        return NULL;
+    }
+
+    index->doc_count = doc_count;
+    index->key_count = (uint32_t)(w->keys.size / sizeof(uint32_t));
+    index->keys = (uint32_t *)w->keys.data;
+    index->key_docs = (uint32_t *)w->key_docs.data;
+    index->key_blocks = (uint32_t *)w->key_blocks.data;
+    index->block_docs = (uint32_t *)w->block_docs.data;
+    index->block_bytes = (uint32_t *)w->block_bytes.data;
+    index->bytes = w->bytes.data;
+    index->byte_count = w->bytes.size;
+    index->block_count = search_block_count(w);
+    return index;
+}
+
+/* ============================================================
+   Reading lists
+   ============================================================ */
+
+typedef struct search_cursor
+{
+    const search_index *index;
+    uint32_t first_block;
+    uint32_t count; // documents of the key
+    uint32_t read;  // documents read, the current one included
+    const uint8_t *at;
+    uint32_t doc;
+} search_cursor;
+
+static void search_cursor_open(search_cursor *c, const search_index *index, uint32_t key_index)
+{
+    c->index = index;
+    c->first_block = index->key_blocks[key_index];
+    c->count = index->key_docs[key_index];
+    c->read = 0;
+    c->at = NULL;
+    c->doc = 0;
+}
+
+static int search_cursor_next(search_cursor *c)
+{
+    if (c->read == c->count)
+    {
+        return 0;
+    }
+
+    if (c->read % SEARCH_BLOCK == 0)
+    {
+        uint32_t block = c->first_block + c->read / SEARCH_BLOCK;
+        c->doc = c->index->block_docs[block];
+        c->at = c->index->bytes + c->index->block_bytes[block];
+    }
+    else
+    {
+        uint32_t delta = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t byte = *c->at++;
+            delta |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+        c->doc += delta + 1;
+    }
+    c->read++;
+    return 1;
+}
+
+// Moves to the first document at or after target, returns 0 if there is none
+static int search_cursor_seek(search_cursor *c, uint32_t target)
+{
+    if (c->read > 0 && c->doc >= target)
+    {
+        return 1;
+    }
+
+    // Blocks that end before target are skipped without decoding them
+    if (c->count > 0)
+    {
+        const uint32_t *starts = c->index->block_docs;
+        uint32_t lo = c->first_block + (c->read > 0 ? (c->read - 1) / SEARCH_BLOCK : 0);
+        uint32_t last = c->first_block + (c->count - 1) / SEARCH_BLOCK;
+        if (lo < last && starts[lo + 1] <= target)
+        {
+            uint32_t hi = last;
+            lo++;
+            while (lo < hi)
+            {
+                uint32_t mid = lo + (hi - lo + 1) / 2;
+                if (starts[mid] <= target)
+                {
+                    lo = mid;
+                }
+                else
+                {
+                    hi = mid - 1;
+                }
+            }
+            c->read = (lo - c->first_block) * SEARCH_BLOCK;
+        }
+    }
+
+    while (search_cursor_next(c))
+    {
+        if (c->doc >= target)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int search_find_key(const search_index *index, uint32_t key)
+{
+    uint32_t lo = 0, hi = index->key_count;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index->keys[mid] < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo < index->key_count && index->keys[lo] == key ? (int)lo : -1;
+}
+
+/* ============================================================
+   Building
+   ============================================================ */
+
+typedef struct search_slot
+{
+    uint32_t key;      // 0 for a free slot, no key is 0
+    uint32_t count;
+    uint32_t last_doc; // plus one, counts every document once
+    uint32_t index;
+} search_slot;
+
+typedef struct search_map
+{
+    search_slot *slots;
+    uint32_t bits;
+    uint32_t used;
+    uint32_t doc;
+    uint32_t *postings; // NULL while counting
+    uint32_t *fill;     // next free posting of every key
+    int ok;
+} search_map;
+
+static search_slot *search_slot_of(search_slot *slots, uint32_t bits, uint32_t key)
+{
+    uint32_t mask = (1u << bits) - 1;
+    for (uint32_t i = (key * 0x9E3779B1u) >> (32 - bits);; i = (i + 1) & mask)
+    {
+        if (slots[i].key == key || slots[i].key == 0)
+        {
+            return &slots[i];
+        }
+    }
+}
+
+static int search_map_grow(search_map *map)
+{
+    uint32_t bits = map->bits + 1;
+    search_slot *slots = (search_slot *)calloc((size_t)1 << bits, sizeof(search_slot));
+    if (!slots)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; map->slots && i < (1u << map->bits); i++)
+    {
+        if (map->slots[i].key)
+        {
+            *search_slot_of(slots, bits, map->slots[i].key) = map->slots[i];
+        }
+    }
+    free(map->slots);
+    map->slots = slots;
+    map->bits = bits;
+    return 1;
+}
+
+static void search_map_key(void *ctx, uint32_t key)
+{
+    search_map *map = (search_map *)ctx;
+    if (!map->ok)
+    {
+        return;
+    }
+
+    search_slot *slot = search_slot_of(map->slots, map->bits, key);
+    if (slot->key == 0)
+    {
+        if ((map->used + 1) * 2 > (1u << map->bits))
+        {
+            if (!search_map_grow(map))
+            {
+                map->ok = 0;
+                return;
+            }
+            slot = search_slot_of(map->slots, map->bits, key);
+        }
+        slot->key = key;
+        map->used++;
+    }
+
+    if (slot->last_doc == map->doc + 1)
+    {
+        return;
+    }
+    slot->last_doc = map->doc + 1;
+
+    if (map->postings)
+    {
+        map->postings[map->fill[slot->index]++] = map->doc;
+    }
+    else
+    {
+        slot->count++;
+    }
+}
+
+static int search_compare_slots(const void *a, const void *b)
+{
+    uint32_t x = (*(search_slot *const *)a)->key, y = (*(search_slot *const *)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+// Index of count documents from docs, or from first on when docs is NULL
+static search_index *search_build_chunk(const uint32_t *docs, uint32_t first, uint32_t count, uint32_t doc_count, search_text_cb text,
+                                        void *user)
+{
+    search_map map;
+    memset(&map, 0, sizeof(map));
+    map.bits = 11;
+    map.ok = 1;
+    map.slots = (search_slot *)calloc((size_t)1 << map.bits, sizeof(search_slot));
+    if (!map.slots)
+    {
+        return NULL;
+    }
+
+    // Counting first sizes the uncompressed lists exactly
+    for (uint32_t i = 0; i < count && map.ok; i++)
+    {
+        map.doc = docs ? docs[i] : first + i;
+        search_doc_keys(text, user, map.doc, search_map_key, &map);
+    }
+
+    search_slot **sorted = map.ok ? (search_slot **)malloc(SDL_max(map.used, 1) * sizeof(search_slot *)) : NULL;
+    map.fill = sorted ? (uint32_t *)malloc(SDL_max(map.used, 1) * sizeof(uint32_t)) : NULL;
+    uint32_t *offsets = map.fill ? (uint32_t *)malloc((map.used + 1) * sizeof(uint32_t)) : NULL;
+    search_index *index = NULL;
+    if (offsets)
+    {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < (1u << map.bits); i++)
+        {
+            if (map.slots[i].key)
+            {
+                sorted[n++] = &map.slots[i];
+            }
+        }
+        qsort(sorted, n, sizeof(search_slot *), search_compare_slots);
+
+        size_t total = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            sorted[i]->index = i;
+            sorted[i]->last_doc = 0;
+            offsets[i] = map.fill[i] = (uint32_t)total;
+            total += sorted[i]->count;
+        }
+        offsets[n] = (uint32_t)total;
+
+        map.postings = (uint32_t *)malloc(SDL_max(total, (size_t)1) * sizeof(uint32_t));
+        if (map.postings)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                map.doc = docs ? docs[i] : first + i;
+                search_doc_keys(text, user, map.doc, search_map_key, &map);
+            }
+
+            search_writer w;
+            memset(&w, 0, sizeof(w));
+            w.ok = 1;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                search_begin_key(&w, sorted[i]->key);
+                for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++)
+                {
+                    search_add_doc(&w, map.postings[j]);
+                }
+                search_end_key(&w);
+            }
+            index = search_finish(&w, doc_count);
+        }
+    }
+
+    free(map.postings);
+    free(offsets);
+    free(map.fill);
+    free(sorted);
+    free(map.slots);
+    return index;
+}
+
+// Reads the lists of an index in key order, with documents renumbered
+typedef struct search_source
+{
+    const search_index *index;
+    const int32_t *new_of_old; // NULL to keep the numbers
+    uint32_t next_key;
+    int active;                // has the key being merged
+    int has_doc;
+    uint32_t doc;
+    search_cursor cursor;
+} search_source;
+
+static int search_source_next(search_source *s)
+{
+    while (search_cursor_next(&s->cursor))
+    {
+        int32_t doc = s->new_of_old ? s->new_of_old[s->cursor.doc] : (int32_t)s->cursor.doc;
+        if (doc >= 0)
+        {
+            s->doc = (uint32_t)doc;
+            return s->has_doc = 1;
+        }
+    }
+    return s->has_doc = 0;
+}
+
+// Merges the lists of every key of the sources, whose documents don't overlap
+static search_index *search_merge(search_source *sources, int count, uint32_t doc_count)
+{
+    search_writer w;
+    memset(&w, 0, sizeof(w));
+    w.ok = 1;
+
+    while (w.ok)
+    {
+        int any = 0;
+        uint32_t key = 0;
+        for (int i = 0; i < count; i++)
+        {
+            search_source *s = &sources[i];
+            if (s->next_key < s->index->key_count && (!any || s->index->keys[s->next_key] < key))
+            {
+                key = s->index->keys[s->next_key];
+                any = 1;
+            }
+        }
+        if (!any)
+        {
+            break;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            search_source *s = &sources[i];
+            s->active = s->next_key < s->index->key_count && s->index->keys[s->next_key] == key;
+            if (s->active)
+            {
+                search_cursor_open(&s->cursor, s->index, s->next_key++);
+                search_source_next(s);
+            }
+        }
+
+        search_begin_key(&w, key);
+        for (;;)
+        {
+            search_source *best = NULL;
+            for (int i = 0; i < count; i++)
+            {
+                if (sources[i].active && sources[i].has_doc && (!best || sources[i].doc < best->doc))
+                {
+                    best = &sources[i];
+                }
+            }
+            if (!best)
+            {
+                break;
+            }
+
+            // Runs of one source are copied until another one has the smaller document
+            uint32_t bound = UINT32_MAX;
+            for (int i = 0; i < count; i++)
+            {
+                if (&sources[i] != best && sources[i].active && sources[i].has_doc)
+                {
+                    bound = SDL_min(bound, sources[i].doc);
+                }
+            }
+            do
+            {
+                search_add_doc(&w, best->doc);
+            } while (search_source_next(best) && best->doc < bound);
+        }
+        search_end_key(&w);
+    }
+
+    return search_finish(&w, doc_count);
+}
+
+// Indexes the listed documents in chunks, then merges the chunks with base, which may be NULL
+static search_index *search_build_docs(const search_index *base, const int32_t *new_of_old, const uint32_t *docs, uint32_t count,
+                                       uint32_t doc_count, search_text_cb text, void *user)
+{
+    uint32_t chunk_count = (count + SEARCH_CHUNK_DOCS - 1) / SEARCH_CHUNK_DOCS;
+    if (!base && chunk_count <= 1)
+    {
+        return search_build_chunk(docs, 0, count, doc_count, text, user);
+    }
+
+    int source_count = 0;
+    search_source *sources = (search_source *)calloc(chunk_count + 1, sizeof(search_source));
+    if (!sources)
+    {
+        return NULL;
+    }
+
+    if (base)
+    {
+        sources[source_count].index = base;
+        sources[source_count++].new_of_old = new_of_old;
+    }
+
+    int ok = 1;
+    for (uint32_t i = 0; i < chunk_count && ok; i++)
+    {
+        uint32_t first = i * SEARCH_CHUNK_DOCS;
+        uint32_t n = SDL_min(count - first, (uint32_t)SEARCH_CHUNK_DOCS);
+        sources[source_count].index = search_build_chunk(docs ? docs + first : NULL, first, n, doc_count, text, user);
+        ok = sources[source_count++].index != NULL;
+    }
+
+    search_index *index = ok ? search_merge(sources, source_count, doc_count) : NULL;
+    for (int i = base ? 1 : 0; i < source_count; i++)
+    {
+        search_free((search_index *)sources[i].index);
+    }
+    free(sources);
+    return index;
+}
+
+search_index *search_build(uint32_t count, search_text_cb text, void *user)
+{
+    return search_build_docs(NULL, NULL, NULL, count, count, text, user);
+}
+
+search_index *search_update(const search_index *previous, const int32_t *new_of_old, const uint32_t *added, uint32_t added_count,
+                            uint32_t count, search_text_cb text, void *user)
+{
+    return search_build_docs(previous, new_of_old, added, added_count, count, text, user);
+}
+
+void search_free(search_index *index)
+{
+    if (!index)
+    {
+        return;
+    }
+
+    free(index->keys);
+    free(index->key_docs);
+    free(index->key_blocks);
+    free(index->block_docs);
+    free(index->block_bytes);
+    free(index->bytes);
+    free(index);
+}
+
+size_t search_memory(const search_index *index)
+{
+    if (!index)
+    {
+        return 0;
+    }
+    return sizeof(*index) + (size_t)index->key_count * 3 * sizeof(uint32_t) + index->block_count * 2 * sizeof(uint32_t) + index->byte_count;
+}
+
+/* ============================================================
+   Queries
+   ============================================================ */
+
+struct search_query
+{
+    char text[SEARCH_MAX_QUERY]; // folded, every token terminated
+    int token_count;
+    uint16_t token_at[SEARCH_MAX_TOKENS];
+    uint16_t token_length[SEARCH_MAX_TOKENS];
+
+    // The rarest list drives, the others are only probed for its documents
+    search_cursor cursors[SEARCH_MAX_TOKENS * SEARCH_KEYS_PER_TOKEN];
+    int cursor_count;
+    uint32_t pending; // documents of the rarest list not reached yet
+
+    search_hit *hits; // room for every document of the rarest list
+    int hit_count;
+};
+
+// Splits the folded query into words; one or two character words lose the separators around
+// them as they only match the start of a word
+static void search_tokenize(search_query *q, const char *text)
+{
+    size_t n = search_fold(text, strlen(text), q->text, sizeof(q->text));
+    size_t i = 0;
+    while (i < n && q->token_count < SEARCH_MAX_TOKENS)
+    {
+        while (i < n && (uint8_t)q->text[i] <= ' ')
+        {
+            i++;
+        }
+        size_t start = i;
+        while (i < n && (uint8_t)q->text[i] > ' ')
+        {
+            i++;
+        }
+        size_t end = i;
+        q->text[i < n ? i++ : i] = '\0';
+
+        if (end - start < 3)
+        {
+            while (start < end && search_is_separator((uint8_t)q->text[start]))
+            {
+                start++;
+            }
+            while (end > start && search_is_separator((uint8_t)q->text[end - 1]))
+            {
+                end--;
+            }
+        }
+
+        if (end > start)
+        {
+            q->token_at[q->token_count] = (uint16_t)start;
+            q->token_length[q->token_count++] = (uint16_t)(end - start);
+        }
+    }
+}
+
+static int search_compare_counts(const void *a, const void *b)
+{
+    const uint32_t *x = (const uint32_t *)a, *y = (const uint32_t *)b;
+    if (x[1] != y[1])
+    {
+        return x[1] < y[1] ? -1 : 1;
+    }
+    return x[0] < y[0] ? -1 : x[0] > y[0];
+}
+
+// Picks the rarest keys of every word as {key index, documents} pairs, the text check does the
+// rest. Returns -1 if a key is missing, when nothing can match.
+static int search_query_keys(const search_query *q, const search_index *index, uint32_t (*picked)[2])
+{
+    int count = 0;
+    for (int t = 0; t < q->token_count; t++)
+    {
+        const uint8_t *s = (const uint8_t *)q->text + q->token_at[t];
+        int n = q->token_length[t];
+
+        uint32_t keys[SEARCH_MAX_QUERY];
+        int key_count = 0;
+        if (n < 3)
+        {
+            keys[key_count++] = n == 1 ? SEARCH_KEY(1, s[0], 0, 0) : SEARCH_KEY(2, s[0], s[1], 0);
+        }
+        for (int i = 0; i + 2 < n; i++)
+        {
+            keys[key_count++] = SEARCH_KEY(3, s[i], s[i + 1], s[i + 2]);
+        }
+
+        uint32_t rarest[SEARCH_KEYS_PER_TOKEN][2];
+        int rare_count = 0;
+        for (int i = 0; i < key_count; i++)
+        {
+            int found = search_find_key(index, keys[i]);
+            if (found < 0)
+            {
+                return -1;
+            }
+
+            // Insertion into the few rarest so far
+            uint32_t docs = index->key_docs[found];
+            int at = rare_count < SEARCH_KEYS_PER_TOKEN ? rare_count++ : SEARCH_KEYS_PER_TOKEN;
+            while (at > 0 && rarest[at - 1][1] > docs)
+            {
+                if (at < SEARCH_KEYS_PER_TOKEN)
+                {
+                    rarest[at][0] = rarest[at - 1][0];
+                    rarest[at][1] = rarest[at - 1][1];
+                }
+                at--;
+            }
+            if (at < SEARCH_KEYS_PER_TOKEN)
+            {
+                rarest[at][0] = (uint32_t)found;
+                rarest[at][1] = docs;
+            }
+        }
+
+        for (int i = 0; i < rare_count; i++)
+        {
+            picked[count][0] = rarest[i][0];
+            picked[count++][1] = rarest[i][1];
+        }
+    }
+
+    qsort(picked, count, sizeof(picked[0]), search_compare_counts);
+    return count;
+}
+
+search_query *search_start(const search_index *index, const char *text)
+{
+    search_query *q = (search_query *)calloc(1, sizeof(search_query));
+    if (!q)
+    {
+        return NULL;
+    }
+
+    search_tokenize(q, text);
+    if (q->token_count == 0)
+    {
+        free(q);
+        return NULL;
+    }
+
+    uint32_t keys[SEARCH_MAX_TOKENS * SEARCH_KEYS_PER_TOKEN][2];
+    int key_count = search_query_keys(q, index, keys);
+    if (key_count <= 0)
+    {
+        return q;
+    }
+
+    q->hits = (search_hit *)malloc(keys[0][1] * sizeof(search_hit));
+    if (!q->hits)
+    {
+        free(q);
+        return NULL;
+    }
+
+    for (int i = 0; i < key_count; i++)
+    {
+        // Words sharing a key probe it once
+        if (i > 0 && keys[i][0] == keys[q->cursor_count - 1][0])
+        {
+            continue;
+        }
+        keys[q->cursor_count][0] = keys[i][0];
+        search_cursor_open(&q->cursors[q->cursor_count++], index, keys[i][0]);
+    }
+    q->pending = keys[0][1];
+    return q;
+}
+
+// 0 when the token isn't in the field, 1 inside a word, 2 at the start of one, 3 for all of it
+static uint32_t search_match(const char *field, size_t field_length, const char *token, size_t length, int word_start_only)
+{
+    uint32_t best = 0;
+    for (size_t i = 0; i + length <= field_length && best < 2; i++)
+    {
+        if (field[i] != token[0] || memcmp(field + i, token, length) != 0)
+        {
+            continue;
+        }
+
+        int word_start = i == 0 || search_is_separator((uint8_t)field[i - 1]) || search_is_separator((uint8_t)token[0]);
+        if (word_start)
+        {
+            best = i == 0 && length == field_length ? 3 : 2;
+        }
+        else if (!word_start_only)
+        {
+            best = 1;
+        }
+    }
+    return best;
+}
+
+static uint32_t search_score(const search_query *q, uint32_t doc, search_text_cb text, void *user)
+{
+    char fields[SEARCH_FIELD_COUNT][SEARCH_MAX_TEXT];
+    size_t lengths[SEARCH_FIELD_COUNT];
+    for (int f = 0; f < SEARCH_FIELD_COUNT; f++)
+    {
+        lengths[f] = search_field_text(text, user, doc, f, fields[f], sizeof(fields[f]));
+    }
+
+    // Every word has to match, each counts with its best field
+    uint32_t score = 0;
+    for (int t = 0; t < q->token_count; t++)
+    {
+        const char *token = q->text + q->token_at[t];
+        size_t length = q->token_length[t];
+        uint32_t best = 0;
+        for (int f = 0; f < SEARCH_FIELD_COUNT; f++)
+        {
+            best = SDL_max(best, search_field_weight[f] * search_match(fields[f], lengths[f], token, length, length < 3));
+        }
+        if (!best)
+        {
+            return 0;
+        }
+        score += best;
+    }
+    return score;
+}
+
+static int search_hit_before(const search_hit *a, const search_hit *b)
+{
+    return a->score > b->score || (a->score == b->score && a->doc < b->doc);
+}
+
+static int search_compare_hits(const void *a, const void *b)
+{
+    const search_hit *x = (const search_hit *)a, *y = (const search_hit *)b;
+    return search_hit_before(x, y) ? -1 : search_hit_before(y, x);
+}
+
+int search_step(search_query *q, search_text_cb text, void *user, int max)
+{
+    if (q->pending == 0)
+    {
+        return 0;
+    }
+
+    // Hits of this step are ranked on their own, then merged in from the back
+    int end = (int)SDL_min(q->pending, (uint32_t)max);
+    search_hit *fresh = (search_hit *)malloc((size_t)end * sizeof(search_hit));
+    int fresh_count = 0;
+    for (int n = 0; n < end && fresh; n++)
+    {
+        search_cursor *driver = &q->cursors[0];
+        search_cursor_next(driver);
+        q->pending--;
+
+        int i = 1;
+        while (i < q->cursor_count && search_cursor_seek(&q->cursors[i], driver->doc) && q->cursors[i].doc == driver->doc)
+        {
+            i++;
+        }
+        uint32_t score = i == q->cursor_count ? search_score(q, driver->doc, text, user) : 0;
+        if (score)
+        {
+            fresh[fresh_count].doc = driver->doc;
+            fresh[fresh_count++].score = score;
+        }
+    }
+    if (fresh_count > 1)
+    {
+        qsort(fresh, fresh_count, sizeof(search_hit), search_compare_hits);
+    }
+
+    int i = q->hit_count - 1, j = fresh_count - 1;
+    for (int out = q->hit_count + fresh_count - 1; j >= 0; out--)
+    {
+        if (i >= 0 && search_hit_before(&fresh[j], &q->hits[i]))
+        {
+            q->hits[out] = q->hits[i--];
+        }
+        else
+        {
+            q->hits[out] = fresh[j--];
+        }
+    }
+    q->hit_count += fresh_count;
+    free(fresh);
+
+    return q->pending > 0;
+}
+
+int search_pending(const search_query *q)
+{
+    return (int)q->pending;
+}
+
+int search_hit_count(const search_query *q)
+{
+    return q->hit_count;
+}
+
+const search_hit *search_hits(const search_query *q)
+{
+    return q->hits;
+}
+
+void search_end(search_query *q)
+{
+    if (!q)
+    {
+        return;
+    }
+
+    free(q->hits);
+    free(q);
+}
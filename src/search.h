@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Full text index over the fields of numbered documents. Every three bytes of a field are a
+// key, and so are the first one and two characters of every word, so words being typed find
+// something from the first keystroke on. A query walks the list of its rarest key, probes the
+// lists of a few other keys for each document, then checks and ranks what is left against the
+// text itself. Lists are delta coded in blocks whose first
+// documents are kept apart, so intersecting skips through long lists instead of decoding
+// them. Letters match regardless of case for ASCII and Latin-1.
+typedef struct search_index search_index;
+typedef struct search_query search_query;
+
+enum
+{
+    SEARCH_FIELD_TITLE,
+    SEARCH_FIELD_ARTIST,
+    SEARCH_FIELD_ALBUM,
+    SEARCH_FIELD_PATH, // without its extension
+    SEARCH_FIELD_COUNT
+};
+
+// Text of a field of a document, NULL when it has none
+typedef const char *(*search_text_cb)(void *user, uint32_t doc, int field);
+
+typedef struct search_hit
+{
+    uint32_t doc;
+    uint32_t score; // title matches weigh most, then artist, album and path
+} search_hit;
+
+// Indexes documents 0 to count - 1, returns NULL when out of memory
+search_index *search_build(uint32_t count, search_text_cb text, void *user);
+
+// Index of count documents made from previous without reading its documents again. new_of_old
+// maps every document of previous to its new number, which must keep their order, or to -1 if
+// it is gone. Only the added documents are read.
+search_index *search_update(const search_index *previous, const int32_t *new_of_old, const uint32_t *added, uint32_t added_count,
+                            uint32_t count, search_text_cb text, void *user);
+
+void search_free(search_index *index);
+size_t search_memory(const search_index *index);
+
+// Starts looking for the documents that hold every word of text somewhere, which takes no
+// time as steps do the work. Returns NULL for a query without words. The index has to outlive
+// the query.
+search_query *search_start(const search_index *index, const char *text);
+
+// Goes through up to max more documents of the rarest key of the query, ranking those that
+// match. Returns 0 once all are done.
+int search_step(search_query *query, search_text_cb text, void *user, int max);
+
+int search_pending(const search_query *query); // documents still to go through
+int search_hit_count(const search_query *query);
+const search_hit *search_hits(const search_query *query); // best first
+void search_end(search_query *query);
+
+#ifdef __cplusplus
+}
+#endif
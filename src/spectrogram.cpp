@@ -0,0 +1,159 @@
+#include <spectrogram.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "spectrum.h"
+
+void Spectrogram::init()
+{
+    auto vertexShader = GLSL_VERTEX_SHADER(
+        uniform vec4 rect;
+        out vec2 uv;
+
+        void main()
+        {
+            uv = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+            gl_Position = vec4(mix(rect.xy, rect.zw, uv), 0.0, 1.0);
+        });
+
+    // Newest frame on the right, lowest band at the bottom. Colors follow the bars.
+    auto fragmentShader = GLSL_FRAGMENT_SHADER(
+        uniform sampler2D levels;
+        uniform float newest;
+        uniform float visible;
+        uniform float bands;
+        in vec2 uv;
+        out vec4 color;
+
+        void main()
+        {
+            vec2 size = vec2(textureSize(levels, 0));
+            float column = newest + 0.5 - (1.0 - uv.x) * visible;
+            float row = (1.0 - uv.y) * (bands - 1.0) + 0.5;
+            float heat = smoothstep(0.2, 1.0, texture(levels, vec2(column / size.x, row / size.y)).r);
+            vec3 bar = mix(vec3(0.2, 0.8, 0.2), vec3(1.0, 0.2, 0.2), heat);
+            color = vec4(mix(vec3(0.05, 0.05, 0.1), bar, heat), 1.0);
+        });
+
+    _program = std::make_unique<GlProgram>();
+    _program->attach(vertexShader);
+    _program->attach(fragmentShader);
+    _program->link();
+
+    glGenVertexArrays(1, &_vao);
+
+    // One byte per band and frame, columns wrap around
+    std::vector<unsigned char> zeros(Columns * SPECTRUM_MAX_BANDS, 0);
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, Columns, SPECTRUM_MAX_BANDS, 0, GL_RED, GL_UNSIGNED_BYTE, zeros.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Spectrogram::cleanup()
+{
+    glDeleteTextures(1, &_texture);
+    glDeleteVertexArrays(1, &_vao);
+    _program.reset();
+
+    _texture = 0;
+    _vao = 0;
+}
+
+void Spectrogram::push(const float levels[][2], int bands)
+{
+    if (!_texture)
+    {
+        return;
+    }
+
+    bands = std::clamp(bands, 1, SPECTRUM_MAX_BANDS);
+
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (bands != _bands)
+    {
+        // Rows meant other frequencies before
+        std::vector<unsigned char> zeros(Columns * SPECTRUM_MAX_BANDS, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Columns, SPECTRUM_MAX_BANDS, GL_RED, GL_UNSIGNED_BYTE, zeros.data());
+        _bands = bands;
+    }
+
+    unsigned char column[SPECTRUM_MAX_BANDS];
+    for (int band = 0; band < bands; band++)
+    {
+        float value = (levels[band][0] + levels[band][1]) * 0.5f;
+        column[band] = (unsigned char)std::lround(std::clamp(value / 100.0f, 0.0f, 1.0f) * 255.0f);
+    }
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, _head, 0, 1, bands, GL_RED, GL_UNSIGNED_BYTE, column);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    _head = (_head + 1) % Columns;
+}
+
+void Spectrogram::draw(ImDrawList *drawList, ImVec2 p0, ImVec2 p1)
+{
+    if (!_texture)
+    {
+        return;
+    }
+
+    // Same mapping as the ImGui renderer's projection
+    const ImGuiViewport *viewport = ImGui::GetMainViewport();
+    auto ndc = [viewport](ImVec2 p) {
+        return glm::vec2(
+            (p.x - viewport->Pos.x) / viewport->Size.x * 2.0f - 1.0f,
+            1.0f - (p.y - viewport->Pos.y) / viewport->Size.y * 2.0f);
+    };
+
+    glm::vec2 topLeft = ndc(p0);
+    glm::vec2 bottomRight = ndc(p1);
+    _rect = glm::vec4(topLeft.x, topLeft.y, bottomRight.x, bottomRight.y);
+    _visible = std::clamp(p1.x - p0.x, 1.0f, float(Columns));
+
+    drawList->AddCallback(render, this);
+    drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+}
+
+void Spectrogram::render(const ImDrawList *parentList, const ImDrawCmd *cmd)
+{
+    (void)parentList;
+    auto self = static_cast<Spectrogram *>(cmd->UserCallbackData);
+
+    // Clip to the command's rectangle the way the ImGui renderer does, the scissor left behind is
+    // the one of the previous command
+    const ImDrawData *drawData = ImGui::GetDrawData();
+    ImVec2 clipMin((cmd->ClipRect.x - drawData->DisplayPos.x) * drawData->FramebufferScale.x,
+                   (cmd->ClipRect.y - drawData->DisplayPos.y) * drawData->FramebufferScale.y);
+    ImVec2 clipMax((cmd->ClipRect.z - drawData->DisplayPos.x) * drawData->FramebufferScale.x,
+                   (cmd->ClipRect.w - drawData->DisplayPos.y) * drawData->FramebufferScale.y);
+    if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y)
+    {
+        return;
+    }
+    int framebufferHeight = int(drawData->DisplaySize.y * drawData->FramebufferScale.y);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(int(clipMin.x), int(framebufferHeight - clipMax.y), int(clipMax.x - clipMin.x),
+              int(clipMax.y - clipMin.y));
+
+    self->_program->use();
+    self->_program->setUniformVec4("rect", self->_rect);
+    self->_program->setUniformInt("levels", 0);
+    self->_program->setUniformFloat("newest", float((self->_head + Columns - 1) % Columns));
+    self->_program->setUniformFloat("visible", self->_visible);
+    self->_program->setUniformFloat("bands", float(std::max(self->_bands, 1)));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, self->_texture);
+    glBindVertexArray(self->_vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
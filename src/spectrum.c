@@ -0,0 +1,193 @@
+#include "spectrum.h"
+#include "dsp_kernels.h"
+#include "fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SPECTRUM_LOW_HZ 20.0
+#define SPECTRUM_HIGH_HZ 20000.0
+
+struct spectrum_analyzer
+{
+    fft_real *fft;
+    int fft_size;
+    int bands;
+    int hz;                               // rate the band edges were computed for
+    int band_start[SPECTRUM_MAX_BANDS + 1]; // first bin of every band, the last entry ends the last band
+    float power_scale;                    // full scale sine -> 1.0
+    float *window;
+    float *history[2];                    // latest fft_size frames per channel, oldest first
+    float *input;                         // windowed frames of one channel
+    float *bin_re, *bin_im;
+};
+
+spectrum_analyzer *spectrum_analyzer_create(int fft_size, int bands)
+{
+    if (fft_size < SPECTRUM_MIN_FFT_SIZE || fft_size > SPECTRUM_MAX_FFT_SIZE || bands < 1 || bands > SPECTRUM_MAX_BANDS)
+    {
+        return NULL;
+    }
+
+    spectrum_analyzer *analyzer = (spectrum_analyzer *)calloc(1, sizeof(spectrum_analyzer));
+    if (!analyzer)
+    {
+        return NULL;
+    }
+
+    analyzer->fft = fft_real_create(fft_size);
+    analyzer->fft_size = fft_size;
+    analyzer->bands = bands;
+    analyzer->window = (float *)malloc(fft_size * sizeof(float));
+    analyzer->history[0] = (float *)calloc(fft_size, sizeof(float));
+    analyzer->history[1] = (float *)calloc(fft_size, sizeof(float));
+    analyzer->input = (float *)malloc(fft_size * sizeof(float));
+    analyzer->bin_re = (float *)malloc((fft_size / 2 + 1) * sizeof(float));
+    analyzer->bin_im = (float *)malloc((fft_size / 2 + 1) * sizeof(float));
+
+    if (!analyzer->fft || !analyzer->window || !analyzer->history[0] || !analyzer->history[1] || !analyzer->input || !analyzer->bin_re || !analyzer->bin_im)
+    {
+        spectrum_analyzer_destroy(analyzer);
+        return NULL;
+    }
+
+    // Periodic Hann window, its gain is taken out again by power_scale
+    double window_sum = 0.0;
+    for (int i = 0; i < fft_size; i++)
+    {
+        analyzer->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / fft_size));
+        window_sum += analyzer->window[i];
+    }
+    analyzer->power_scale = (float)((2.0 / window_sum) * (2.0 / window_sum));
+
+    return analyzer;
+}
+
+void spectrum_analyzer_destroy(spectrum_analyzer *analyzer)
+{
+    if (!analyzer)
+    {
+        return;
+    }
+
+    fft_real_destroy(analyzer->fft);
+    free(analyzer->window);
+    free(analyzer->history[0]);
+    free(analyzer->history[1]);
+    free(analyzer->input);
+    free(analyzer->bin_re);
+    free(analyzer->bin_im);
+    free(analyzer);
+}
+
+int spectrum_analyzer_bands(const spectrum_analyzer *analyzer)
+{
+    return analyzer->bands;
+}
+
+void spectrum_analyzer_reset(spectrum_analyzer *analyzer)
+{
+    memset(analyzer->history[0], 0, analyzer->fft_size * sizeof(float));
+    memset(analyzer->history[1], 0, analyzer->fft_size * sizeof(float));
+}
+
+static void map_bands(spectrum_analyzer *analyzer, int hz)
+{
+    int bins = analyzer->fft_size / 2;
+    double high = hz / 2.0 < SPECTRUM_HIGH_HZ ? hz / 2.0 : SPECTRUM_HIGH_HZ;
+    double bin_hz = (double)hz / analyzer->fft_size;
+
+    // Every band gets at least one bin, at the low end bands are narrower than a bin
+    int start = (int)(SPECTRUM_LOW_HZ / bin_hz);
+    if (start < 1) start = 1; // no DC
+    for (int band = 0; band < analyzer->bands; band++)
+    {
+        double edge = SPECTRUM_LOW_HZ * pow(high / SPECTRUM_LOW_HZ, (double)(band + 1) / analyzer->bands);
+        int end = (int)(edge / bin_hz + 0.5);
+        if (end <= start) end = start + 1;
+        if (end > bins) end = bins;
+
+        analyzer->band_start[band] = start;
+        start = end;
+    }
+    analyzer->band_start[analyzer->bands] = start;
+    analyzer->hz = hz;
+}
+
+static void append_history(spectrum_analyzer *analyzer, const mp3d_sample_t *samples, int frames, int channels, int channel)
+{
+    float *history = analyzer->history[channel];
+    int size = analyzer->fft_size;
+
+    if (frames >= size)
+    {
+        samples += (frames - size) * channels;
+        frames = size;
+    }
+    else
+    {
+        memmove(history, history + frames, (size - frames) * sizeof(float));
+    }
+
+    float *dst = history + size - frames;
+    for (int i = 0; i < frames; i++)
+    {
+#ifdef MINIMP3_FLOAT_OUTPUT
+        dst[i] = samples[i * channels + channel];
+#else
+        dst[i] = samples[i * channels + channel] * (1.0f / 32768.0f);
+#endif
+    }
+}
+
+void spectrum_analyzer_process(
+    spectrum_analyzer *analyzer,
+    const mp3d_sample_t *samples,
+    int count,
+    int channels,
+    int hz,
+    float bands[SPECTRUM_MAX_BANDS][2])
+{
+    if (channels < 1 || hz <= 0)
+    {
+        return;
+    }
+
+    if (hz != analyzer->hz)
+    {
+        map_bands(analyzer, hz);
+    }
+
+    int frames = count / channels;
+    int analyzed = channels < 2 ? 1 : 2;
+
+    for (int ch = 0; ch < analyzed; ch++)
+    {
+        append_history(analyzer, samples, frames, channels, ch);
+
+        const float *history = analyzer->history[ch];
+        for (int i = 0; i < analyzer->fft_size; i++)
+        {
+            analyzer->input[i] = history[i] * analyzer->window[i];
+        }
+
+        fft_real_forward(analyzer->fft, analyzer->input, analyzer->bin_re, analyzer->bin_im);
+        dsp_band_power(analyzer->bin_re, analyzer->bin_im, analyzer->band_start, analyzer->bands, &bands[0][ch], 2);
+    }
+
+    // Mono shows the same on both sides
+    if (analyzed == 1)
+    {
+        for (int band = 0; band < analyzer->bands; band++)
+        {
+            bands[band][1] = bands[band][0];
+        }
+    }
+
+    dsp_to_db(&bands[0][0], analyzer->power_scale, 100.0f, &bands[0][0], analyzer->bands * 2);
+}
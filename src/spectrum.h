@@ -0,0 +1,41 @@
+#pragma once
+
+#include "decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Spectrum analyzer for the visualizer. Runs on the decode thread over the
+// decoded PCM: Hann window, real FFT per channel, bins summed into bands
+// spaced evenly on a log frequency scale between 20 Hz and 20 kHz.
+#define SPECTRUM_MAX_BANDS 64
+#define SPECTRUM_MIN_FFT_SIZE 256
+#define SPECTRUM_MAX_FFT_SIZE 8192
+#define SPECTRUM_DEFAULT_FFT_SIZE 2048
+#define SPECTRUM_DEFAULT_BANDS 32
+
+typedef struct spectrum_analyzer spectrum_analyzer;
+
+// fft_size must be a power of two within the limits above, bands at most SPECTRUM_MAX_BANDS
+spectrum_analyzer *spectrum_analyzer_create(int fft_size, int bands);
+void spectrum_analyzer_destroy(spectrum_analyzer *analyzer);
+
+int spectrum_analyzer_bands(const spectrum_analyzer *analyzer);
+
+// Forgets the samples seen so far, after a seek or a new track
+void spectrum_analyzer_reset(spectrum_analyzer *analyzer);
+
+// Appends interleaved samples and analyzes the latest fft_size frames of the first two channels.
+// Band levels are in dB above -100 dBFS, so 0 is silence and 100 a full scale sine.
+void spectrum_analyzer_process(
+    spectrum_analyzer *analyzer,
+    const mp3d_sample_t *samples,
+    int count,
+    int channels,
+    int hz,
+    float bands[SPECTRUM_MAX_BANDS][2]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,50 @@
+#include "spsc_queue.h"
+
+void spsc_queue_init(spsc_queue *queue, void *storage, int item_size, int capacity)
+{
+    SDL_assert((capacity & (capacity - 1)) == 0);
+
+    queue->items = (unsigned char *)storage;
+    queue->item_size = item_size;
+    queue->capacity = capacity;
+    SDL_SetAtomicInt(&queue->head, 0);
+    SDL_SetAtomicInt(&queue->tail, 0);
+}
+
+int spsc_queue_push(spsc_queue *queue, const void *item)
+{
+    unsigned int head = (unsigned int)SDL_GetAtomicInt(&queue->head);
+    unsigned int tail = (unsigned int)SDL_GetAtomicInt(&queue->tail);
+
+    if (head - tail >= (unsigned int)queue->capacity)
+    {
+        return 0;
+    }
+
+    SDL_memcpy(queue->items + (head & (queue->capacity - 1)) * queue->item_size, item, queue->item_size);
+
+    // Publish the item before the new head becomes visible
+    SDL_MemoryBarrierRelease();
+    SDL_AddAtomicInt(&queue->head, 1);
+
+    return 1;
+}
+
+int spsc_queue_pop(spsc_queue *queue, void *item)
+{
+    unsigned int tail = (unsigned int)SDL_GetAtomicInt(&queue->tail);
+    unsigned int head = (unsigned int)SDL_GetAtomicInt(&queue->head);
+
+    if (head == tail)
+    {
+        return 0;
+    }
+
+    SDL_MemoryBarrierAcquire();
+    SDL_memcpy(item, queue->items + (tail & (queue->capacity - 1)) * queue->item_size, queue->item_size);
+
+    SDL_MemoryBarrierRelease();
+    SDL_AddAtomicInt(&queue->tail, 1);
+
+    return 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lock-free single-producer/single-consumer queue of fixed-size messages, used
+// for commands from the UI to the decode thread and events coming back.
+// Items are copied in and out; storage is provided by the owner.
+typedef struct spsc_queue
+{
+    unsigned char *items;
+    int item_size;
+    int capacity;       // must be a power of two
+    SDL_AtomicInt head; // items pushed by the producer
+    SDL_AtomicInt tail; // items popped by the consumer
+} spsc_queue;
+
+void spsc_queue_init(spsc_queue *queue, void *storage, int item_size, int capacity);
+
+// Producer side: returns 0 when the queue is full
+int spsc_queue_push(spsc_queue *queue, const void *item);
+
+// Consumer side: returns 0 when the queue is empty
+int spsc_queue_pop(spsc_queue *queue, void *item);
+
+#ifdef __cplusplus
+}
+#endif
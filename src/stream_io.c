@@ -0,0 +1,137 @@
+#include "stream_io.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define stream_open(name) _open((name), _O_RDONLY | _O_BINARY | _O_SEQUENTIAL)
+#define stream_read(fd, buf, size) _read((fd), (buf), (unsigned int)(size))
+#define stream_seek(fd, pos) _lseeki64((fd), (__int64)(pos), SEEK_SET)
+#define stream_close(fd) _close(fd)
+#else
+#include <unistd.h>
+#define stream_open(name) open((name), O_RDONLY)
+#define stream_read(fd, buf, size) read((fd), (buf), (size))
+#define stream_seek(fd, pos) lseek((fd), (off_t)(pos), SEEK_SET)
+#define stream_close(fd) close(fd)
+#endif
+
+#define STREAM_IO_PAGE 4096
+#define STREAM_IO_MAX_READ (1 << 30)
+
+static void stream_io_advise(stream_io *s)
+{
+#ifdef POSIX_FADV_WILLNEED
+    // Ask for the next window in the background once half of the previous one is used up
+    if (s->pos + s->window / 2 >= s->advised && s->pos < s->size)
+    {
+        posix_fadvise(s->fd, (off_t)s->pos, (off_t)s->window, POSIX_FADV_WILLNEED);
+        s->advised = s->pos + s->window;
+    }
+
+    // Keep one window behind the read position for short seeks back, drop the rest
+    if (s->pos > s->released + 2 * (uint64_t)s->window)
+    {
+        uint64_t end = (s->pos - s->window) & ~(uint64_t)(STREAM_IO_PAGE - 1);
+        posix_fadvise(s->fd, (off_t)s->released, (off_t)(end - s->released), POSIX_FADV_DONTNEED);
+        s->released = end;
+    }
+#else
+    // Windows gets its read-ahead from _O_SEQUENTIAL, elsewhere the kernel default applies
+    (void)s;
+#endif
+}
+
+static size_t stream_io_read(void *buf, size_t size, void *user_data)
+{
+    stream_io *s = (stream_io *)user_data;
+    size_t total = 0;
+
+    // minimp3 takes a short read for the end of the file, so fill the whole buffer
+    while (total < size)
+    {
+        size_t chunk = size - total < STREAM_IO_MAX_READ ? size - total : STREAM_IO_MAX_READ;
+        long long n = (long long)stream_read(s->fd, (char *)buf + total, chunk);
+        if (n <= 0)
+        {
+            s->error |= n < 0 || s->pos + total < s->size;
+            break;
+        }
+        total += (size_t)n;
+    }
+
+    s->pos += total;
+    stream_io_advise(s);
+
+    return total;
+}
+
+static int stream_io_seek(uint64_t position, void *user_data)
+{
+    stream_io *s = (stream_io *)user_data;
+
+    if (stream_seek(s->fd, position) < 0)
+    {
+        return -1;
+    }
+
+    s->pos = position;
+    s->advised = position;
+    if (position < s->released)
+    {
+        s->released = position & ~(uint64_t)(STREAM_IO_PAGE - 1);
+    }
+
+    return 0;
+}
+
+stream_io *stream_io_open(const char *file_name, uint32_t window)
+{
+    int fd = stream_open(file_name);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        stream_close(fd);
+        return NULL;
+    }
+
+    stream_io *s = (stream_io *)calloc(1, sizeof(stream_io));
+    if (!s)
+    {
+        stream_close(fd);
+        return NULL;
+    }
+
+    s->fd = fd;
+    s->size = (uint64_t)st.st_size;
+    s->window = window ? window : STREAM_IO_DEFAULT_WINDOW;
+    s->io.read = stream_io_read;
+    s->io.read_data = s;
+    s->io.seek = stream_io_seek;
+    s->io.seek_data = s;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return s;
+}
+
+void stream_io_close(stream_io *s)
+{
+    if (!s)
+    {
+        return;
+    }
+
+    stream_close(s->fd);
+    free(s);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <minimp3_ex.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Read-ahead window kept in front of the read position, pages further behind are released
+#define STREAM_IO_DEFAULT_WINDOW (1024 * 1024)
+
+// Sequential file reader for mp3dec_ex_open_cb(). minimp3 only ever holds its own
+// MINIMP3_IO_SIZE buffer, so memory use does not grow with the length of the file.
+typedef struct stream_io
+{
+    mp3dec_io_t io; // hand &io to minimp3, read_data/seek_data point back here
+    int fd;
+    uint64_t size;
+    uint64_t pos;
+    uint64_t advised;  // read-ahead has been requested up to here
+    uint64_t released; // cached pages before this offset have been dropped
+    uint32_t window;
+    int error; // a read failed or the file ended early, which minimp3 takes for its end
+} stream_io;
+
+// Returns NULL if the file can't be opened, window 0 picks STREAM_IO_DEFAULT_WINDOW
+stream_io *stream_io_open(const char *file_name, uint32_t window);
+void stream_io_close(stream_io *s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,746 @@
+#include "tags.h"
+
+#include <SDL3/SDL.h>
+#include <string.h>
+
+#define TAGS_APE_FOOTER_SIZE 32
+#define TAGS_APE_HAS_HEADER 0x80000000u
+#define TAGS_ID3V1_SIZE 128
+#define TAGS_FRONT_COVER 3 // APIC picture type
+
+enum
+{
+    TAGS_FRAME_TITLE,
+    TAGS_FRAME_ARTIST,
+    TAGS_FRAME_ALBUM,
+    TAGS_FRAME_TRACK,
+    TAGS_FRAME_LENGTH,
+    TAGS_FRAME_PICTURE,
+    TAGS_FRAME_COUNT
+};
+
+// ID3v2.2 has three letter frame IDs, later versions four
+static const char tags_frame_ids[2][TAGS_FRAME_COUNT][5] = {
+    {"TT2", "TP1", "TAL", "TRK", "TLE", "PIC"},
+    {"TIT2", "TPE1", "TALB", "TRCK", "TLEN", "APIC"},
+};
+
+/* ============================================================
+   Reading
+   ============================================================ */
+
+// Walks the bytes of a tag, undoing unsynchronisation when it is on
+typedef struct tags_reader
+{
+    const uint8_t *at;
+    const uint8_t *end;
+    int unsync;
+} tags_reader;
+
+static tags_reader tags_field_reader(const tags_field *field)
+{
+    tags_reader r;
+    r.at = field->data;
+    r.end = field->data + field->size;
+    r.unsync = field->unsync;
+    return r;
+}
+
+static int tags_get(tags_reader *r, uint8_t *out)
+{
+    if (r->at >= r->end)
+    {
+        return 0;
+    }
+
+    *out = *r->at++;
+    if (r->unsync && *out == 0xFF && r->at < r->end && *r->at == 0x00)
+    {
+        r->at++;
+    }
+    return 1;
+}
+
+static int tags_read(tags_reader *r, uint8_t *out, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (!tags_get(r, &out[i]))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Moves past size bytes, unsynchronisation undone, and records where they lie in field
+static int tags_skip(tags_reader *r, uint32_t size, tags_field *field)
+{
+    const uint8_t *start = r->at;
+    if (!r->unsync)
+    {
+        if ((size_t)(r->end - r->at) < size)
+        {
+            return 0;
+        }
+        r->at += size;
+    }
+    else
+    {
+        uint8_t byte;
+        for (uint32_t i = 0; i < size; i++)
+        {
+            if (!tags_get(r, &byte))
+            {
+                return 0;
+            }
+        }
+    }
+
+    if (field)
+    {
+        memset(field, 0, sizeof(*field));
+        field->data = start;
+        field->size = (uint32_t)(r->at - start);
+        field->unsync = (uint8_t)r->unsync;
+    }
+    return 1;
+}
+
+static uint32_t tags_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t tags_le32(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+// Seven bits per byte, so the size never contains a frame sync
+static uint32_t tags_synchsafe(const uint8_t *p)
+{
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) | ((uint32_t)(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+/* ============================================================
+   Text
+   ============================================================ */
+
+// Appends a code point as UTF-8 if it fits in front of the terminator
+static int tags_put(char *out, size_t out_size, size_t *length, uint32_t c)
+{
+    char bytes[4];
+    size_t n;
+    if (c < 0x80)
+    {
+        bytes[0] = (char)c;
+        n = 1;
+    }
+    else if (c < 0x800)
+    {
+        bytes[0] = (char)(0xC0 | (c >> 6));
+        bytes[1] = (char)(0x80 | (c & 0x3F));
+        n = 2;
+    }
+    else if (c < 0x10000)
+    {
+        bytes[0] = (char)(0xE0 | (c >> 12));
+        bytes[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (c & 0x3F));
+        n = 3;
+    }
+    else
+    {
+        bytes[0] = (char)(0xF0 | (c >> 18));
+        bytes[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+        bytes[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+        bytes[3] = (char)(0x80 | (c & 0x3F));
+        n = 4;
+    }
+
+    if (*length + n >= out_size)
+    {
+        return 0;
+    }
+    memcpy(out + *length, bytes, n);
+    *length += n;
+    return 1;
+}
+
+// Length without a sequence the end of the buffer cut short
+static size_t tags_utf8_complete(const char *s, size_t length)
+{
+    size_t start = length;
+    while (start > 0 && ((uint8_t)s[start - 1] & 0xC0) == 0x80)
+    {
+        start--;
+    }
+    if (start == 0)
+    {
+        return 0;
+    }
+
+    uint8_t lead = (uint8_t)s[start - 1];
+    size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    return length - (start - 1) >= need ? length : start - 1;
+}
+
+static int tags_next_utf16(tags_reader *r, int big_endian, uint32_t *c)
+{
+    uint8_t b[2];
+    if (!tags_read(r, b, 2))
+    {
+        return 0;
+    }
+    *c = big_endian ? ((uint32_t)b[0] << 8 | b[1]) : ((uint32_t)b[1] << 8 | b[0]);
+    return 1;
+}
+
+size_t tags_text(const tags_field *field, char *out, size_t out_size)
+{
+    size_t length = 0;
+    if (!out_size)
+    {
+        return 0;
+    }
+    out[0] = '\0';
+    if (!field->data)
+    {
+        return 0;
+    }
+
+    tags_reader r = tags_field_reader(field);
+    if (field->encoding == TAGS_UTF16 || field->encoding == TAGS_UTF16BE)
+    {
+        // The byte order mark decides, big endian without one
+        int big_endian = 1;
+        tags_reader bom = r;
+        uint8_t b[2];
+        if (tags_read(&bom, b, 2) && ((b[0] == 0xFF && b[1] == 0xFE) || (b[0] == 0xFE && b[1] == 0xFF)))
+        {
+            big_endian = b[0] == 0xFE;
+            r = bom;
+        }
+
+        uint32_t c;
+        while (tags_next_utf16(&r, big_endian, &c) && c)
+        {
+            if (c >= 0xD800 && c < 0xDC00)
+            {
+                uint32_t low;
+                if (tags_next_utf16(&r, big_endian, &low) && low >= 0xDC00 && low < 0xE000)
+                {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else
+                {
+                    c = 0xFFFD;
+                }
+            }
+            else if (c >= 0xDC00 && c < 0xE000)
+            {
+                c = 0xFFFD;
+            }
+
+            if (!tags_put(out, out_size, &length, c))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        tags_reader bom = r;
+        uint8_t b[3];
+        if (field->encoding == TAGS_UTF8 && tags_read(&bom, b, 3) && memcmp(b, "\xEF\xBB\xBF", 3) == 0)
+        {
+            r = bom;
+        }
+
+        uint8_t byte;
+        while (tags_get(&r, &byte) && byte)
+        {
+            if (field->encoding == TAGS_LATIN1)
+            {
+                if (!tags_put(out, out_size, &length, byte))
+                {
+                    break;
+                }
+            }
+            else if (length + 1 < out_size)
+            {
+                out[length++] = (char)byte;
+            }
+            else
+            {
+                length = tags_utf8_complete(out, length);
+                break;
+            }
+        }
+    }
+
+    // ID3v1 pads with spaces
+    while (length > 0 && out[length - 1] == ' ')
+    {
+        length--;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+size_t tags_copy(const tags_field *field, uint8_t *out, size_t out_size)
+{
+    if (!field->data)
+    {
+        return 0;
+    }
+    if (!field->unsync)
+    {
+        memcpy(out, field->data, SDL_min(out_size, (size_t)field->size));
+        return field->size;
+    }
+
+    tags_reader r = tags_field_reader(field);
+    size_t size = 0;
+    uint8_t byte;
+    while (tags_get(&r, &byte))
+    {
+        if (size < out_size)
+        {
+            out[size] = byte;
+        }
+        size++;
+    }
+    return size;
+}
+
+// Fills a field the tags read before left empty
+static void tags_set(tags_field *field, const tags_field *value)
+{
+    char text[32];
+    if (!field->data && tags_text(value, text, sizeof(text)) > 0)
+    {
+        *field = *value;
+    }
+}
+
+// "7" or "7/12", "215000" for TLEN
+static uint32_t tags_number(const tags_field *field)
+{
+    char text[16];
+    tags_text(field, text, sizeof(text));
+
+    uint32_t value = 0;
+    for (const char *c = text; *c >= '0' && *c <= '9' && value < UINT32_MAX / 10; c++)
+    {
+        value = value * 10 + (uint32_t)(*c - '0');
+    }
+    return value;
+}
+
+/* ============================================================
+   ID3v2
+   ============================================================ */
+
+size_t tags_id3v2_size(const uint8_t *header, size_t size)
+{
+    if (size < TAGS_HEADER_SIZE || memcmp(header, "ID3", 3) != 0 || header[3] < 2 || header[3] > 4 ||
+        ((header[6] | header[7] | header[8] | header[9]) & 0x80))
+    {
+        return 0;
+    }
+
+    size_t footer = header[3] == 4 && (header[5] & 0x10) ? TAGS_HEADER_SIZE : 0;
+    return TAGS_HEADER_SIZE + tags_synchsafe(header + 6) + footer;
+}
+
+// Encoding, MIME type, picture type, description, then the image
+static void tags_read_picture(tags *out, const tags_field *body, int version, int *cover_type)
+{
+    tags_reader r = tags_field_reader(body);
+    uint8_t encoding, type, byte;
+    if (!tags_get(&r, &encoding) || encoding > TAGS_UTF8)
+    {
+        return;
+    }
+
+    // ID3v2.2 has a three letter image format instead
+    tags_field mime;
+    if (version == 2)
+    {
+        if (!tags_skip(&r, 3, &mime))
+        {
+            return;
+        }
+    }
+    else
+    {
+        const uint8_t *start = r.at;
+        do
+        {
+            if (!tags_get(&r, &byte))
+            {
+                return;
+            }
+        } while (byte);
+        memset(&mime, 0, sizeof(mime));
+        mime.data = start;
+        mime.size = (uint32_t)(r.at - start);
+        mime.unsync = body->unsync;
+    }
+
+    if (!tags_get(&r, &type))
+    {
+        return;
+    }
+
+    // The description ends with a zero character of its encoding
+    int wide = encoding == TAGS_UTF16 || encoding == TAGS_UTF16BE;
+    uint8_t c[2] = {0, 0};
+    do
+    {
+        if (!tags_read(&r, c, wide ? 2 : 1))
+        {
+            return;
+        }
+    } while (c[0] || c[1]);
+
+    // The front cover wins, otherwise the first picture
+    if (out->picture.data && (*cover_type == TAGS_FRONT_COVER || type != TAGS_FRONT_COVER))
+    {
+        return;
+    }
+
+    memset(&out->picture, 0, sizeof(out->picture));
+    out->picture.data = r.at;
+    out->picture.size = (uint32_t)(r.end - r.at);
+    out->picture.unsync = body->unsync;
+    out->picture_mime = mime;
+    *cover_type = type;
+}
+
+static void tags_read_frame(tags *out, int frame, const tags_field *body, int version, int *cover_type)
+{
+    if (frame == TAGS_FRAME_PICTURE)
+    {
+        tags_read_picture(out, body, version, cover_type);
+        return;
+    }
+
+    // The text follows its encoding
+    tags_reader r = tags_field_reader(body);
+    uint8_t encoding;
+    if (!tags_get(&r, &encoding) || encoding > TAGS_UTF8)
+    {
+        return;
+    }
+
+    tags_field text;
+    memset(&text, 0, sizeof(text));
+    text.data = r.at;
+    text.size = (uint32_t)(r.end - r.at);
+    text.encoding = encoding;
+    text.unsync = body->unsync;
+
+    switch (frame)
+    {
+    case TAGS_FRAME_TITLE:
+        tags_set(&out->title, &text);
+        break;
+    case TAGS_FRAME_ARTIST:
+        tags_set(&out->artist, &text);
+        break;
+    case TAGS_FRAME_ALBUM:
+        tags_set(&out->album, &text);
+        break;
+    case TAGS_FRAME_TRACK:
+        out->track = out->track ? out->track : tags_number(&text);
+        break;
+    case TAGS_FRAME_LENGTH:
+        out->length_ms = out->length_ms ? out->length_ms : tags_number(&text);
+        break;
+    }
+}
+
+static int tags_frame_of(const uint8_t *id, int version)
+{
+    const int id_size = version == 2 ? 3 : 4;
+    for (int i = 0; i < TAGS_FRAME_COUNT; i++)
+    {
+        if (memcmp(id, tags_frame_ids[version > 2][i], id_size) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int tags_parse_id3v2(const uint8_t *data, size_t size, tags *out)
+{
+    if (!tags_id3v2_size(data, size))
+    {
+        return 0;
+    }
+
+    const int version = data[3];
+    const uint8_t flags = data[5];
+
+    // ID3v2.2 used the extended header flag for a compression nobody settled on
+    if (version == 2 && (flags & 0x40))
+    {
+        return 0;
+    }
+
+    // Up to ID3v2.3 unsynchronisation covers the whole tag, frame sizes included; ID3v2.4 flags
+    // every frame and counts the bytes as stored
+    tags_reader r;
+    r.at = data + TAGS_HEADER_SIZE;
+    r.end = data + SDL_min(size, TAGS_HEADER_SIZE + (size_t)tags_synchsafe(data + 6));
+    r.unsync = version < 4 && (flags & 0x80);
+
+    if (version > 2 && (flags & 0x40))
+    {
+        // ID3v2.3 counts what follows the size, ID3v2.4 the whole extended header
+        uint8_t size_bytes[4];
+        if (!tags_read(&r, size_bytes, 4))
+        {
+            return 0;
+        }
+        uint32_t extended = version == 3 ? tags_be32(size_bytes) : tags_synchsafe(size_bytes);
+        if ((version == 4 && extended < 4) || !tags_skip(&r, version == 3 ? extended : extended - 4, NULL))
+        {
+            return 0;
+        }
+    }
+
+    out->found |= TAGS_ID3V2;
+
+    const uint32_t header_size = version == 2 ? 6 : 10;
+    int cover_type = -1;
+    uint8_t header[10];
+    while (tags_read(&r, header, header_size) && header[0] != 0)
+    {
+        uint32_t frame_size;
+        uint16_t frame_flags = 0;
+        if (version == 2)
+        {
+            frame_size = ((uint32_t)header[3] << 16) | ((uint32_t)header[4] << 8) | header[5];
+        }
+        else
+        {
+            frame_size = version == 3 ? tags_be32(header + 4) : tags_synchsafe(header + 4);
+            frame_flags = (uint16_t)(header[8] << 8 | header[9]);
+        }
+
+        // A frame cut off by the end of the buffer ends the tag as well
+        tags_field body;
+        if (!tags_skip(&r, frame_size, &body))
+        {
+            break;
+        }
+
+        int frame = tags_frame_of(header, version);
+        if (frame < 0)
+        {
+            continue;
+        }
+
+        // Compressed and encrypted frames are left alone; group, encryption method and data
+        // length bytes come before the content
+        uint32_t extra = 0;
+        if (version == 3)
+        {
+            if (frame_flags & 0x00C0)
+            {
+                continue;
+            }
+            extra = (frame_flags & 0x0020) ? 1 : 0;
+        }
+        else if (version == 4)
+        {
+            if (frame_flags & 0x000C)
+            {
+                continue;
+            }
+            extra = ((frame_flags & 0x0040) ? 1 : 0) + ((frame_flags & 0x0001) ? 4 : 0);
+            body.unsync = (frame_flags & 0x0002) || (flags & 0x80);
+        }
+
+        if (extra >= body.size)
+        {
+            continue;
+        }
+        body.data += extra;
+        body.size -= extra;
+        tags_read_frame(out, frame, &body, version, &cover_type);
+    }
+
+    return 1;
+}
+
+size_t tags_id3v2_first_frame(const uint8_t *data, size_t size)
+{
+    if (!tags_id3v2_size(data, size))
+    {
+        return 0;
+    }
+
+    const int version = data[3];
+    const uint8_t flags = data[5];
+    if ((version < 4 && (flags & 0x80)) || (version == 2 && (flags & 0x40)))
+    {
+        return 0;
+    }
+    if (version == 2 || !(flags & 0x40))
+    {
+        return TAGS_HEADER_SIZE;
+    }
+
+    if (size < TAGS_HEADER_SIZE + 4)
+    {
+        return 0;
+    }
+    const uint8_t *extended = data + TAGS_HEADER_SIZE;
+    return version == 3 ? TAGS_HEADER_SIZE + 4 + (size_t)tags_be32(extended) : TAGS_HEADER_SIZE + (size_t)tags_synchsafe(extended);
+}
+
+size_t tags_id3v2_frame_size(const uint8_t *data, const uint8_t *frame, int *text)
+{
+    const int version = data[3];
+    *text = 0;
+    if (frame[0] == 0)
+    {
+        return 0;
+    }
+
+    int id = tags_frame_of(frame, version);
+    *text = id >= 0 && id != TAGS_FRAME_PICTURE;
+    if (version == 2)
+    {
+        return 6 + (((size_t)frame[3] << 16) | ((size_t)frame[4] << 8) | frame[5]);
+    }
+    return 10 + (size_t)(version == 3 ? tags_be32(frame + 4) : tags_synchsafe(frame + 4));
+}
+
+/* ============================================================
+   APE and ID3v1
+   ============================================================ */
+
+size_t tags_tail_size(const uint8_t *tail, size_t size)
+{
+    size_t end = size;
+    if (size >= TAGS_ID3V1_SIZE && memcmp(tail + size - TAGS_ID3V1_SIZE, "TAG", 3) == 0)
+    {
+        end -= TAGS_ID3V1_SIZE;
+    }
+
+    size_t ape = 0;
+    if (end >= TAGS_APE_FOOTER_SIZE && memcmp(tail + end - TAGS_APE_FOOTER_SIZE, "APETAGEX", 8) == 0)
+    {
+        // The size counts the items and the footer, not the header
+        const uint8_t *footer = tail + end - TAGS_APE_FOOTER_SIZE;
+        ape = (size_t)tags_le32(footer + 12) + ((tags_le32(footer + 20) & TAGS_APE_HAS_HEADER) ? TAGS_APE_FOOTER_SIZE : 0);
+    }
+
+    return size - end + ape;
+}
+
+// Items are a value size, flags, a terminated key and the value
+static void tags_read_ape(tags *out, const uint8_t *at, const uint8_t *end, uint32_t count)
+{
+    for (uint32_t i = 0; i < count && end - at > 8; i++)
+    {
+        uint32_t value_size = tags_le32(at);
+        uint32_t flags = tags_le32(at + 4);
+        const char *key = (const char *)at + 8;
+        const uint8_t *key_end = (const uint8_t *)memchr(key, 0, (size_t)(end - at) - 8);
+        if (!key_end || (size_t)(end - key_end - 1) < value_size)
+        {
+            return;
+        }
+
+        tags_field value;
+        memset(&value, 0, sizeof(value));
+        value.data = key_end + 1;
+        value.size = value_size;
+        value.encoding = TAGS_UTF8;
+        at = value.data + value_size;
+
+        // Binary items and links aren't text
+        if (flags & 0x6)
+        {
+            continue;
+        }
+
+        if (SDL_strcasecmp(key, "Title") == 0)
+        {
+            tags_set(&out->title, &value);
+        }
+        else if (SDL_strcasecmp(key, "Artist") == 0)
+        {
+            tags_set(&out->artist, &value);
+        }
+        else if (SDL_strcasecmp(key, "Album") == 0)
+        {
+            tags_set(&out->album, &value);
+        }
+        else if (SDL_strcasecmp(key, "Track") == 0 && !out->track)
+        {
+            out->track = tags_number(&value);
+        }
+    }
+}
+
+static tags_field tags_id3v1_field(const uint8_t *data, uint32_t size)
+{
+    tags_field field;
+    memset(&field, 0, sizeof(field));
+    field.data = data;
+    field.size = size;
+    field.encoding = TAGS_LATIN1;
+    return field;
+}
+
+int tags_parse_tail(const uint8_t *tail, size_t size, tags *out)
+{
+    const uint8_t *id3v1 = NULL;
+    size_t end = size;
+    if (size >= TAGS_ID3V1_SIZE && memcmp(tail + size - TAGS_ID3V1_SIZE, "TAG", 3) == 0)
+    {
+        id3v1 = tail + size - TAGS_ID3V1_SIZE;
+        end -= TAGS_ID3V1_SIZE;
+    }
+
+    int found = 0;
+    if (end >= TAGS_APE_FOOTER_SIZE && memcmp(tail + end - TAGS_APE_FOOTER_SIZE, "APETAGEX", 8) == 0)
+    {
+        const uint8_t *footer = tail + end - TAGS_APE_FOOTER_SIZE;
+        uint32_t tag_size = tags_le32(footer + 12);
+        if (tag_size >= TAGS_APE_FOOTER_SIZE && tag_size <= end)
+        {
+            tags_read_ape(out, footer - (tag_size - TAGS_APE_FOOTER_SIZE), footer, tags_le32(footer + 16));
+            found |= TAGS_APE;
+        }
+    }
+
+    if (id3v1)
+    {
+        tags_field title = tags_id3v1_field(id3v1 + 3, 30);
+        tags_field artist = tags_id3v1_field(id3v1 + 33, 30);
+        tags_field album = tags_id3v1_field(id3v1 + 63, 30);
+        tags_set(&out->title, &title);
+        tags_set(&out->artist, &artist);
+        tags_set(&out->album, &album);
+
+        // ID3v1.1 keeps the track number in the last byte of the comment
+        if (!out->track && id3v1[125] == 0 && id3v1[126] != 0)
+        {
+            out->track = id3v1[126];
+        }
+        found |= TAGS_ID3V1;
+    }
+
+    out->found |= found;
+    return found != 0;
+}
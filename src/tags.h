@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reader for the tags of MP3 files: ID3v2.2 to 2.4 at the start, APEv2 and ID3v1 at the end.
+// Nothing is copied, fields point into the bytes handed in, which have to outlive them.
+// Where several tags hold a field ID3v2 wins over APE, APE over ID3v1.
+
+#define TAGS_ID3V2 0x1
+#define TAGS_APE 0x2
+#define TAGS_ID3V1 0x4
+
+#define TAGS_HEADER_SIZE 10       // enough to tell how long an ID3v2 tag is
+#define TAGS_FRAME_HEADER_SIZE 10 // the most an ID3v2 frame header takes, ID3v2.2 ones are 6
+#define TAGS_TAIL_SIZE (32 + 128) // the APE footer and the ID3v1 tag after it
+
+typedef enum tags_encoding
+{
+    TAGS_LATIN1,
+    TAGS_UTF16,   // byte order mark first
+    TAGS_UTF16BE,
+    TAGS_UTF8,
+} tags_encoding;
+
+typedef struct tags_field
+{
+    const uint8_t *data; // NULL when no tag has the field
+    uint32_t size;       // in the buffer, unsynchronisation included
+    uint8_t encoding;    // tags_encoding of text
+    uint8_t unsync;      // 0xFF 0x00 in the buffer stands for 0xFF
+} tags_field;
+
+typedef struct tags
+{
+    tags_field title;
+    tags_field artist;
+    tags_field album;
+    tags_field picture;      // APIC image data, the front cover if there is one
+    tags_field picture_mime; // "image/jpeg", "image/png", or "JPG" and "PNG" from ID3v2.2
+    uint32_t track;          // number on the album, 0 if unknown
+    uint32_t length_ms;      // from TLEN, 0 if unknown
+    int found;               // TAGS_*
+} tags;
+
+// Bytes the ID3v2 tag takes at the start of a file, footer included, from its first
+// TAGS_HEADER_SIZE bytes. 0 if it starts with something else.
+size_t tags_id3v2_size(const uint8_t *header, size_t size);
+
+// Parses the ID3v2 tag data starts with. A tag cut short still yields the frames that fit.
+// Returns 0 if there's none.
+int tags_parse_id3v2(const uint8_t *data, size_t size, tags *out);
+
+// A tag too big to be read whole can be walked frame by frame instead, seeking past the cover
+// art. Returns the offset of the first frame from the first TAGS_HEADER_SIZE + 4 bytes of the
+// tag, 0 where the frames can't be found without reading all of them: unsynchronised ID3v2.2 and
+// ID3v2.3 tags, whose frame sizes don't count the bytes as stored.
+size_t tags_id3v2_first_frame(const uint8_t *data, size_t size);
+
+// Bytes a frame of the tag data starts with takes, header included, from the first
+// TAGS_FRAME_HEADER_SIZE bytes at frame. 0 once the padding is reached. text is set for the
+// frames tags_parse_id3v2() reads, pictures aside; copied after the bytes up to the first frame
+// they make up a tag it parses.
+size_t tags_id3v2_frame_size(const uint8_t *data, const uint8_t *frame, int *text);
+
+// Bytes the APE and ID3v1 tags take at the end of a file, from its last TAGS_TAIL_SIZE bytes
+size_t tags_tail_size(const uint8_t *tail, size_t size);
+
+// Parses the APE and ID3v1 tags at the end of the size bytes at tail, filling what is still
+// missing from out. Returns 0 if there are none.
+int tags_parse_tail(const uint8_t *tail, size_t size, tags *out);
+
+// Text of a field as UTF-8 with trailing spaces dropped, cut at the first of several values.
+// Returns its length; out is always terminated.
+size_t tags_text(const tags_field *field, char *out, size_t out_size);
+
+// Copies a field with unsynchronisation undone, returns the size of the whole of it
+size_t tags_copy(const tags_field *field, uint8_t *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,445 @@
+#include "waveform.h"
+#include "cache.h"
+#include "stream_io.h"
+
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAVEFORM_CACHE_KIND "waveform"
+#define WAVEFORM_CACHE_MAGIC 0x56415750u /* "PWAV" */
+#define WAVEFORM_CACHE_VERSION 1
+
+// Three bytes per 4096 frames and as much again for the coarser levels: ~250 KB for an hour
+#define WAVEFORM_CACHE_DEFAULT_LIMIT_KB (64 * 1024)
+
+#define WAVEFORM_DECODE_SAMPLES 4096
+
+typedef struct waveform_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t frames;
+    uint32_t hz;
+    uint32_t channels;
+    uint32_t base_frames;
+    uint32_t levels;
+    uint32_t path_len;     // the track path follows the header, guards against hash collisions
+    uint32_t payload_size; // peak count of every level, then the peaks of every level
+} waveform_cache_header;
+
+struct waveform_job
+{
+    SDL_Thread *thread;
+    SDL_AtomicInt cancel;
+    SDL_AtomicInt progress; // permille of the file decoded
+    SDL_AtomicInt done;     // 1 when result is complete, -1 on failure
+    char *file_name;
+    waveform result;
+    waveform_peak *storage; // all levels, one allocation
+};
+
+static int8_t quantize_peak(float v)
+{
+    int q = (int)lrintf(v * 127.0f);
+    return (int8_t)(q < -127 ? -127 : q > 127 ? 127 : q);
+}
+
+static uint8_t quantize_rms(double sum_squares, int count)
+{
+    int q = count ? (int)lrint(sqrt(sum_squares / count) * 255.0) : 0;
+    return (uint8_t)(q > 255 ? 255 : q);
+}
+
+// Points the level arrays into one allocation, counts must be set
+static int waveform_alloc_levels(waveform_job *job)
+{
+    size_t total = 0;
+    for (int level = 0; level < job->result.levels; level++)
+    {
+        total += job->result.counts[level];
+    }
+
+    job->storage = (waveform_peak *)malloc(total * sizeof(waveform_peak));
+    if (!job->storage)
+    {
+        return 0;
+    }
+
+    waveform_peak *p = job->storage;
+    for (int level = 0; level < job->result.levels; level++)
+    {
+        job->result.peaks[level] = p;
+        p += job->result.counts[level];
+    }
+
+    return 1;
+}
+
+
+/* ============================================================
+   Cache
+   ============================================================ */
+static int waveform_cache_load(waveform_job *job)
+{
+    char path[1200];
+    uint64_t file_size;
+    int64_t file_mtime;
+    size_t size = 0;
+
+    if (!cache_entry_path(path, sizeof(path), WAVEFORM_CACHE_KIND, job->file_name, ".peaks") || !cache_file_stamp(job->file_name, &file_size, &file_mtime))
+    {
+        return 0;
+    }
+
+    uint8_t *data = (uint8_t *)SDL_LoadFile(path, &size);
+    if (!data)
+    {
+        return 0;
+    }
+
+    waveform_cache_header header;
+    size_t path_len = strlen(job->file_name);
+    int ok = 0;
+
+    if (size >= sizeof(header))
+    {
+        memcpy(&header, data, sizeof(header));
+
+        ok = header.magic == WAVEFORM_CACHE_MAGIC && header.version == WAVEFORM_CACHE_VERSION && header.file_size == file_size && header.file_mtime == file_mtime && header.base_frames == WAVEFORM_BASE_FRAMES && header.levels >= 1 && header.levels <= WAVEFORM_MAX_LEVELS && header.path_len == path_len && header.payload_size >= header.levels * sizeof(uint32_t) && sizeof(header) + path_len + header.payload_size == size && memcmp(data + sizeof(header), job->file_name, path_len) == 0;
+    }
+
+    if (ok)
+    {
+        const uint8_t *p = data + sizeof(header) + path_len;
+        size_t peaks = 0;
+
+        job->result.levels = (int)header.levels;
+        for (int level = 0; level < job->result.levels; level++)
+        {
+            uint32_t count;
+            memcpy(&count, p + level * sizeof(count), sizeof(count));
+            job->result.counts[level] = (int)count;
+            peaks += count;
+        }
+
+        ok = header.levels * sizeof(uint32_t) + peaks * sizeof(waveform_peak) == header.payload_size && waveform_alloc_levels(job);
+        if (ok)
+        {
+            memcpy(job->storage, p + header.levels * sizeof(uint32_t), peaks * sizeof(waveform_peak));
+            job->result.frames = header.frames;
+            job->result.hz = (int)header.hz;
+            job->result.channels = (int)header.channels;
+        }
+    }
+
+    SDL_free(data);
+
+    return ok;
+}
+
+static void waveform_cache_store(const waveform_job *job)
+{
+    char path[1200];
+    waveform_cache_header header;
+    size_t path_len = strlen(job->file_name);
+    const waveform *wave = &job->result;
+
+    if (!cache_entry_path(path, sizeof(path), WAVEFORM_CACHE_KIND, job->file_name, ".peaks"))
+    {
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    if (!cache_file_stamp(job->file_name, &header.file_size, &header.file_mtime))
+    {
+        return;
+    }
+
+    size_t peaks = 0;
+    for (int level = 0; level < wave->levels; level++)
+    {
+        peaks += wave->counts[level];
+    }
+
+    header.magic = WAVEFORM_CACHE_MAGIC;
+    header.version = WAVEFORM_CACHE_VERSION;
+    header.frames = wave->frames;
+    header.hz = (uint32_t)wave->hz;
+    header.channels = (uint32_t)wave->channels;
+    header.base_frames = WAVEFORM_BASE_FRAMES;
+    header.levels = (uint32_t)wave->levels;
+    header.path_len = (uint32_t)path_len;
+    header.payload_size = (uint32_t)(wave->levels * sizeof(uint32_t) + peaks * sizeof(waveform_peak));
+
+    size_t size = sizeof(header) + path_len + header.payload_size;
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (!data)
+    {
+        return;
+    }
+
+    uint8_t *p = data;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, job->file_name, path_len);
+    p += path_len;
+    for (int level = 0; level < wave->levels; level++)
+    {
+        uint32_t count = (uint32_t)wave->counts[level];
+        memcpy(p, &count, sizeof(count));
+        p += sizeof(count);
+    }
+    memcpy(p, job->storage, peaks * sizeof(waveform_peak));
+
+    if (cache_write_file(path, data, size))
+    {
+        uint64_t total = 0;
+        cache_evict(WAVEFORM_CACHE_KIND, (uint64_t)WAVEFORM_CACHE_DEFAULT_LIMIT_KB * 1024, &total);
+    }
+
+    free(data);
+}
+
+
+/* ============================================================
+   Background job
+   ============================================================ */
+
+// Level 0 peaks as they are decoded
+typedef struct waveform_builder
+{
+    waveform_peak *peaks;
+    int count;
+    int capacity;
+    float lo, hi;
+    double sum_squares;
+    int samples; // in the peak being accumulated
+} waveform_builder;
+
+static int waveform_builder_emit(waveform_builder *builder)
+{
+    if (builder->count == builder->capacity)
+    {
+        int capacity = builder->capacity ? builder->capacity * 2 : 1024;
+        waveform_peak *grown = (waveform_peak *)realloc(builder->peaks, capacity * sizeof(waveform_peak));
+        if (!grown)
+        {
+            return 0;
+        }
+        builder->peaks = grown;
+        builder->capacity = capacity;
+    }
+
+    waveform_peak *peak = &builder->peaks[builder->count++];
+    peak->min = quantize_peak(builder->lo);
+    peak->max = quantize_peak(builder->hi);
+    peak->rms = quantize_rms(builder->sum_squares, builder->samples);
+
+    builder->lo = builder->hi = 0.0f;
+    builder->sum_squares = 0.0;
+    builder->samples = 0;
+
+    return 1;
+}
+
+// Decodes the whole file into level 0 peaks, with the same decoder setup as playback
+// so peak positions line up with playback positions
+static int waveform_decode(waveform_job *job, mp3dec_ex_t *dec, stream_io *stream, mp3d_sample_t *buf, waveform_builder *builder)
+{
+    if (mp3dec_ex_open_cb(dec, &stream->io, MP3D_SEEK_TO_SAMPLE | MP3D_DO_NOT_SCAN) || !dec->info.channels)
+    {
+        return 0;
+    }
+
+    const int channels = dec->info.channels;
+    const int peak_samples = WAVEFORM_BASE_FRAMES * channels;
+    uint64_t samples = 0;
+    size_t decoded;
+
+    do
+    {
+        if (SDL_GetAtomicInt(&job->cancel))
+        {
+            return 0;
+        }
+
+        decoded = mp3dec_ex_read(dec, buf, WAVEFORM_DECODE_SAMPLES);
+
+        for (size_t i = 0; i < decoded; i++)
+        {
+#ifdef MINIMP3_FLOAT_OUTPUT
+            float v = buf[i];
+#else
+            float v = buf[i] * (1.0f / 32768.0f);
+#endif
+            builder->lo = v < builder->lo ? v : builder->lo;
+            builder->hi = v > builder->hi ? v : builder->hi;
+            builder->sum_squares += (double)v * v;
+
+            if (++builder->samples == peak_samples && !waveform_builder_emit(builder))
+            {
+                return 0;
+            }
+        }
+
+        samples += decoded;
+        if (stream->size)
+        {
+            SDL_SetAtomicInt(&job->progress, (int)(stream->pos * 1000 / stream->size));
+        }
+    } while (decoded == WAVEFORM_DECODE_SAMPLES);
+
+    // The partial stretch at the end
+    if (builder->samples && !waveform_builder_emit(builder))
+    {
+        return 0;
+    }
+
+    job->result.frames = samples / channels;
+    job->result.hz = dec->info.hz;
+    job->result.channels = channels;
+
+    return builder->count > 0;
+}
+
+// Fills the coarser levels from level 0, each peak merges two of the level below
+static void waveform_build_levels(waveform *wave)
+{
+    for (int level = 1; level < wave->levels; level++)
+    {
+        const waveform_peak *src = wave->peaks[level - 1];
+        int src_count = wave->counts[level - 1];
+        waveform_peak *dst = wave->peaks[level];
+
+        for (int i = 0; i < wave->counts[level]; i++)
+        {
+            const waveform_peak *a = &src[2 * i];
+            const waveform_peak *b = 2 * i + 1 < src_count ? &src[2 * i + 1] : a;
+
+            dst[i].min = a->min < b->min ? a->min : b->min;
+            dst[i].max = a->max > b->max ? a->max : b->max;
+            dst[i].rms = (uint8_t)lrintf(sqrtf((a->rms * a->rms + b->rms * b->rms) * 0.5f));
+        }
+    }
+}
+
+static int SDLCALL waveform_job_thread(void *data)
+{
+    waveform_job *job = (waveform_job *)data;
+    int result = -1;
+
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    if (waveform_cache_load(job))
+    {
+        result = 1;
+    }
+    else
+    {
+        stream_io *stream = stream_io_open(job->file_name, 0);
+        mp3dec_ex_t *dec = (mp3dec_ex_t *)calloc(1, sizeof(mp3dec_ex_t));
+        mp3d_sample_t *buf = (mp3d_sample_t *)malloc(WAVEFORM_DECODE_SAMPLES * sizeof(mp3d_sample_t));
+        waveform_builder builder;
+        memset(&builder, 0, sizeof(builder));
+
+        if (stream && dec && buf && waveform_decode(job, dec, stream, buf, &builder))
+        {
+            waveform *wave = &job->result;
+
+            wave->levels = 1;
+            wave->counts[0] = builder.count;
+            while (wave->levels < WAVEFORM_MAX_LEVELS && wave->counts[wave->levels - 1] > WAVEFORM_MIN_PEAKS)
+            {
+                wave->counts[wave->levels] = (wave->counts[wave->levels - 1] + 1) / 2;
+                wave->levels++;
+            }
+
+            if (waveform_alloc_levels(job))
+            {
+                memcpy(wave->peaks[0], builder.peaks, builder.count * sizeof(waveform_peak));
+                waveform_build_levels(wave);
+                waveform_cache_store(job);
+                result = 1;
+            }
+        }
+
+        if (dec)
+        {
+            mp3dec_ex_close(dec);
+        }
+        free(dec);
+        free(buf);
+        free(builder.peaks);
+        stream_io_close(stream);
+    }
+
+    SDL_SetAtomicInt(&job->progress, 1000);
+    SDL_SetAtomicInt(&job->done, result);
+
+    return 0;
+}
+
+waveform_job *waveform_job_start(const char *file_name)
+{
+    waveform_job *job = (waveform_job *)calloc(1, sizeof(waveform_job));
+    if (!job)
+    {
+        return NULL;
+    }
+
+    job->file_name = SDL_strdup(file_name);
+    job->thread = job->file_name ? SDL_CreateThread(waveform_job_thread, "plyr waveform", job) : NULL;
+    if (!job->thread)
+    {
+        SDL_free(job->file_name);
+        free(job);
+        return NULL;
+    }
+
+    return job;
+}
+
+void waveform_job_free(waveform_job *job)
+{
+    if (!job)
+    {
+        return;
+    }
+
+    SDL_SetAtomicInt(&job->cancel, 1);
+    SDL_WaitThread(job->thread, NULL);
+
+    free(job->storage);
+    SDL_free(job->file_name);
+    free(job);
+}
+
+const char *waveform_job_file_name(const waveform_job *job)
+{
+    return job->file_name;
+}
+
+float waveform_job_progress(waveform_job *job)
+{
+    return SDL_GetAtomicInt(&job->progress) / 1000.0f;
+}
+
+const waveform *waveform_job_result(waveform_job *job)
+{
+    return SDL_GetAtomicInt(&job->done) == 1 ? &job->result : NULL;
+}
+
+int waveform_pick_level(const waveform *wave, int width)
+{
+    int level = 0;
+    while (level + 1 < wave->levels && wave->counts[level + 1] >= width)
+    {
+        level++;
+    }
+
+    return level;
+}
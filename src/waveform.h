@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Overview of a whole track for the timeline: min, max and RMS of every stretch of
+// WAVEFORM_BASE_FRAMES frames, all channels together, plus coarser levels that each
+// merge pairs of the level below. Built by a background job that decodes the file at
+// full speed, or loaded from the on-disk cache when the track was seen before.
+#define WAVEFORM_BASE_FRAMES 4096
+#define WAVEFORM_MAX_LEVELS 16
+#define WAVEFORM_MIN_PEAKS 64 // no level is coarser than this
+
+typedef struct waveform_peak
+{
+    int8_t min;  // -127..127 is -1..1
+    int8_t max;
+    uint8_t rms; // 0..255 is 0..1
+} waveform_peak;
+
+typedef struct waveform
+{
+    uint64_t frames; // decoded length of the track
+    int hz;
+    int channels;
+    int levels;
+    int counts[WAVEFORM_MAX_LEVELS];              // peaks per level, level l spans WAVEFORM_BASE_FRAMES << l frames each
+    waveform_peak *peaks[WAVEFORM_MAX_LEVELS];
+} waveform;
+
+typedef struct waveform_job waveform_job;
+
+// Starts loading or building the waveform of file_name, NULL when out of memory
+waveform_job *waveform_job_start(const char *file_name);
+
+// Cancels the job if it is still running and frees it together with its waveform
+void waveform_job_free(waveform_job *job);
+
+const char *waveform_job_file_name(const waveform_job *job);
+
+// Share of the file decoded so far in [0, 1]
+float waveform_job_progress(waveform_job *job);
+
+// The finished waveform, valid until the job is freed. NULL while running or when the
+// file couldn't be decoded.
+const waveform *waveform_job_result(waveform_job *job);
+
+// Coarsest level that still has at least width peaks, so every pixel column gets one
+int waveform_pick_level(const waveform *wave, int width);
+
+#ifdef __cplusplus
+}
+#endif